@@ -0,0 +1,111 @@
+#include "adaptive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// deeper pieces are shorter than 2^-16 of the segment, far below a pixel
+static const unsigned int max_depth = 16;
+
+double ChordHeight(const BezierMatrix& bezier) {
+    Eigen::RowVector2d chord = bezier.row(3) - bezier.row(0);
+    double chord_squared = chord.squaredNorm();
+    double height = 0.0;
+    for (Eigen::Index i = 1; i <= 2; i++) {
+        // distance to the nearest point of the chord rather than of its line,
+        // a curve doubling back past either end is not flat
+        Eigen::RowVector2d offset = bezier.row(i) - bezier.row(0);
+        double along =
+            chord_squared > 0.0
+                ? std::clamp(offset.dot(chord) / chord_squared, 0.0, 1.0)
+                : 0.0;
+        height = std::max(height, (offset - along * chord).norm());
+    }
+    return height;
+}
+
+void SplitBezier(const BezierMatrix& bezier, BezierMatrix& left,
+                 BezierMatrix& right) {
+    Eigen::RowVector2d p01 = 0.5 * (bezier.row(0) + bezier.row(1));
+    Eigen::RowVector2d p12 = 0.5 * (bezier.row(1) + bezier.row(2));
+    Eigen::RowVector2d p23 = 0.5 * (bezier.row(2) + bezier.row(3));
+    Eigen::RowVector2d p012 = 0.5 * (p01 + p12);
+    Eigen::RowVector2d p123 = 0.5 * (p12 + p23);
+    Eigen::RowVector2d mid = 0.5 * (p012 + p123);
+    left << bezier.row(0), p01, p012, mid;
+    right << mid, p123, p23, bezier.row(3);
+}
+
+static void Subdivide(const BezierMatrix& bezier, double tolerance,
+                      unsigned int depth,
+                      std::vector<Eigen::RowVector2d>& samples) {
+    if (depth >= max_depth || ChordHeight(bezier) <= tolerance) {
+        samples.push_back(bezier.row(0));
+        return;
+    }
+
+    BezierMatrix left, right;
+    SplitBezier(bezier, left, right);
+    Subdivide(left, tolerance, depth + 1, samples);
+    Subdivide(right, tolerance, depth + 1, samples);
+}
+
+BezierMatrix ComputeBezierPoints(const PairVector& control_points,
+                                 SplineType spline_type_) {
+    // Bezier control points of p(t) over [t0, 1] from its end points and
+    // end tangents, scaled by the length of the parameter range
+    CoefficientMatrix coefficients =
+        ComputeCoefficients(control_points, spline_type_);
+    const double t0 = ParamStart(spline_type_);
+    const double range = 1.0 - t0;
+    Eigen::RowVector4d value_start(t0 * t0 * t0, t0 * t0, t0, 1.0);
+    Eigen::RowVector4d slope_start(3 * t0 * t0, 2 * t0, 1.0, 0.0);
+    Eigen::RowVector4d value_end(1.0, 1.0, 1.0, 1.0);
+    Eigen::RowVector4d slope_end(3.0, 2.0, 1.0, 0.0);
+
+    BezierMatrix bezier;
+    bezier.row(0) = value_start * coefficients;
+    bezier.row(3) = value_end * coefficients;
+    bezier.row(1) = bezier.row(0) + range / 3 * (slope_start * coefficients);
+    bezier.row(2) = bezier.row(3) - range / 3 * (slope_end * coefficients);
+    return bezier;
+}
+
+SplineMatrix ComputeSplineAdaptive(const PairVector& control_points,
+                                   SplineType spline_type_,
+                                   unsigned int spline_degree_,
+                                   double tolerance) {
+    if (spline_degree_ != 3)
+        throw std::invalid_argument("only cubic spline bases are tabulated");
+    return ComputeSplineAdaptive(
+        ComputeBezierPoints(control_points, spline_type_), tolerance);
+}
+
+SplineMatrix ComputeSplineAdaptive(const BezierMatrix& bezier,
+                                   double tolerance) {
+    if (tolerance <= 0.0)
+        throw std::invalid_argument("tolerance must be positive");
+
+    std::vector<Eigen::RowVector2d> samples;
+    Subdivide(bezier, tolerance, 0, samples);
+    samples.push_back(bezier.row(3));
+
+    SplineMatrix spline(static_cast<Eigen::Index>(samples.size()), 2);  // Q
+    for (size_t i = 0; i < samples.size(); i++)
+        spline.row(static_cast<Eigen::Index>(i)) = samples[i];
+    return spline;
+}
+
+uint64_t MaxAdaptiveSamples(const BezierMatrix& bezier, double tolerance) {
+    double height = std::max(
+        (bezier.row(0) - 2 * bezier.row(1) + bezier.row(2)).norm(),
+        (bezier.row(1) - 2 * bezier.row(2) + bezier.row(3)).norm());
+    // pieces of points that are not finite are split all the way
+    unsigned int depth = 0;
+    while (depth < max_depth && !(height <= tolerance)) {
+        height /= 4;
+        depth++;
+    }
+    return (uint64_t{1} << depth) + 1;
+}
@@ -0,0 +1,39 @@
+#ifndef SPLINE_PLOTTER_ADAPTIVE_H_
+#define SPLINE_PLOTTER_ADAPTIVE_H_
+
+#include <cstdint>
+
+#include "spline.h"
+
+typedef Eigen::Matrix<double, 4, 2> BezierMatrix;  // rows P0 to P3
+
+// Bezier control points of a cubic segment over its whole parameter range
+// [ParamStart, 1]. By the convex hull property they bound it
+BezierMatrix ComputeBezierPoints(const PairVector& control_points,
+                                 SplineType spline_type_);
+
+// Largest distance of P1 and P2 from the chord segment P0-P3, which by the
+// convex hull property bounds the distance of the curve from it
+double ChordHeight(const BezierMatrix& bezier);
+// de Casteljau split at t = 0.5 into the pieces over [0, 0.5] and [0.5, 1]
+void SplitBezier(const BezierMatrix& bezier, BezierMatrix& left,
+                 BezierMatrix& right);
+
+// Samples a segment with just enough points that the polyline stays within
+// tolerance px of the curve. Each piece is written in Bezier form and split
+// in half until both inner control points lie within tolerance of its chord;
+// by the convex hull property the curve piece then does too
+SplineMatrix ComputeSplineAdaptive(const PairVector& control_points,
+                                   SplineType spline_type_,
+                                   unsigned int spline_degree_,
+                                   double tolerance);
+// The same for a segment given by its Bezier control points
+SplineMatrix ComputeSplineAdaptive(const BezierMatrix& bezier,
+                                   double tolerance);
+// Most samples ComputeSplineAdaptive can give a segment. A piece over a
+// fraction h of t has second differences of its Bezier points within h^2 of
+// the segment's largest, and these bound its chord height, so no piece is
+// split past the depth at which 4^-depth times that is within tolerance
+uint64_t MaxAdaptiveSamples(const BezierMatrix& bezier, double tolerance);
+
+#endif  // SPLINE_PLOTTER_ADAPTIVE_H_
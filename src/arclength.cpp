@@ -0,0 +1,223 @@
+#include "arclength.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "nurbs.h"
+
+// 5 point Gauss-Legendre rule on [-1, 1], exact for polynomials of degree 9
+static const double gauss_nodes[5] = {-0.9061798459386640, -0.5384693101056831,
+                                      0.0, 0.5384693101056831,
+                                      0.9061798459386640};
+static const double gauss_weights[5] = {0.2369268850561891, 0.4786286704993665,
+                                        0.5688888888888889, 0.4786286704993665,
+                                        0.2369268850561891};
+
+// Newton's method stops once the arc length is this close, in px
+static const double length_tolerance = 1e-9;
+static const unsigned int max_iterations = 50;
+// intervals are halved at most this many times, to 2^-20 of their length
+static const unsigned int max_depth = 20;
+
+ArcLengthTable::ArcLengthTable(const SegmentCurve& curve,
+                               unsigned int num_intervals)
+    : curve_(curve) {
+    if (num_intervals == 0)
+        throw std::invalid_argument("arc length tables need an interval");
+    const double t_start = curve_.Start();
+    // every interval adds at least its midpoint and end
+    params_.reserve(2 * num_intervals + 1);
+    lengths_.reserve(2 * num_intervals + 1);
+    params_.push_back(t_start);
+    lengths_.push_back(0.0);
+    for (unsigned int i = 0; i < num_intervals; i++) {
+        double t0 = t_start + (1.0 - t_start) * i / num_intervals;
+        double t1 = t_start + (1.0 - t_start) * (i + 1) / num_intervals;
+        AddInterval(t0, t1, Integrate(t0, t1), 0);
+    }
+}
+
+void ArcLengthTable::AddInterval(double t0, double t1, double length,
+                                 unsigned int depth) {
+    double mid = 0.5 * (t0 + t1);
+    double left = Integrate(t0, mid), right = Integrate(mid, t1);
+    if (depth < max_depth &&
+        std::abs(left + right - length) > arc_length_tolerance) {
+        AddInterval(t0, mid, left, depth + 1);
+        AddInterval(mid, t1, right, depth + 1);
+        return;
+    }
+    params_.push_back(mid);
+    lengths_.push_back(lengths_.back() + left);
+    params_.push_back(t1);
+    lengths_.push_back(lengths_.back() + right);
+}
+
+double ArcLengthTable::Integrate(double t0, double t1) const {
+    double half = 0.5 * (t1 - t0), mid = 0.5 * (t0 + t1);
+    double length = 0.0;
+    for (unsigned int i = 0; i < 5; i++)
+        length += gauss_weights[i] * curve_.Speed(mid + half * gauss_nodes[i]);
+    return half * length;
+}
+
+double ArcLengthTable::LengthAtParam(double t) const {
+    t = std::clamp(t, params_.front(), params_.back());
+    size_t i = static_cast<size_t>(
+        std::upper_bound(params_.begin(), params_.end(), t) -
+        params_.begin() - 1);
+    i = std::min(i, params_.size() - 2);
+    return lengths_[i] + Integrate(params_[i], t);
+}
+
+double ArcLengthTable::ParamAtLength(double s) const {
+    if (s <= 0.0) return params_.front();
+    if (s >= Length()) return params_.back();
+
+    size_t i = static_cast<size_t>(
+        std::upper_bound(lengths_.begin(), lengths_.end(), s) -
+        lengths_.begin() - 1);
+    i = std::min(i, params_.size() - 2);
+    const double base = params_[i];
+    const double target = s - lengths_[i];
+    const double interval_length = lengths_[i + 1] - lengths_[i];
+    if (interval_length <= 0.0) return base;
+
+    // t stays bracketed by [low, high], starting from a linear guess
+    double low = base, high = params_[i + 1];
+    double t = base + (high - base) * target / interval_length;
+    for (unsigned int iteration = 0; iteration < max_iterations;
+         iteration++) {
+        double error = Integrate(base, t) - target;
+        if (std::abs(error) < length_tolerance) break;
+        if (error > 0.0) {
+            high = t;
+        } else {
+            low = t;
+        }
+        double speed = curve_.Speed(t);
+        double next = speed > 0.0 ? t - error / speed : low;
+        t = next > low && next < high ? next : 0.5 * (low + high);
+    }
+    return t;
+}
+
+CurveArcLength::CurveArcLength(const PairVector& coordinates,
+                               const std::vector<double>& weights,
+                               const std::vector<double>& knots,
+                               SplineType spline_type_,
+                               unsigned int spline_degree_)
+    : CurveArcLength() {
+    unsigned int num_segments_ =
+        ::NumSegments(spline_type_, spline_degree_,
+                      static_cast<unsigned int>(coordinates.size()));
+    std::vector<ArcLengthTable> tables;
+    tables.reserve(num_segments_);
+    for (unsigned int k = 0; k < num_segments_; k++)
+        tables.emplace_back(SegmentCurve(
+            SegmentControlPoints(coordinates, spline_type_, spline_degree_, k),
+            SegmentWeights(weights, spline_type_, spline_degree_, k),
+            SegmentKnots(knots, spline_type_, spline_degree_, k), spline_type_,
+            spline_degree_));
+    Replace(0, std::move(tables));
+}
+
+CurveArcLength::CurveArcLength(const PairVector& coordinates,
+                               const CubicInterpolant& interpolant)
+    : CurveArcLength() {
+    std::vector<ArcLengthTable> tables;
+    tables.reserve(interpolant.NumSegments());
+    for (unsigned int k = 0; k < interpolant.NumSegments(); k++)
+        tables.emplace_back(SegmentCurve(InterpolatedCoefficients(
+            coordinates, interpolant.Tangents(), k)));
+    Replace(0, std::move(tables));
+}
+
+void CurveArcLength::Replace(unsigned int first,
+                             std::vector<ArcLengthTable> tables) {
+    if (first > segments_.size())
+        throw std::invalid_argument("tables would leave a gap in the curve");
+    for (size_t i = 0; i < tables.size(); i++) {
+        if (first + i < segments_.size()) {
+            segments_[first + i] = std::move(tables[i]);
+        } else {
+            segments_.push_back(std::move(tables[i]));
+        }
+    }
+    starts_.resize(segments_.size() + 1);
+    for (size_t k = first; k < segments_.size(); k++)
+        starts_[k + 1] = starts_[k] + segments_[k].Length();
+}
+
+void CurveArcLength::Truncate(unsigned int num_segments_) {
+    if (num_segments_ >= segments_.size()) return;
+    segments_.erase(segments_.begin() + num_segments_, segments_.end());
+    starts_.resize(segments_.size() + 1);
+}
+
+std::pair<unsigned int, double> CurveArcLength::Locate(double s) const {
+    if (segments_.empty())
+        throw std::invalid_argument("curve has no segments");
+    // last segment whose start is at or before s
+    size_t k = static_cast<size_t>(
+        std::upper_bound(starts_.begin() + 1, starts_.end() - 1, s) -
+        (starts_.begin() + 1));
+    return std::make_pair(static_cast<unsigned int>(k),
+                          segments_[k].ParamAtLength(s - starts_[k]));
+}
+
+Eigen::Vector2d CurveArcLength::PointAtLength(double s) const {
+    std::pair<unsigned int, double> location = Locate(s);
+    return segments_[location.first].Curve().Point(location.second);
+}
+
+double CurveArcLength::CurvatureAtLength(double s) const {
+    std::pair<unsigned int, double> location = Locate(s);
+    return segments_[location.first].Curve().Curvature(location.second);
+}
+
+double CurveArcLength::Step(double spacing) const {
+    if (!(spacing > 0.0))
+        throw std::invalid_argument("specified spacing is not positive");
+    const double length = Length();
+    if (!(length > 0.0)) return 0.0;
+    return length / std::max(1.0, std::ceil(length / spacing));
+}
+
+SplineMatrix CurveArcLength::ResampleSegment(unsigned int k,
+                                             double step) const {
+    if (k >= segments_.size())
+        throw std::invalid_argument("no such segment");
+    SplineMatrix spline;
+    if (!(step > 0.0)) {
+        // every point of a curve of no length is its start
+        spline.resize(2, 2);
+        spline.row(0) = PointAtLength(starts_[k]);
+        spline.row(1) = spline.row(0);
+        return spline;
+    }
+
+    // indices j of the samples at j * step, the last being the end of the
+    // curve, from the first at or past the start of the segment to the first
+    // at or past its end
+    const double length = Length();
+    const Eigen::Index num_steps =
+        static_cast<Eigen::Index>(std::llround(length / step));
+    auto first_from = [&](double s) {
+        return std::min(num_steps,
+                        static_cast<Eigen::Index>(std::ceil(s / step)));
+    };
+    Eigen::Index last =
+        k + 1 == segments_.size() ? num_steps : first_from(starts_[k + 1]);
+    last = std::max<Eigen::Index>(last, 1);
+    Eigen::Index first = k == 0 ? 0 : first_from(starts_[k]);
+    first = std::min(first, last - 1);
+
+    spline.resize(last - first + 1, 2);
+    for (Eigen::Index j = first; j <= last; j++) {
+        double s = j == num_steps ? length : static_cast<double>(j) * step;
+        spline.row(j - first) = PointAtLength(s);
+    }
+    return spline;
+}
@@ -0,0 +1,100 @@
+#ifndef SPLINE_PLOTTER_ARCLENGTH_H_
+#define SPLINE_PLOTTER_ARCLENGTH_H_
+
+#include <Eigen/Core>
+#include <utility>
+#include <vector>
+
+#include "curve.h"
+#include "interpolate.h"
+#include "spline.h"
+
+// equal intervals of t a segment's arc length table starts from
+const unsigned int arc_length_intervals = 16;
+// px, an interval is halved until its halves agree with it to within this
+const double arc_length_tolerance = 1e-7;
+
+// Cumulative arc length of a segment at the ends of intervals of t, each
+// integrated with 5 point Gauss-Legendre quadrature. Intervals are halved
+// where that is inaccurate, which is near cusps where the speed has a kink.
+// Lengths between them are integrated on demand, so lookups in either
+// direction cost a binary search and a few quadratures
+class ArcLengthTable {
+   public:
+    explicit ArcLengthTable(const SegmentCurve& curve,
+                            unsigned int num_intervals = arc_length_intervals);
+
+    const SegmentCurve& Curve() const { return curve_; }
+    double Length() const { return lengths_.back(); }
+
+    // Arc length from the start of the segment to t
+    double LengthAtParam(double t) const;
+    // t at which the arc length from the start is s, clamped to the segment.
+    // Newton's method within the interval holding s, falling back to
+    // bisection where the speed is too low for Newton to make progress
+    double ParamAtLength(double s) const;
+
+   private:
+    double Integrate(double t0, double t1) const;
+    void AddInterval(double t0, double t1, double length, unsigned int depth);
+
+    SegmentCurve curve_;
+    std::vector<double> params_;
+    std::vector<double> lengths_;
+};
+
+// Arc length tables of every segment of a curve, with their lengths summed in
+// segment order, so a point at any distance along the curve is found with two
+// binary searches rather than by integrating from the start
+class CurveArcLength {
+   public:
+    CurveArcLength() : starts_(1, 0.0) {}
+    // weights holds the weight of every coordinate, or is empty when every
+    // weight is 1, and knots the knots of a NURBS curve, or is empty when
+    // they are uniform
+    CurveArcLength(const PairVector& coordinates,
+                   const std::vector<double>& weights,
+                   const std::vector<double>& knots, SplineType spline_type_,
+                   unsigned int spline_degree_);
+    // The Interpolating curve through coordinates with the tangents of
+    // interpolant
+    CurveArcLength(const PairVector& coordinates,
+                   const CubicInterpolant& interpolant);
+
+    unsigned int NumSegments() const {
+        return static_cast<unsigned int>(segments_.size());
+    }
+    double Length() const { return starts_.back(); }
+    const ArcLengthTable& Segment(unsigned int k) const {
+        return segments_[k];
+    }
+
+    // Replaces the tables of segments from first on with tables, appending
+    // those past the last segment, and sums the lengths again from first
+    void Replace(unsigned int first, std::vector<ArcLengthTable> tables);
+    // Drops the tables of segments from num_segments_ on
+    void Truncate(unsigned int num_segments_);
+
+    // Segment and t at arc length s from the start of the curve, clamped to
+    // the curve
+    std::pair<unsigned int, double> Locate(double s) const;
+    Eigen::Vector2d PointAtLength(double s) const;
+    // Signed curvature at arc length s, see SegmentCurve::Curvature
+    double CurvatureAtLength(double s) const;
+
+    // Largest step of at most spacing px that divides the whole curve into
+    // equal steps, 0 for a curve of no length
+    double Step(double spacing) const;
+    // Points at the multiples of step from the start of the curve that lie on
+    // segment k, followed by the first one past it, so consecutive segments
+    // join and the samples of the whole curve are equally spaced across
+    // joins. A segment shorter than step that holds none starts from the one
+    // before it, so every segment has at least two samples
+    SplineMatrix ResampleSegment(unsigned int k, double step) const;
+
+   private:
+    std::vector<ArcLengthTable> segments_;
+    std::vector<double> starts_;  // arc length before each segment, then total
+};
+
+#endif  // SPLINE_PLOTTER_ARCLENGTH_H_
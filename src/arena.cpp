@@ -0,0 +1,53 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+void SampleArena::Reserve(Eigen::Index num_samples) {
+    // grows geometrically, entries past NumSamples() are never read
+    size_t size = 2 * static_cast<size_t>(num_samples);
+    if (size > samples_.size())
+        samples_.resize(std::max(size, 2 * samples_.size()));
+}
+
+SplineView SampleArena::Segment(unsigned int k) {
+    return SplineView(samples_.data() + 2 * offsets_[k], SegmentSamples(k), 2);
+}
+
+ConstSplineView SampleArena::Segment(unsigned int k) const {
+    return ConstSplineView(samples_.data() + 2 * offsets_[k],
+                           SegmentSamples(k), 2);
+}
+
+void SampleArena::Append(const Eigen::Ref<const SplineMatrix>& spline) {
+    Reserve(NumSamples() + spline.rows());
+    offsets_.push_back(NumSamples() + spline.rows());
+    Segment(NumSegments() - 1) = spline;
+}
+
+double* SampleArena::AppendUniform(unsigned int num_segments_,
+                                   Eigen::Index num_samples) {
+    Eigen::Index first = NumSamples();
+    Reserve(first + num_segments_ * num_samples);
+    for (unsigned int k = 1; k <= num_segments_; k++)
+        offsets_.push_back(first + k * num_samples);
+    return samples_.data() + 2 * first;
+}
+
+void SampleArena::Replace(unsigned int k,
+                          const Eigen::Ref<const SplineMatrix>& spline) {
+    Eigen::Index shift = spline.rows() - SegmentSamples(k);
+    if (shift != 0) {
+        Reserve(NumSamples() + shift);
+        double* tail = samples_.data() + 2 * offsets_[k + 1];
+        std::memmove(tail + 2 * shift, tail,
+                     2 * sizeof(double) *
+                         static_cast<size_t>(NumSamples() - offsets_[k + 1]));
+        for (size_t j = k + 1; j < offsets_.size(); j++) offsets_[j] += shift;
+    }
+    Segment(k) = spline;
+}
+
+void SampleArena::Truncate(unsigned int num_segments_) {
+    if (num_segments_ < NumSegments()) offsets_.resize(num_segments_ + 1);
+}
@@ -0,0 +1,50 @@
+#ifndef SPLINE_PLOTTER_ARENA_H_
+#define SPLINE_PLOTTER_ARENA_H_
+
+#include <vector>
+
+#include "spline.h"
+
+typedef Eigen::Map<SplineMatrix> SplineView;
+typedef Eigen::Map<const SplineMatrix> ConstSplineView;
+
+// Samples of a sequence of segments in one interleaved x, y buffer, segment k
+// being rows offsets[k] to offsets[k + 1]. The buffer only grows, so removing
+// segments from the end and appending them again moves the end offset without
+// allocating, and a whole scene is read as one span
+class SampleArena {
+   public:
+    unsigned int NumSegments() const {
+        return static_cast<unsigned int>(offsets_.size() - 1);
+    }
+    Eigen::Index NumSamples() const { return offsets_.back(); }
+    // first sample of segment k, or NumSamples() for k = NumSegments()
+    Eigen::Index SegmentOffset(unsigned int k) const { return offsets_[k]; }
+    Eigen::Index SegmentSamples(unsigned int k) const {
+        return offsets_[k + 1] - offsets_[k];
+    }
+    // x, y of every sample, 2 * NumSamples() values
+    const double* Data() const { return samples_.data(); }
+
+    SplineView Segment(unsigned int k);
+    ConstSplineView Segment(unsigned int k) const;
+
+    void Append(const Eigen::Ref<const SplineMatrix>& spline);
+    // Appends num_segments_ segments of num_samples samples each and returns
+    // the first sample of the first one for the caller to fill in
+    double* AppendUniform(unsigned int num_segments_,
+                          Eigen::Index num_samples);
+    // Replaces segment k, moving the segments after it if its length changes
+    void Replace(unsigned int k, const Eigen::Ref<const SplineMatrix>& spline);
+    // Keeps the first num_segments_ segments
+    void Truncate(unsigned int num_segments_);
+    void Clear() { Truncate(0); }
+
+   private:
+    void Reserve(Eigen::Index num_samples);
+
+    std::vector<double> samples_;  // capacity, NumSamples() are in use
+    std::vector<Eigen::Index> offsets_ = {0};
+};
+
+#endif  // SPLINE_PLOTTER_ARENA_H_
@@ -0,0 +1,299 @@
+#include "args.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "export.h"
+#include "fit.h"
+#include "nurbs.h"
+#include "scene.h"
+#include "trace.h"
+
+unsigned int showConvexHull = 0;
+unsigned int frameRate = 0;
+bool printStats = false;
+std::string traceFile;
+
+bool CheckArgSplineType(std::vector<std::string> args) {
+    bool valid = false;
+    auto checkSplineType =
+        std::find(std::begin(args), std::end(args), "--spline_type");
+    if (checkSplineType != std::end(args)) {
+        // resolved once here, everything downstream switches on the enum
+        if (ParseSplineType(*(++checkSplineType), spline_type)) {
+            valid = true;
+        } else {
+            std::cout
+                << "Invalid argument --spline_type {Hermite, Bezier, BSpline, "
+                   "CatmullRom, MINVO, NURBS, Interpolating}"
+                << std::endl;
+        }
+    } else {
+        std::cout << "No argument --spline_type {Hermite, Bezier, BSpline, "
+                     "CatmullRom, MINVO, NURBS, Interpolating}"
+                  << std::endl;
+    }
+    return valid;
+}
+
+void CheckArgConvexHull(std::vector<std::string> args) {
+    auto checkConvexHullPlotting =
+        std::find(std::begin(args), std::end(args), "--show_convex_hull");
+    if (checkConvexHullPlotting != std::end(args)) {
+        showConvexHull = std::stoul(*(++checkConvexHullPlotting));
+    }
+}
+
+void CheckArgFrameRate(std::vector<std::string> args) {
+    auto checkFrameRate = std::find(std::begin(args), std::end(args), "--fps");
+    if (checkFrameRate != std::end(args)) {
+        frameRate = std::stoul(*(++checkFrameRate));
+    }
+    printStats = CheckArgFlag(args, "--stats");
+}
+
+void CheckArgContinuity(std::vector<std::string> args) {
+    bool C2_spline = (spline_type == SplineType::BSpline ||
+                      spline_type == SplineType::CatmullRom ||
+                      spline_type == SplineType::Interpolating);
+
+    if (C2_spline) {
+        std::cout << "C2 spline chosen: setting continuity C2, G2" << std::endl;
+        CCont = 2, GCont = 2;
+    } else if (spline_type == SplineType::NURBS) {
+        // distinct knots give C(p - 1) wherever the weights are positive
+        CCont = spline_degree - 1, GCont = spline_degree - 1;
+        std::cout << fmt::format(
+                         "Degree {} NURBS chosen: setting continuity C{}, G{}",
+                         spline_degree, CCont, GCont)
+                  << std::endl;
+    } else {
+        auto checkGCont =
+            std::find(std::begin(args), std::end(args), "--GCont");
+        auto checkCCont =
+            std::find(std::begin(args), std::end(args), "--CCont");
+
+        if (checkCCont != std::end(args)) {
+            CCont = std::stoul(*(++checkCCont));
+            if (checkGCont != std::end(args)) {
+                GCont = std::stoul(*(++checkGCont));
+            }
+            if (GCont > CCont) {
+                std::cout << "Invalid continuity specified (GCont > CCont): "
+                             "setting GCont = CCont"
+                          << std::endl;
+                GCont = CCont;
+            }
+            std::cout << fmt::format("Setting continuity C{}, G{}", CCont,
+                                     GCont)
+                      << std::endl;
+        } else if (checkGCont != std::end(args)) {
+            GCont = std::stoul(*(++checkGCont));
+            std::cout << fmt::format("Setting continuity C{}, G{}", CCont,
+                                     GCont)
+                      << std::endl;
+        } else {
+            std::cout << "--CCont not specified. Defaulting to C0, G0"
+                      << std::endl;
+            CCont = 0;
+            GCont = 0;
+        }
+    }
+    std::cout << std::endl;
+}
+
+bool CheckArgDegree(std::vector<std::string> args) {
+    // degree p of NURBS curves, the other spline types are cubic
+    auto checkDegree = std::find(std::begin(args), std::end(args), "--degree");
+    if (checkDegree != std::end(args))
+        spline_degree = std::stoul(*(++checkDegree));
+    if (spline_type != SplineType::NURBS && spline_degree != 3) {
+        std::cout << "--degree only applies to NURBS, the other spline types "
+                     "are cubic"
+                  << std::endl;
+        return false;
+    }
+    if (spline_degree < 1 || spline_degree > max_nurbs_degree) {
+        std::cout << fmt::format("Invalid argument --degree {{1, ..., {}}}",
+                                 max_nurbs_degree)
+                  << std::endl;
+        return false;
+    }
+    num_control_points = spline_degree + 1;
+    return true;
+}
+
+bool CheckArgEnds(std::vector<std::string> args) {
+    // end conditions of Interpolating curves
+    auto checkEnds = std::find(std::begin(args), std::end(args), "--ends");
+    if (checkEnds == std::end(args)) return true;
+    EndCondition ends;
+    if (++checkEnds == std::end(args) || !ParseEndCondition(*checkEnds, ends)) {
+        std::cout << "Invalid argument --ends {natural, clamped, periodic}"
+                  << std::endl;
+        return false;
+    }
+    if (spline_type != SplineType::Interpolating) {
+        std::cout << "--ends only applies to Interpolating curves" << std::endl;
+        return false;
+    }
+    interpolant = CubicInterpolant(ends);
+    std::cout << "Interpolating with " << EndConditionName(ends) << " ends"
+              << std::endl;
+    return true;
+}
+
+bool CheckArgKnots(std::vector<std::string> args) {
+    // knot vector of NURBS curves
+    auto checkKnots = std::find(std::begin(args), std::end(args), "--knots");
+    if (checkKnots == std::end(args)) return true;
+    KnotVector knot_vector;
+    if (++checkKnots == std::end(args) ||
+        !ParseKnotVector(*checkKnots, knot_vector)) {
+        std::cout << "Invalid argument --knots {uniform, clamped}" << std::endl;
+        return false;
+    }
+    if (spline_type != SplineType::NURBS) {
+        std::cout << "--knots only applies to NURBS" << std::endl;
+        return false;
+    }
+    spline_knots = knot_vector;
+    std::cout << "NURBS over " << KnotVectorName(spline_knots) << " knots"
+              << std::endl;
+    return true;
+}
+
+bool CheckArgKernel(std::vector<std::string> args) {
+    // batch evaluation kernel for imported point streams
+    auto checkKernel = std::find(std::begin(args), std::end(args), "--kernel");
+    if (checkKernel == std::end(args)) return true;
+    if (++checkKernel != std::end(args) &&
+        ParseBatchKernel(*checkKernel, batch_kernel)) {
+        std::cout << "Batch kernel: " << BatchKernelName(batch_kernel)
+                  << std::endl;
+        return true;
+    }
+    std::cout << "Invalid or unsupported argument --kernel {auto, reference, "
+                 "scalar, sse, avx2}"
+              << std::endl;
+    return false;
+}
+
+void CheckArgThreads(std::vector<std::string> args) {
+    // number of threads evaluating imported segments, 0 uses every core
+    auto checkThreads =
+        std::find(std::begin(args), std::end(args), "--threads");
+    if (checkThreads != std::end(args)) {
+        num_threads = std::stoul(*(++checkThreads));
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << "Evaluating with " << num_threads << " threads"
+                  << std::endl;
+    }
+}
+
+// Reads a distance in px, false unless text is a positive number
+static bool ParsePositive(const std::string& text, double& value) {
+    size_t end = 0;
+    try {
+        value = std::stod(text, &end);
+    } catch (const std::logic_error&) {
+        return false;
+    }
+    return end == text.size() && value > 0.0;
+}
+
+bool CheckArgTolerance(std::vector<std::string> args) {
+    // adaptive sampling to within the given distance in px
+    if (!CheckArgFlag(args, "--tolerance")) return true;
+    if (!ParsePositive(CheckArgString(args, "--tolerance"),
+                       spline_tolerance)) {
+        std::cout << "Invalid argument --tolerance {px > 0}" << std::endl;
+        return false;
+    }
+    if (spline_type == SplineType::NURBS) {
+        std::cout << "--tolerance needs a cubic spline type" << std::endl;
+        return false;
+    }
+    std::cout << "Adaptive sampling with tolerance " << spline_tolerance
+              << " px" << std::endl;
+    return true;
+}
+
+bool CheckArgSpacing(std::vector<std::string> args) {
+    // samples at equal steps of arc length of at most the given px
+    if (!CheckArgFlag(args, "--spacing")) return true;
+    if (!ParsePositive(CheckArgString(args, "--spacing"), spline_spacing)) {
+        std::cout << "Invalid argument --spacing {px > 0}" << std::endl;
+        return false;
+    }
+    if (spline_tolerance > 0.0) {
+        std::cout << "Choose one of --tolerance and --spacing" << std::endl;
+        return false;
+    }
+    std::cout << "Sampling at equal arc length, at most " << spline_spacing
+              << " px apart" << std::endl;
+    return true;
+}
+
+bool CheckArgFit(std::vector<std::string> args) {
+    // input samples are fitted with control points to within the given px
+    auto checkFit = std::find(std::begin(args), std::end(args), "--fit");
+    if (checkFit == std::end(args)) return true;
+    if (++checkFit == std::end(args)) {
+        std::cout << "No argument --fit {px}" << std::endl;
+        return false;
+    }
+    if (!ParsePositive(*checkFit, fit_tolerance)) {
+        std::cout << "Invalid argument --fit {px > 0}" << std::endl;
+        return false;
+    }
+    if (spline_type != SplineType::BSpline &&
+        spline_type != SplineType::Bezier) {
+        std::cout << "--fit needs BSpline or Bezier curves" << std::endl;
+        return false;
+    }
+    std::cout << "Fitting input samples to within " << fit_tolerance << " px"
+              << std::endl;
+    return true;
+}
+
+bool CheckArgExportFormat(std::vector<std::string> args) {
+    // file format of <e> exports and of headless output
+    auto checkFormat =
+        std::find(std::begin(args), std::end(args), "--export_format");
+    if (checkFormat == std::end(args)) return true;
+    if (++checkFormat != std::end(args) &&
+        ParseExportFormat(*checkFormat, export_format))
+        return true;
+    std::cout << "Invalid argument --export_format {csv, binary}" << std::endl;
+    return false;
+}
+
+bool CheckArgTrace(std::vector<std::string> args) {
+    // per-point messages flush the console on every edit
+    log_points = !CheckArgFlag(args, "--quiet");
+    if (!CheckArgFlag(args, "--trace")) return true;
+    traceFile = CheckArgString(args, "--trace");
+    if (traceFile.empty()) {
+        std::cout << "No argument --trace out.json" << std::endl;
+        return false;
+    }
+    StartTrace();
+    return true;
+}
+
+bool CheckArgFlag(std::vector<std::string> args, std::string flag) {
+    return std::find(std::begin(args), std::end(args), flag) != std::end(args);
+}
+
+std::string CheckArgString(std::vector<std::string> args, std::string flag) {
+    // returns the value following flag, or an empty string if not given
+    auto checkFlag = std::find(std::begin(args), std::end(args), flag);
+    if (checkFlag == std::end(args) || ++checkFlag == std::end(args)) return "";
+    return *checkFlag;
+}
@@ -0,0 +1,29 @@
+#ifndef SPLINE_PLOTTER_ARGS_H_
+#define SPLINE_PLOTTER_ARGS_H_
+
+#include <string>
+#include <vector>
+
+extern unsigned int showConvexHull;
+extern unsigned int frameRate;  // redraws per second at most, 0 for no limit
+extern bool printStats;
+extern std::string traceFile;  // Chrome trace written on exit, empty for none
+
+bool CheckArgSplineType(std::vector<std::string> args);
+void CheckArgConvexHull(std::vector<std::string> args);
+void CheckArgFrameRate(std::vector<std::string> args);
+void CheckArgContinuity(std::vector<std::string> args);
+bool CheckArgDegree(std::vector<std::string> args);
+bool CheckArgEnds(std::vector<std::string> args);
+bool CheckArgKnots(std::vector<std::string> args);
+bool CheckArgKernel(std::vector<std::string> args);
+void CheckArgThreads(std::vector<std::string> args);
+bool CheckArgTolerance(std::vector<std::string> args);
+bool CheckArgSpacing(std::vector<std::string> args);
+bool CheckArgFit(std::vector<std::string> args);
+bool CheckArgExportFormat(std::vector<std::string> args);
+bool CheckArgTrace(std::vector<std::string> args);
+bool CheckArgFlag(std::vector<std::string> args, std::string flag);
+std::string CheckArgString(std::vector<std::string> args, std::string flag);
+
+#endif  // SPLINE_PLOTTER_ARGS_H_
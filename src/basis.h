@@ -0,0 +1,135 @@
+#ifndef SPLINE_PLOTTER_BASIS_H_
+#define SPLINE_PLOTTER_BASIS_H_
+
+#include <Eigen/Core>
+#include <cmath>
+
+#include "spline.h"
+
+// Basis matrices M of Q = TMG, tabulated per spline type and degree. Rows are
+// ordered in descending powers of t to match the parameter vector T
+template <SplineType type, int degree>
+struct Basis;
+
+template <>
+struct Basis<SplineType::Hermite, 3> {
+    static constexpr double t_min = 0.0;
+    static constexpr double matrix[4][4] = {
+        {2, -2, 1, 1}, {-3, 3, -2, -1}, {0, 0, 1, 0}, {1, 0, 0, 0}};
+};
+
+template <>
+struct Basis<SplineType::Bezier, 3> {
+    static constexpr double t_min = 0.0;
+    static constexpr double matrix[4][4] = {
+        {-1, 3, -3, 1}, {3, -6, 3, 0}, {-3, 3, 0, 0}, {1, 0, 0, 0}};
+};
+
+template <>
+struct Basis<SplineType::BSpline, 3> {
+    static constexpr double t_min = 0.0;
+    static constexpr double matrix[4][4] = {
+        {-1.0 / 6, 3.0 / 6, -3.0 / 6, 1.0 / 6},
+        {3.0 / 6, -6.0 / 6, 3.0 / 6, 0.0 / 6},
+        {-3.0 / 6, 0.0 / 6, 3.0 / 6, 0.0 / 6},
+        {1.0 / 6, 4.0 / 6, 1.0 / 6, 0.0 / 6}};
+};
+
+template <>
+struct Basis<SplineType::CatmullRom, 3> {
+    static constexpr double t_min = 0.0;
+    static constexpr double matrix[4][4] = {
+        {-1.0 / 2, 3.0 / 2, -3.0 / 2, 1.0 / 2},
+        {2.0 / 2, -5.0 / 2, 4.0 / 2, -1.0 / 2},
+        {-1.0 / 2, 0.0 / 2, 1.0 / 2, 0.0 / 2},
+        {0.0 / 2, 2.0 / 2, 0.0 / 2, 0.0 / 2}};
+};
+
+// MINVO is parameterised over t in [-1, 1]
+template <>
+struct Basis<SplineType::MINVO, 3> {
+    static constexpr double t_min = -1.0;
+    static constexpr double matrix[4][4] = {
+        {-0.4302, 0.8349, -0.8349, 0.4302},
+        {0.4568, -0.4568, -0.4568, 0.4568},
+        {-0.02698, -0.7921, 0.7921, 0.02698},
+        {0.0004103, 0.4996, 0.4996, 0.0004103}};
+};
+
+template <SplineType type, int degree>
+Eigen::Matrix<double, degree + 1, degree + 1> BasisMatrix() {
+    return Eigen::Map<const Eigen::Matrix<double, degree + 1, degree + 1,
+                                          Eigen::RowMajor>>(
+        &Basis<type, degree>::matrix[0][0]);
+}
+
+template <SplineType type, int degree>
+Eigen::Matrix<double, degree + 1, 2> GeometryMatrix(
+    const PairVector& control_points) {
+    Eigen::Matrix<double, degree + 1, 2> geometry_matrix;  // G
+    if constexpr (type == SplineType::Hermite) {
+        // end points followed by the tangents at either end
+        geometry_matrix << control_points[0].first, control_points[0].second,
+            control_points[3].first, control_points[3].second,
+            control_points[1].first - control_points[0].first,
+            control_points[1].second - control_points[0].second,
+            control_points[3].first - control_points[2].first,
+            control_points[3].second - control_points[2].second;
+    } else {
+        for (int i = 0; i <= degree; i++) {
+            const ControlPoint& point =
+                control_points[static_cast<size_t>(i)];
+            geometry_matrix(i, 0) = point.first;
+            geometry_matrix(i, 1) = point.second;
+        }
+    }
+    return geometry_matrix;
+}
+
+template <int degree>
+Eigen::Matrix<double, 1, degree + 1> ParamVector(double t,
+                                                 unsigned int derivative) {
+    // T^(d): derivative of [t^p ... t 1], ordered in descending powers
+    Eigen::Matrix<double, 1, degree + 1> param_vec;  // T^(p)
+    for (int i = 0; i <= degree; i++) {
+        double coefficient = 1.0;
+        for (int k = 0; k < static_cast<int>(derivative); k++)
+            coefficient *= i - k;
+        int power = i - static_cast<int>(derivative);
+        param_vec(degree - i) =
+            power < 0 ? 0.0 : coefficient * std::pow(t, power);
+    }
+    return param_vec;
+}
+
+template <SplineType type, int degree>
+Eigen::Matrix<double, Eigen::Dynamic, degree + 1, Eigen::RowMajor>
+ComputeSampleTable(unsigned int spline_subdiv_, unsigned int derivative) {
+    // row i holds T(t_i)M for t_i = t_min + i / spline_subdiv_, so a segment
+    // is sampled by a single product with its geometry matrix
+    constexpr double t_min = Basis<type, degree>::t_min;
+    const Eigen::Matrix<double, degree + 1, degree + 1> basis_matrix =
+        BasisMatrix<type, degree>();
+    Eigen::Index num_samples =
+        static_cast<Eigen::Index>((1.0 - t_min) * spline_subdiv_) + 1;
+
+    Eigen::Matrix<double, Eigen::Dynamic, degree + 1, Eigen::RowMajor> table(
+        num_samples, degree + 1);
+    for (Eigen::Index i = 0; i < num_samples; i++) {
+        double t = t_min + static_cast<double>(i) / spline_subdiv_;
+        table.row(i) = ParamVector<degree>(t, derivative) * basis_matrix;
+    }
+    return table;
+}
+
+template <SplineType type, int degree, typename SampleTableType,
+          typename OutputType>
+void EvaluateSpline(const PairVector& control_points,
+                    const SampleTableType& sample_table, OutputType& spline) {
+    // Q = (TM)G into the rows of spline, which a map must already have
+    spline.resize(sample_table.rows(), 2);
+    spline.noalias() =
+        sample_table * GeometryMatrix<type, degree>(control_points);
+}
+
+#endif  // SPLINE_PLOTTER_BASIS_H_
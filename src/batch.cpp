@@ -0,0 +1,512 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "adaptive.h"
+#include "interpolate.h"
+#include "nurbs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPLINE_PLOTTER_X86 1
+#endif
+
+std::string BatchKernelName(BatchKernel kernel) {
+    switch (kernel) {
+        case BatchKernel::Reference:
+            return "reference";
+        case BatchKernel::Scalar:
+            return "scalar";
+        case BatchKernel::SSE:
+            return "sse";
+        case BatchKernel::AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+bool BatchKernelSupported(BatchKernel kernel) {
+    switch (kernel) {
+        case BatchKernel::Reference:
+        case BatchKernel::Scalar:
+            return true;
+#ifdef SPLINE_PLOTTER_X86
+        case BatchKernel::SSE:
+            return __builtin_cpu_supports("sse2");
+        case BatchKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+bool ParseBatchKernel(std::string name, BatchKernel& kernel) {
+    if (name == "auto") {
+        kernel = BatchKernel::Scalar;
+        for (BatchKernel widest : {BatchKernel::AVX2, BatchKernel::SSE}) {
+            if (BatchKernelSupported(widest)) {
+                kernel = widest;
+                break;
+            }
+        }
+        return true;
+    }
+    for (BatchKernel candidate : {BatchKernel::Reference, BatchKernel::Scalar,
+                                  BatchKernel::SSE, BatchKernel::AVX2}) {
+        if (name == BatchKernelName(candidate)) {
+            kernel = candidate;
+            return BatchKernelSupported(candidate);
+        }
+    }
+    return false;
+}
+
+SegmentBatch BuildSegmentBatch(
+    PairVector& coordinates, SplineType spline_type_,
+    unsigned int spline_degree_, unsigned int spline_subdiv_,
+    unsigned int first_segment, unsigned int num_segments_,
+    const std::vector<Eigen::Vector2d>& tangents) {
+    if (spline_degree_ != 3)
+        throw std::invalid_argument("only cubic spline bases are tabulated");
+
+    SegmentBatch batch;
+    batch.num_samples = NumSplineSamples(spline_type_, spline_subdiv_);
+    for (std::vector<double>* quantity :
+         {&batch.x, &batch.dx1, &batch.dx2, &batch.dx3, &batch.y, &batch.dy1,
+          &batch.dy2, &batch.dy3})
+        quantity->resize(num_segments_);
+
+    const double t0 = ParamStart(spline_type_);
+    const double h = 1.0 / spline_subdiv_;
+    for (unsigned int k = 0; k < num_segments_; k++) {
+        CoefficientMatrix coefficients =
+            spline_type_ == SplineType::Interpolating
+                ? InterpolatedCoefficients(coordinates, tangents,
+                                           first_segment + k)
+                : ComputeCoefficients(
+                      SegmentControlPoints(coordinates, spline_type_,
+                                           spline_degree_, first_segment + k),
+                      spline_type_);
+
+        // differences of p(t) = at^3 + bt^2 + ct + d at t0 with step h, taken
+        // analytically rather than from sampled values to limit cancellation
+        double start_diff[2][4];
+        for (Eigen::Index dim = 0; dim < 2; dim++) {
+            double a = coefficients(0, dim), b = coefficients(1, dim);
+            double c = coefficients(2, dim), d = coefficients(3, dim);
+            start_diff[dim][0] = ((a * t0 + b) * t0 + c) * t0 + d;
+            start_diff[dim][1] =
+                a * (3 * t0 * t0 * h + 3 * t0 * h * h + h * h * h) +
+                b * (2 * t0 * h + h * h) + c * h;
+            start_diff[dim][2] =
+                a * (6 * t0 * h * h + 6 * h * h * h) + 2 * b * h * h;
+            start_diff[dim][3] = 6 * a * h * h * h;
+        }
+        batch.x[k] = start_diff[0][0];
+        batch.dx1[k] = start_diff[0][1];
+        batch.dx2[k] = start_diff[0][2];
+        batch.dx3[k] = start_diff[0][3];
+        batch.y[k] = start_diff[1][0];
+        batch.dy1[k] = start_diff[1][1];
+        batch.dy2[k] = start_diff[1][2];
+        batch.dy3[k] = start_diff[1][3];
+    }
+    return batch;
+}
+
+static void EvaluateScalar(const SegmentBatch& batch, size_t begin, size_t end,
+                           double* samples_out) {
+    for (size_t k = begin; k < end; k++) {
+        double x = batch.x[k], dx1 = batch.dx1[k], dx2 = batch.dx2[k];
+        double y = batch.y[k], dy1 = batch.dy1[k], dy2 = batch.dy2[k];
+        const double dx3 = batch.dx3[k], dy3 = batch.dy3[k];
+
+        double* sample = samples_out + 2 * batch.num_samples * k;
+        for (unsigned int i = 0; i < batch.num_samples; i++) {
+            sample[0] = x;
+            sample[1] = y;
+            sample += 2;
+            x += dx1, dx1 += dx2, dx2 += dx3;
+            y += dy1, dy1 += dy2, dy2 += dy3;
+        }
+    }
+}
+
+#ifdef SPLINE_PLOTTER_X86
+static size_t EvaluateSSE(const SegmentBatch& batch, size_t begin, size_t end,
+                          double* samples_out) {
+    // two segments per register, returns the first segment left over
+    size_t k = begin;
+    for (; k + 2 <= end; k += 2) {
+        __m128d x = _mm_loadu_pd(&batch.x[k]);
+        __m128d dx1 = _mm_loadu_pd(&batch.dx1[k]);
+        __m128d dx2 = _mm_loadu_pd(&batch.dx2[k]);
+        const __m128d dx3 = _mm_loadu_pd(&batch.dx3[k]);
+        __m128d y = _mm_loadu_pd(&batch.y[k]);
+        __m128d dy1 = _mm_loadu_pd(&batch.dy1[k]);
+        __m128d dy2 = _mm_loadu_pd(&batch.dy2[k]);
+        const __m128d dy3 = _mm_loadu_pd(&batch.dy3[k]);
+
+        double* sample0 = samples_out + 2 * batch.num_samples * k;
+        double* sample1 = sample0 + 2 * batch.num_samples;
+        for (unsigned int i = 0; i < batch.num_samples; i++) {
+            // interleave into the (x, y) rows of each segment
+            _mm_storeu_pd(sample0 + 2 * i, _mm_unpacklo_pd(x, y));
+            _mm_storeu_pd(sample1 + 2 * i, _mm_unpackhi_pd(x, y));
+            x = _mm_add_pd(x, dx1);
+            dx1 = _mm_add_pd(dx1, dx2);
+            dx2 = _mm_add_pd(dx2, dx3);
+            y = _mm_add_pd(y, dy1);
+            dy1 = _mm_add_pd(dy1, dy2);
+            dy2 = _mm_add_pd(dy2, dy3);
+        }
+    }
+    return k;
+}
+
+__attribute__((target("avx2"))) static size_t EvaluateAVX2(
+    const SegmentBatch& batch, size_t begin, size_t end,
+    double* samples_out) {
+    // four segments per register, returns the first segment left over
+    size_t k = begin;
+    for (; k + 4 <= end; k += 4) {
+        __m256d x = _mm256_loadu_pd(&batch.x[k]);
+        __m256d dx1 = _mm256_loadu_pd(&batch.dx1[k]);
+        __m256d dx2 = _mm256_loadu_pd(&batch.dx2[k]);
+        const __m256d dx3 = _mm256_loadu_pd(&batch.dx3[k]);
+        __m256d y = _mm256_loadu_pd(&batch.y[k]);
+        __m256d dy1 = _mm256_loadu_pd(&batch.dy1[k]);
+        __m256d dy2 = _mm256_loadu_pd(&batch.dy2[k]);
+        const __m256d dy3 = _mm256_loadu_pd(&batch.dy3[k]);
+
+        double* sample[4];
+        sample[0] = samples_out + 2 * batch.num_samples * k;
+        for (unsigned int j = 1; j < 4; j++)
+            sample[j] = sample[j - 1] + 2 * batch.num_samples;
+        for (unsigned int i = 0; i < batch.num_samples; i++) {
+            // lo = (x0, y0, x2, y2), hi = (x1, y1, x3, y3)
+            __m256d lo = _mm256_unpacklo_pd(x, y);
+            __m256d hi = _mm256_unpackhi_pd(x, y);
+            _mm_storeu_pd(sample[0] + 2 * i, _mm256_castpd256_pd128(lo));
+            _mm_storeu_pd(sample[1] + 2 * i, _mm256_castpd256_pd128(hi));
+            _mm_storeu_pd(sample[2] + 2 * i, _mm256_extractf128_pd(lo, 1));
+            _mm_storeu_pd(sample[3] + 2 * i, _mm256_extractf128_pd(hi, 1));
+            x = _mm256_add_pd(x, dx1);
+            dx1 = _mm256_add_pd(dx1, dx2);
+            dx2 = _mm256_add_pd(dx2, dx3);
+            y = _mm256_add_pd(y, dy1);
+            dy1 = _mm256_add_pd(dy1, dy2);
+            dy2 = _mm256_add_pd(dy2, dy3);
+        }
+    }
+    return k;
+}
+#endif
+
+BezierBatch BuildBezierBatch(
+    PairVector& coordinates, SplineType spline_type_,
+    unsigned int spline_degree_, unsigned int spline_subdiv_,
+    unsigned int first_segment, unsigned int num_segments_,
+    const std::vector<Eigen::Vector2d>& tangents) {
+    if (spline_degree_ != 3)
+        throw std::invalid_argument("only cubic spline bases are tabulated");
+
+    BezierBatch batch;
+    batch.num_samples = NumSplineSamples(spline_type_, spline_subdiv_);
+    // the Bezier points span [t0, 1], which the samples divide evenly
+    const double h = 1.0 / (batch.num_samples - 1);
+    for (unsigned int i = 0; i < batch.num_samples; i++) {
+        double s = i * h, r = 1.0 - s;
+        for (double weight : {r * r * r, 3 * s * r * r, 3 * s * s * r,
+                              s * s * s})
+            batch.weights.push_back(static_cast<float>(weight));
+    }
+
+    std::vector<float>* points[4][2] = {{&batch.x0, &batch.y0},
+                                        {&batch.x1, &batch.y1},
+                                        {&batch.x2, &batch.y2},
+                                        {&batch.x3, &batch.y3}};
+    for (unsigned int k = 0; k < num_segments_; k++) {
+        BezierMatrix bezier =
+            spline_type_ == SplineType::Interpolating
+                ? InterpolatedBezier(coordinates, tangents, first_segment + k)
+                : ComputeBezierPoints(
+                      SegmentControlPoints(coordinates, spline_type_,
+                                           spline_degree_, first_segment + k),
+                      spline_type_);
+        for (Eigen::Index j = 0; j < 4; j++)
+            for (Eigen::Index dim = 0; dim < 2; dim++)
+                points[j][dim]->push_back(static_cast<float>(bezier(j, dim)));
+    }
+    return batch;
+}
+
+static void EvaluateBezierScalar(const BezierBatch& batch, size_t begin,
+                                 size_t end, float* samples_out) {
+    for (size_t k = begin; k < end; k++) {
+        const float x0 = batch.x0[k], x1 = batch.x1[k], x2 = batch.x2[k],
+                    x3 = batch.x3[k];
+        const float y0 = batch.y0[k], y1 = batch.y1[k], y2 = batch.y2[k],
+                    y3 = batch.y3[k];
+
+        float* sample = samples_out + 2 * batch.num_samples * k;
+        const float* w = batch.weights.data();
+        for (unsigned int i = 0; i < batch.num_samples; i++) {
+            sample[0] = w[0] * x0 + w[1] * x1 + w[2] * x2 + w[3] * x3;
+            sample[1] = w[0] * y0 + w[1] * y1 + w[2] * y2 + w[3] * y3;
+            sample += 2;
+            w += 4;
+        }
+    }
+}
+
+#ifdef SPLINE_PLOTTER_X86
+static size_t EvaluateBezierSSE(const BezierBatch& batch, size_t begin,
+                                size_t end, float* samples_out) {
+    // four segments per register, returns the first segment left over
+    size_t k = begin;
+    for (; k + 4 <= end; k += 4) {
+        const __m128 x0 = _mm_loadu_ps(&batch.x0[k]);
+        const __m128 x1 = _mm_loadu_ps(&batch.x1[k]);
+        const __m128 x2 = _mm_loadu_ps(&batch.x2[k]);
+        const __m128 x3 = _mm_loadu_ps(&batch.x3[k]);
+        const __m128 y0 = _mm_loadu_ps(&batch.y0[k]);
+        const __m128 y1 = _mm_loadu_ps(&batch.y1[k]);
+        const __m128 y2 = _mm_loadu_ps(&batch.y2[k]);
+        const __m128 y3 = _mm_loadu_ps(&batch.y3[k]);
+
+        __m64* sample[4];
+        for (unsigned int j = 0; j < 4; j++)
+            sample[j] = reinterpret_cast<__m64*>(
+                samples_out + 2 * batch.num_samples * (k + j));
+        const float* w = batch.weights.data();
+        for (unsigned int i = 0; i < batch.num_samples; i++, w += 4) {
+            __m128 w0 = _mm_set1_ps(w[0]), w1 = _mm_set1_ps(w[1]);
+            __m128 w2 = _mm_set1_ps(w[2]), w3 = _mm_set1_ps(w[3]);
+            __m128 x = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(w0, x0), _mm_mul_ps(w1, x1)),
+                _mm_add_ps(_mm_mul_ps(w2, x2), _mm_mul_ps(w3, x3)));
+            __m128 y = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(w0, y0), _mm_mul_ps(w1, y1)),
+                _mm_add_ps(_mm_mul_ps(w2, y2), _mm_mul_ps(w3, y3)));
+            // lo = (x0, y0, x1, y1), hi = (x2, y2, x3, y3), a sample of a
+            // segment in each 64 bits
+            __m128 lo = _mm_unpacklo_ps(x, y);
+            __m128 hi = _mm_unpackhi_ps(x, y);
+            _mm_storel_pi(sample[0] + i, lo);
+            _mm_storeh_pi(sample[1] + i, lo);
+            _mm_storel_pi(sample[2] + i, hi);
+            _mm_storeh_pi(sample[3] + i, hi);
+        }
+    }
+    return k;
+}
+
+__attribute__((target("avx2"))) static size_t EvaluateBezierAVX2(
+    const BezierBatch& batch, size_t begin, size_t end, float* samples_out) {
+    // eight segments per register, returns the first segment left over
+    size_t k = begin;
+    for (; k + 8 <= end; k += 8) {
+        const __m256 x0 = _mm256_loadu_ps(&batch.x0[k]);
+        const __m256 x1 = _mm256_loadu_ps(&batch.x1[k]);
+        const __m256 x2 = _mm256_loadu_ps(&batch.x2[k]);
+        const __m256 x3 = _mm256_loadu_ps(&batch.x3[k]);
+        const __m256 y0 = _mm256_loadu_ps(&batch.y0[k]);
+        const __m256 y1 = _mm256_loadu_ps(&batch.y1[k]);
+        const __m256 y2 = _mm256_loadu_ps(&batch.y2[k]);
+        const __m256 y3 = _mm256_loadu_ps(&batch.y3[k]);
+
+        __m64* sample[8];
+        for (unsigned int j = 0; j < 8; j++)
+            sample[j] = reinterpret_cast<__m64*>(
+                samples_out + 2 * batch.num_samples * (k + j));
+        const float* w = batch.weights.data();
+        for (unsigned int i = 0; i < batch.num_samples; i++, w += 4) {
+            __m256 w0 = _mm256_set1_ps(w[0]), w1 = _mm256_set1_ps(w[1]);
+            __m256 w2 = _mm256_set1_ps(w[2]), w3 = _mm256_set1_ps(w[3]);
+            __m256 x = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(w0, x0), _mm256_mul_ps(w1, x1)),
+                _mm256_add_ps(_mm256_mul_ps(w2, x2), _mm256_mul_ps(w3, x3)));
+            __m256 y = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(w0, y0), _mm256_mul_ps(w1, y1)),
+                _mm256_add_ps(_mm256_mul_ps(w2, y2), _mm256_mul_ps(w3, y3)));
+            // unpacking works within 128 bit lanes, so
+            // lo = (x0, y0, x1, y1, x4, y4, x5, y5) and hi the rest
+            __m256 lo = _mm256_unpacklo_ps(x, y);
+            __m256 hi = _mm256_unpackhi_ps(x, y);
+            __m128 lo0 = _mm256_castps256_ps128(lo);
+            __m128 hi0 = _mm256_castps256_ps128(hi);
+            __m128 lo1 = _mm256_extractf128_ps(lo, 1);
+            __m128 hi1 = _mm256_extractf128_ps(hi, 1);
+            _mm_storel_pi(sample[0] + i, lo0);
+            _mm_storeh_pi(sample[1] + i, lo0);
+            _mm_storel_pi(sample[2] + i, hi0);
+            _mm_storeh_pi(sample[3] + i, hi0);
+            _mm_storel_pi(sample[4] + i, lo1);
+            _mm_storeh_pi(sample[5] + i, lo1);
+            _mm_storel_pi(sample[6] + i, hi1);
+            _mm_storeh_pi(sample[7] + i, hi1);
+        }
+    }
+    return k;
+}
+#endif
+
+void EvaluateBezierBatch(const BezierBatch& batch, BatchKernel kernel,
+                         float* samples_out) {
+    size_t num_segments_ = batch.x0.size();
+
+    size_t remainder = 0;
+    switch (kernel) {
+#ifdef SPLINE_PLOTTER_X86
+        case BatchKernel::AVX2:
+            remainder =
+                EvaluateBezierAVX2(batch, 0, num_segments_, samples_out);
+            break;
+        case BatchKernel::SSE:
+            remainder = EvaluateBezierSSE(batch, 0, num_segments_, samples_out);
+            break;
+#endif
+        case BatchKernel::Scalar:
+            break;
+        default:
+            throw std::invalid_argument("unsupported batch kernel " +
+                                        BatchKernelName(kernel));
+    }
+    EvaluateBezierScalar(batch, remainder, num_segments_, samples_out);
+}
+
+void EvaluateSegmentBatch(const SegmentBatch& batch, BatchKernel kernel,
+                          double* samples_out) {
+    size_t num_segments_ = batch.x.size();
+
+    size_t remainder = 0;
+    switch (kernel) {
+#ifdef SPLINE_PLOTTER_X86
+        case BatchKernel::AVX2:
+            remainder = EvaluateAVX2(batch, 0, num_segments_, samples_out);
+            break;
+        case BatchKernel::SSE:
+            remainder = EvaluateSSE(batch, 0, num_segments_, samples_out);
+            break;
+#endif
+        case BatchKernel::Scalar:
+            break;
+        default:
+            throw std::invalid_argument("unsupported batch kernel " +
+                                        BatchKernelName(kernel));
+    }
+    EvaluateScalar(batch, remainder, num_segments_, samples_out);
+}
+
+// NURBS segments, and the others with the reference kernel, from their
+// cached tables
+static void ComputeSplinesFromTables(
+    PairVector& coordinates, SplineType spline_type_,
+    unsigned int spline_degree_, unsigned int spline_subdiv_,
+    unsigned int first_segment, unsigned int num_segments_,
+    double* samples_out, const std::vector<double>& weights,
+    const std::vector<Eigen::Vector2d>& tangents,
+    const std::vector<double>& knots) {
+    if (spline_type_ == SplineType::NURBS) {
+        const Eigen::Index num_samples =
+            NumSplineSamples(spline_type_, spline_subdiv_);
+        for (unsigned int k = 0; k < num_segments_; k++) {
+            unsigned int start =
+                SegmentStart(spline_type_, spline_degree_, first_segment + k);
+            ComputeNURBS(&coordinates[start],
+                         SegmentWeights(weights, spline_type_, spline_degree_,
+                                        first_segment + k),
+                         SegmentKnots(knots, spline_type_, spline_degree_,
+                                      first_segment + k),
+                         spline_degree_, spline_subdiv_, 0,
+                         Eigen::Map<SplineMatrix>(
+                             samples_out + 2 * num_samples * k, num_samples,
+                             2));
+        }
+        return;
+    }
+    const Eigen::Index num_samples =
+        NumSplineSamples(spline_type_, spline_subdiv_);
+    if (spline_type_ == SplineType::Interpolating) {
+        const SampleTable& sample_table =
+            LookupSampleTable(spline_type_, spline_subdiv_, 0);
+        for (unsigned int k = 0; k < num_segments_; k++)
+            Eigen::Map<SplineMatrix>(samples_out + 2 * num_samples * k,
+                                     num_samples, 2)
+                .noalias() = sample_table *
+                             InterpolatedGeometry(coordinates, tangents,
+                                                  first_segment + k);
+        return;
+    }
+    for (unsigned int k = 0; k < num_segments_; k++) {
+        PairVector control_points = SegmentControlPoints(
+            coordinates, spline_type_, spline_degree_, first_segment + k);
+        ComputeSpline(control_points, spline_type_, spline_degree_,
+                      spline_subdiv_, 0,
+                      Eigen::Map<SplineMatrix>(
+                          samples_out + 2 * num_samples * k, num_samples, 2));
+    }
+}
+
+template <typename Scalar>
+void ComputeSplines(PairVector& coordinates, SplineType spline_type_,
+                    unsigned int spline_degree_, unsigned int spline_subdiv_,
+                    unsigned int first_segment, unsigned int num_segments_,
+                    BatchKernel kernel, Scalar* samples_out,
+                    const std::vector<double>& weights,
+                    const std::vector<Eigen::Vector2d>& tangents,
+                    const std::vector<double>& knots) {
+    static_assert(std::is_same_v<Scalar, double> ||
+                      std::is_same_v<Scalar, float>,
+                  "samples are double or float");
+    const bool from_tables = spline_type_ == SplineType::NURBS ||
+                             kernel == BatchKernel::Reference;
+    if constexpr (std::is_same_v<Scalar, double>) {
+        if (from_tables) {
+            ComputeSplinesFromTables(coordinates, spline_type_,
+                                     spline_degree_, spline_subdiv_,
+                                     first_segment, num_segments_,
+                                     samples_out, weights, tangents, knots);
+            return;
+        }
+        SegmentBatch batch = BuildSegmentBatch(
+            coordinates, spline_type_, spline_degree_, spline_subdiv_,
+            first_segment, num_segments_, tangents);
+        EvaluateSegmentBatch(batch, kernel, samples_out);
+    } else {
+        if (from_tables) {
+            std::vector<double> samples(
+                2 * static_cast<size_t>(num_segments_) *
+                NumSplineSamples(spline_type_, spline_subdiv_));
+            ComputeSplinesFromTables(coordinates, spline_type_,
+                                     spline_degree_, spline_subdiv_,
+                                     first_segment, num_segments_,
+                                     samples.data(), weights, tangents,
+                                     knots);
+            std::transform(
+                samples.begin(), samples.end(), samples_out,
+                [](double value) { return static_cast<float>(value); });
+            return;
+        }
+        BezierBatch batch = BuildBezierBatch(
+            coordinates, spline_type_, spline_degree_, spline_subdiv_,
+            first_segment, num_segments_, tangents);
+        EvaluateBezierBatch(batch, kernel, samples_out);
+    }
+}
+
+template void ComputeSplines(PairVector&, SplineType, unsigned int,
+                             unsigned int, unsigned int, unsigned int,
+                             BatchKernel, double*, const std::vector<double>&,
+                             const std::vector<Eigen::Vector2d>&,
+                             const std::vector<double>&);
+template void ComputeSplines(PairVector&, SplineType, unsigned int,
+                             unsigned int, unsigned int, unsigned int,
+                             BatchKernel, float*, const std::vector<double>&,
+                             const std::vector<Eigen::Vector2d>&,
+                             const std::vector<double>&);
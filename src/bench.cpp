@@ -0,0 +1,551 @@
+// Benchmarks segment evaluation, convex hulls, arc length tables and export on
+// fixed-seed random control points, for every spline type at several scene
+// sizes, then NURBS evaluation as the degree grows, spatial index queries and
+// interpolating spline updates on drawn curves of up to a million segments,
+// double against float samples, level of detail frames over about 10^7
+// samples and least squares fits of as many
+//   ./spline_bench [--quick]
+// --quick runs the smallest size only, which is enough to train a PGO build.
+// Rendering needs a GL context, so frame times are measured in the plotter
+// itself with --stats
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "adaptive.h"
+#include "arclength.h"
+#include "arena.h"
+#include "args.h"
+#include "batch.h"
+#include "binary.h"
+#include "export.h"
+#include "fit.h"
+#include "interpolate.h"
+#include "intersect.h"
+#include "lod.h"
+#include "nurbs.h"
+#include "spatial.h"
+#include "spline.h"
+#include "viewport.h"
+
+// every heap allocation of the process goes through malloc, so counting it
+// here also catches Eigen's matrices
+static std::atomic<unsigned long long> num_allocations(0);
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+
+extern "C" void* malloc(size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+static const unsigned int screen_width = 1280;
+static const unsigned int screen_height = 800;
+static const unsigned int spline_degree = 3;
+static const unsigned int spline_subdiv = 150;
+static const double spline_tolerance = 0.5;
+static const unsigned int num_arc_length_queries = 1000;
+static const unsigned int num_spatial_queries = 1000;
+// control points of the level of detail curve, 10^7 samples at spline_subdiv
+static const unsigned int num_lod_points = 66000;
+// px, pick radius of the plotter and largest step of a drawn curve
+static const int pick_radius = 10;
+static const int max_step = 16;
+// repeats each benchmark until it has run for this long
+static const double min_seconds = 0.2;
+
+static PairVector RandomPoints(unsigned int num_points_) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> x(0, screen_width - 1);
+    std::uniform_int_distribution<int> y(0, screen_height - 1);
+    PairVector coordinates;
+    for (unsigned int i = 0; i < num_points_; i++)
+        coordinates.push_back(std::make_pair(x(generator), y(generator)));
+    return coordinates;
+}
+
+// Runs body until min_seconds have passed, then prints the time and
+// allocations per item, where body handles num_items items per run
+static void Report(const std::string& name, unsigned int num_points_,
+                   const std::string& unit, unsigned long long num_items,
+                   const std::function<void()>& body) {
+    unsigned long long runs = 0;
+    unsigned long long allocations_before = num_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0.0);
+    while (runs == 0 || elapsed.count() < min_seconds) {
+        body();
+        runs++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    double items = static_cast<double>(runs * num_items);
+    double allocations =
+        static_cast<double>(num_allocations.load() - allocations_before);
+    std::cout << fmt::format("{:<32} {:>8} {:>8} {:>12.2f} {:>12.3f} {:>12.4f}",
+                             name, num_points_, unit,
+                             1e9 * elapsed.count() / items,
+                             items / elapsed.count() / 1e6,
+                             allocations / items)
+              << std::endl;
+}
+
+static void RunBenchmarks(SplineType spline_type_, unsigned int num_points_) {
+    PairVector coordinates = RandomPoints(num_points_);
+    unsigned int num_segments_ =
+        NumSegments(spline_type_, spline_degree, num_points_);
+    std::string type_name = SplineTypeName(spline_type_);
+    SampleArena splines;
+    double* samples = splines.AppendUniform(
+        num_segments_, NumSplineSamples(spline_type_, spline_subdiv));
+    const unsigned long long num_samples =
+        static_cast<unsigned long long>(splines.NumSamples());
+
+    for (BatchKernel kernel : {BatchKernel::Reference, BatchKernel::Scalar,
+                               BatchKernel::SSE, BatchKernel::AVX2}) {
+        if (!BatchKernelSupported(kernel)) continue;
+        Report(type_name + " evaluate " + BatchKernelName(kernel),
+               num_points_, "sample", num_samples, [&] {
+                   ComputeSplines(coordinates, spline_type_, spline_degree,
+                                  spline_subdiv, 0, num_segments_, kernel,
+                                  samples);
+               });
+    }
+
+    SampleArena adaptive;
+    auto evaluate_adaptive = [&] {
+        adaptive.Clear();
+        for (unsigned int k = 0; k < num_segments_; k++)
+            adaptive.Append(ComputeSplineAdaptive(
+                SegmentControlPoints(coordinates, spline_type_, spline_degree,
+                                     k),
+                spline_type_, spline_degree, spline_tolerance));
+    };
+    evaluate_adaptive();
+    Report(type_name + " evaluate adaptive", num_points_, "sample",
+           static_cast<unsigned long long>(adaptive.NumSamples()),
+           evaluate_adaptive);
+
+    std::vector<PairVector> hulls(num_segments_);
+    Report(type_name + " hull", num_points_, "segment", num_segments_, [&] {
+        for (unsigned int k = 0; k < num_segments_; k++)
+            hulls[k] = SortConvex(SegmentControlPoints(
+                coordinates, spline_type_, spline_degree, k));
+    });
+
+    Report(type_name + " arc length table", num_points_, "segment",
+           num_segments_, [&] {
+               CurveArcLength tables(coordinates, {}, {}, spline_type_,
+                                     spline_degree);
+           });
+    CurveArcLength arc_length(coordinates, {}, {}, spline_type_,
+                              spline_degree);
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> distance(0.0, arc_length.Length());
+    std::vector<double> queries(num_arc_length_queries);
+    for (double& s : queries) s = distance(generator);
+    Eigen::Vector2d point_sum = Eigen::Vector2d::Zero();
+    Report(type_name + " arc length lookup", num_points_, "query",
+           num_arc_length_queries, [&] {
+               for (double s : queries)
+                   point_sum += arc_length.PointAtLength(s);
+           });
+
+    // written to /dev/null to time formatting rather than the disk
+    std::ofstream sink("/dev/null", std::ios::binary);
+    Report(type_name + " export csv", num_points_, "sample",
+           num_samples, [&] { WriteSplines(sink, splines); });
+    SplineFileInfo info;
+    info.spline_type = spline_type_;
+    info.degree = spline_degree;
+    info.subdiv = spline_subdiv;
+    Report(type_name + " export binary", num_points_, "sample", num_samples,
+           [&] { WriteSplinesBinary(sink, splines, info); });
+}
+
+static void RunDegreeBenchmarks(unsigned int nurbs_degree,
+                                unsigned int num_points_) {
+    PairVector coordinates = RandomPoints(num_points_);
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> weight(0.5, 2.0);
+    std::vector<double> weights(num_points_);
+    for (double& w : weights) w = weight(generator);
+
+    unsigned int num_segments_ =
+        NumSegments(SplineType::NURBS, nurbs_degree, num_points_);
+    std::string name = fmt::format("NURBS p={}", nurbs_degree);
+    SampleArena splines;
+    double* samples = splines.AppendUniform(
+        num_segments_, NumSplineSamples(SplineType::NURBS, spline_subdiv));
+    const unsigned long long num_samples =
+        static_cast<unsigned long long>(splines.NumSamples());
+
+    // tabulated basis functions, O(p) per sample
+    Report(name + " evaluate", num_points_, "sample", num_samples, [&] {
+        ComputeSplines(coordinates, SplineType::NURBS, nurbs_degree,
+                       spline_subdiv, 0, num_segments_, BatchKernel::Reference,
+                       samples, weights);
+    });
+    // the same with clamped knots, whose 2(p - 1) end segments are evaluated
+    // from their basis functions at every sample
+    std::vector<double> clamped = ClampedKnots(nurbs_degree, num_points_);
+    Report(name + " clamped", num_points_, "sample", num_samples, [&] {
+        ComputeSplines(coordinates, SplineType::NURBS, nurbs_degree,
+                       spline_subdiv, 0, num_segments_, BatchKernel::Reference,
+                       samples, weights, {}, clamped);
+    });
+
+    // de Boor at every sample along the whole curve, O(p^2) per sample
+    std::vector<double> knots = UniformKnots(nurbs_degree, num_points_);
+    Report(name + " de Boor", num_points_, "sample", num_samples, [&] {
+        KnotSpanCache spans(knots, nurbs_degree);
+        double* sample = samples;
+        for (unsigned int k = 0; k < num_segments_; k++) {
+            for (unsigned int i = 0; i <= spline_subdiv; i++) {
+                double u = knots[k + nurbs_degree] +
+                           static_cast<double>(i) / spline_subdiv;
+                Eigen::Vector2d point = DeBoor(knots, coordinates, weights,
+                                               nurbs_degree, spans.Find(u), u);
+                sample[0] = point(0);
+                sample[1] = point(1);
+                sample += 2;
+            }
+        }
+    });
+}
+
+// Control points of a random walk, as a curve drawn by hand, which stays
+// local however long it gets, unlike points spread over the whole screen
+static PairVector RandomWalk(unsigned int num_points_) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> step(-max_step, max_step);
+    PairVector coordinates;
+    ControlPoint point(screen_width / 2, screen_height / 2);
+    for (unsigned int i = 0; i < num_points_; i++) {
+        point.first += step(generator);
+        point.second += step(generator);
+        coordinates.push_back(point);
+    }
+    return coordinates;
+}
+
+static void RunSpatialBenchmarks(unsigned int num_points_) {
+    const SplineType spline_type_ = SplineType::BSpline;
+    PairVector coordinates = RandomWalk(num_points_);
+    unsigned int num_segments_ =
+        NumSegments(spline_type_, spline_degree, num_points_);
+
+    SpatialGrid points_index, segments_index;
+    Report("spatial index segments", num_points_, "segment", num_segments_,
+           [&] {
+               segments_index.Clear();
+               for (unsigned int k = 0; k < num_segments_; k++)
+                   segments_index.Insert(
+                       k, SegmentBounds(SegmentControlPoints(
+                                            coordinates, spline_type_,
+                                            spline_degree, k),
+                                        spline_type_, spline_degree));
+           });
+    for (unsigned int i = 0; i < num_points_; i++)
+        points_index.Insert(i, PointBounds(coordinates[i]));
+
+    // queries near random points of the curve, as clicks on it would be
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<unsigned int> index(0, num_points_ - 1);
+    std::uniform_int_distribution<int> offset(-2 * max_step, 2 * max_step);
+    PairVector queries(num_spatial_queries);
+    for (auto& query : queries) {
+        query = coordinates[index(generator)];
+        query.first += offset(generator);
+        query.second += offset(generator);
+    }
+    int found = 0;
+    Report("spatial pick point", num_points_, "query", num_spatial_queries,
+           [&] {
+               for (auto query : queries)
+                   found += NearestPoint(points_index, coordinates,
+                                         query.first, query.second,
+                                         pick_radius);
+           });
+    Report("spatial closest point", num_points_, "query",
+           num_spatial_queries, [&] {
+               for (auto query : queries)
+                   found += ClosestPointOnCurve(segments_index, coordinates,
+                                                {}, {}, {}, spline_type_,
+                                                spline_degree, query.first,
+                                                query.second)
+                                .segment;
+           });
+}
+
+static void RunInterpolationBenchmarks(unsigned int num_points_) {
+    // the points appended one at a time are drawn after the first num_points_
+    PairVector walk = RandomWalk(num_points_ + num_spatial_queries);
+    PairVector coordinates(walk.begin(), walk.begin() + num_points_);
+
+    for (EndCondition ends : {EndCondition::Natural, EndCondition::Periodic}) {
+        std::string name = "Interpolating " + EndConditionName(ends);
+        CubicInterpolant interpolant(ends);
+        Report(name + " solve", num_points_, "point", num_points_, [&] {
+            interpolant.Clear();
+            interpolant.Update(coordinates, 0, num_points_);
+        });
+        // the first append of a run also drops the last run's points
+        Report(name + " append", num_points_, "point", num_spatial_queries,
+               [&] {
+                   coordinates.resize(num_points_);
+                   interpolant.Update(coordinates, num_points_, num_points_);
+                   for (unsigned int i = 0; i < num_spatial_queries; i++) {
+                       coordinates.push_back(walk[num_points_ + i]);
+                       interpolant.Update(coordinates, num_points_ + i,
+                                          num_points_ + i + 1);
+                   }
+               });
+        coordinates.resize(num_points_);
+        interpolant.Update(coordinates, num_points_, num_points_);
+
+        std::mt19937 generator(42);
+        std::uniform_int_distribution<unsigned int> index(0, num_points_ - 1);
+        std::uniform_int_distribution<int> offset(-max_step, max_step);
+        Report(name + " move", num_points_, "point", num_spatial_queries,
+               [&] {
+                   for (unsigned int i = 0; i < num_spatial_queries; i++) {
+                       unsigned int moved = index(generator);
+                       coordinates[moved].first += offset(generator);
+                       interpolant.Update(coordinates, moved, moved + 1);
+                   }
+               });
+    }
+
+    CubicInterpolant interpolant;
+    interpolant.Update(coordinates, 0, num_points_);
+    const unsigned int num_segments_ = interpolant.NumSegments();
+    SampleArena splines;
+    double* samples = splines.AppendUniform(
+        num_segments_,
+        NumSplineSamples(SplineType::Interpolating, spline_subdiv));
+    Report("Interpolating evaluate", num_points_, "sample",
+           static_cast<unsigned long long>(splines.NumSamples()), [&] {
+               ComputeSplines(coordinates, SplineType::Interpolating,
+                              spline_degree, spline_subdiv, 0, num_segments_,
+                              BatchKernel::Scalar, samples, {},
+                              interpolant.Tangents());
+           });
+}
+
+// Evaluates CatmullRom segments into double and float samples with every
+// batch kernel, then reports the largest distance of either from the
+// reference kernel's doubles
+static void RunPrecisionBenchmarks(unsigned int num_points_) {
+    const SplineType spline_type_ = SplineType::CatmullRom;
+    PairVector coordinates = RandomPoints(num_points_);
+    const unsigned int num_segments_ =
+        NumSegments(spline_type_, spline_degree, num_points_);
+    const size_t num_values =
+        2 * static_cast<size_t>(num_segments_) *
+        NumSplineSamples(spline_type_, spline_subdiv);
+    std::vector<double> reference(num_values), doubles(num_values);
+    std::vector<float> floats(num_values);
+    ComputeSplines(coordinates, spline_type_, spline_degree, spline_subdiv, 0,
+                   num_segments_, BatchKernel::Reference, reference.data());
+
+    auto report_error = [&](const std::string& name, auto& samples) {
+        double error = 0.0;
+        for (size_t i = 0; i < num_values; i++)
+            error = std::max(error, std::abs(samples[i] - reference[i]));
+        std::cout << fmt::format("{:<32} {:>8} {:>8} {:>12.2e}", name,
+                                 num_points_, "px", error)
+                  << std::endl;
+    };
+    for (BatchKernel kernel :
+         {BatchKernel::Scalar, BatchKernel::SSE, BatchKernel::AVX2}) {
+        if (!BatchKernelSupported(kernel)) continue;
+        std::string name = "CatmullRom " + BatchKernelName(kernel);
+        Report(name + " double", num_points_, "sample", num_values / 2, [&] {
+            ComputeSplines(coordinates, spline_type_, spline_degree,
+                           spline_subdiv, 0, num_segments_, kernel,
+                           doubles.data());
+        });
+        Report(name + " float", num_points_, "sample", num_values / 2, [&] {
+            ComputeSplines(coordinates, spline_type_, spline_degree,
+                           spline_subdiv, 0, num_segments_, kernel,
+                           floats.data());
+        });
+        report_error(name + " double error", doubles);
+        report_error(name + " float error", floats);
+    }
+}
+
+static void RunLodBenchmarks(unsigned int num_points_) {
+    const SplineType spline_type_ = SplineType::BSpline;
+    PairVector coordinates = RandomWalk(num_points_);
+    unsigned int num_segments_ =
+        NumSegments(spline_type_, spline_degree, num_points_);
+    SampleArena splines;
+    ComputeSplines(coordinates, spline_type_, spline_degree, spline_subdiv, 0,
+                   num_segments_, BatchKernel::Scalar,
+                   splines.AppendUniform(
+                       num_segments_,
+                       NumSplineSamples(spline_type_, spline_subdiv)));
+    const unsigned long long num_samples =
+        static_cast<unsigned long long>(splines.NumSamples());
+
+    LodPyramid lod;
+    Report("lod build", num_points_, "sample", num_samples, [&] {
+        lod.Clear();
+        lod.Update(splines, 0, num_segments_);
+    });
+    BoundingBox extent{0.0, 0.0, 0.0, 0.0};
+    for (unsigned int c = 0; c < lod.NumChunks(); c++) {
+        const BoundingBox& bounds = lod.Chunk(c).bounds;
+        if (c == 0) extent = bounds;
+        extent.min_x = std::min(extent.min_x, bounds.min_x);
+        extent.min_y = std::min(extent.min_y, bounds.min_y);
+        extent.max_x = std::max(extent.max_x, bounds.max_x);
+        extent.max_y = std::max(extent.max_y, bounds.max_y);
+    }
+
+    // a frame culls the chunks and gathers the level the zoom calls for, as
+    // the plotter does before drawing. Level 0 is drawn from the samples
+    // zoomed in on the middle of the curve, so the view is never empty
+    const double* middle =
+        splines.Data() + 2 * splines.SegmentOffset(num_segments_ / 2);
+    std::vector<unsigned int> chunks;
+    LodStrips strips;
+    for (double zoom : {1.0, 16.0, 256.0}) {
+        Viewport view(screen_width, screen_height);
+        view.Fit(extent, 0.0);
+        Eigen::Vector2d centre = view.WorldToScreen(middle[0], middle[1]);
+        view.ZoomAt(centre(0), centre(1), zoom);
+        unsigned int level = LodPyramid::ChooseLevel(view.PixelSize());
+        Report(fmt::format("lod frame zoom {}x", zoom), num_points_, "frame",
+               1, [&] {
+                   chunks.clear();
+                   strips.Clear();
+                   lod.VisibleChunks(view.Visible(), chunks);
+                   lod.Gather(chunks, level, strips);
+               });
+        size_t num_vertices = static_cast<size_t>(strips.NumVertices());
+        if (level == 0) {
+            for (unsigned int c : chunks) {
+                unsigned int last =
+                    std::min((c + 1) * lod_chunk_segments, num_segments_);
+                for (unsigned int k = c * lod_chunk_segments; k < last; k++)
+                    num_vertices +=
+                        static_cast<size_t>(splines.SegmentSamples(k));
+            }
+        }
+        std::cout << fmt::format("  level {}, {} of {} chunks, {} vertices",
+                                 level, chunks.size(), lod.NumChunks(),
+                                 num_vertices)
+                  << std::endl;
+    }
+}
+
+static void RunFitBenchmarks(unsigned int num_points_) {
+    // dense samples of a drawn curve, as a trajectory would be recorded
+    const SplineType spline_type_ = SplineType::BSpline;
+    PairVector coordinates = RandomWalk(num_points_);
+    const unsigned int num_segments_ =
+        NumSegments(spline_type_, spline_degree, num_points_);
+    std::vector<double> values(2 * static_cast<size_t>(num_segments_) *
+                               NumSplineSamples(spline_type_, spline_subdiv));
+    ComputeSplines(coordinates, spline_type_, spline_degree, spline_subdiv, 0,
+                   num_segments_, BatchKernel::Scalar, values.data());
+    PairVector samples;
+    samples.reserve(values.size() / 2);
+    for (size_t i = 0; i < values.size(); i += 2)
+        samples.emplace_back(values[i], values[i + 1]);
+
+    for (double tolerance : {1.0, 0.1}) {
+        FitReport report;
+        PairVector fitted;
+        Report(fmt::format("fit {} px", tolerance), num_points_, "sample",
+               samples.size(), [&] {
+                   fitted = FitBSpline(samples, tolerance, &report);
+               });
+        std::cout << fmt::format("  {} control points, {} rounds, max error "
+                                 "{:.3g} px",
+                                 fitted.size(), report.num_rounds,
+                                 report.max_error)
+                  << std::endl;
+    }
+}
+
+static void RunIntersectionBenchmarks(unsigned int num_points_) {
+    // a random walk crosses itself about once per segment
+    const SplineType spline_type_ = SplineType::BSpline;
+    PairVector coordinates = RandomWalk(num_points_);
+    const unsigned int num_segments_ =
+        NumSegments(spline_type_, spline_degree, num_points_);
+    std::vector<BezierMatrix> segments;
+    for (unsigned int k = 0; k < num_segments_; k++)
+        segments.push_back(ComputeBezierPoints(
+            SegmentControlPoints(coordinates, spline_type_, spline_degree, k),
+            spline_type_));
+
+    std::vector<Intersection> intersections;
+    Report("intersections", num_points_, "segment", num_segments_,
+           [&] { intersections = FindIntersections(segments); });
+    std::cout << fmt::format("  {} intersections", intersections.size())
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv, argv + argc);
+    std::vector<unsigned int> sizes = {1000, 10000, 100000};
+    std::vector<unsigned int> spatial_sizes = {1000, 10000, 100000, 1000000};
+    unsigned int lod_points = num_lod_points;
+    std::vector<unsigned int> fit_sizes = {1000, num_lod_points};
+    if (CheckArgFlag(args, "--quick")) {
+        sizes = spatial_sizes = fit_sizes = {1000};
+        lod_points = 1000;
+    }
+
+    std::cout << fmt::format("{:<32} {:>8} {:>8} {:>12} {:>12} {:>12}",
+                             "benchmark", "points", "per", "ns/item",
+                             "Mitems/s", "allocs/item")
+              << std::endl;
+    for (SplineType spline_type_ :
+         {SplineType::Hermite, SplineType::Bezier, SplineType::BSpline,
+          SplineType::CatmullRom, SplineType::MINVO})
+        for (unsigned int num_points_ : sizes)
+            RunBenchmarks(spline_type_, num_points_);
+    // time per sample does not depend on the number of points
+    for (unsigned int nurbs_degree : {1u, 2u, 3u, 5u, 7u, 10u, 15u})
+        RunDegreeBenchmarks(nurbs_degree, sizes.front());
+    for (unsigned int num_points_ : spatial_sizes)
+        RunSpatialBenchmarks(num_points_);
+    for (unsigned int num_points_ : spatial_sizes)
+        RunInterpolationBenchmarks(num_points_);
+    for (unsigned int num_points_ : sizes)
+        RunPrecisionBenchmarks(num_points_);
+    RunLodBenchmarks(lod_points);
+    for (unsigned int num_points_ : fit_sizes) RunFitBenchmarks(num_points_);
+    for (unsigned int num_points_ : spatial_sizes)
+        RunIntersectionBenchmarks(num_points_);
+    return EXIT_SUCCESS;
+}
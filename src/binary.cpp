@@ -0,0 +1,199 @@
+#include "binary.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+static void AppendLittleEndian(uint64_t value, unsigned int bytes,
+                               std::vector<char>& buffer) {
+    for (unsigned int i = 0; i < bytes; i++)
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+static void AppendDouble(double value, std::vector<char>& buffer) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    AppendLittleEndian(bits, 8, buffer);
+}
+
+static void Flush(std::ostream& output, std::vector<char>& buffer) {
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
+
+// byte positions of the sections of a binary spline file
+static const std::streamoff num_samples_position = 40;
+static const std::streamoff offsets_position = 48;
+
+SplineFileWriter::SplineFileWriter(std::ostream& output,
+                                   const SplineFileInfo& info,
+                                   uint64_t num_segments)
+    : output_(output), num_segments_(num_segments) {
+    buffer_.assign(spline_file_magic, spline_file_magic + 4);
+    AppendLittleEndian(spline_file_version, 4, buffer_);
+    AppendLittleEndian(static_cast<uint32_t>(info.spline_type), 4, buffer_);
+    AppendLittleEndian(info.degree, 4, buffer_);
+    AppendLittleEndian(info.subdiv, 4, buffer_);
+    AppendLittleEndian(0, 4, buffer_);
+    AppendDouble(info.tolerance, buffer_);
+    AppendLittleEndian(num_segments, 8, buffer_);
+    AppendLittleEndian(0, 8, buffer_);  // num_samples, written by Finish
+
+    // offsets[0] is 0, the rest are written as segments are appended
+    buffer_.resize(buffer_.size() + 8 * (num_segments + 1), 0);
+    Flush(output_, buffer_);
+}
+
+static bool IsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    return first_byte == 1;
+}
+
+void SplineFileWriter::Append(const SampleArena& segments) {
+    unsigned int count = segments.NumSegments();
+    if (segments_written_ + count > num_segments_)
+        throw std::runtime_error("more segments than the file has room for");
+
+    uint64_t first_sample = samples_written_;
+    for (unsigned int k = 1; k <= count; k++)
+        AppendLittleEndian(
+            first_sample + static_cast<uint64_t>(segments.SegmentOffset(k)), 8,
+            buffer_);
+    samples_written_ += static_cast<uint64_t>(segments.NumSamples());
+    std::streampos end = output_.tellp();
+    output_.seekp(offsets_position + static_cast<std::streamoff>(
+                                         8 * (segments_written_ + 1)));
+    Flush(output_, buffer_);
+    output_.seekp(end);
+    segments_written_ += count;
+
+    // the arena already holds the samples in file order
+    const size_t num_values = 2 * static_cast<size_t>(segments.NumSamples());
+    if (IsLittleEndian()) {
+        output_.write(reinterpret_cast<const char*>(segments.Data()),
+                      static_cast<std::streamsize>(num_values *
+                                                   sizeof(double)));
+        return;
+    }
+    for (size_t i = 0; i < num_values; i++) {
+        AppendDouble(segments.Data()[i], buffer_);
+        if (buffer_.size() >= 1 << 16) Flush(output_, buffer_);
+    }
+    Flush(output_, buffer_);
+}
+
+void SplineFileWriter::Finish() {
+    if (segments_written_ != num_segments_)
+        throw std::runtime_error("fewer segments than the file has room for");
+    std::streampos end = output_.tellp();
+    output_.seekp(num_samples_position);
+    AppendLittleEndian(samples_written_, 8, buffer_);
+    Flush(output_, buffer_);
+    output_.seekp(end);
+    output_.flush();
+}
+
+void WriteSplinesBinary(std::ostream& output,
+                        const SampleArena& allSplineSegments,
+                        const SplineFileInfo& info) {
+    SplineFileWriter writer(output, info, allSplineSegments.NumSegments());
+    writer.Append(allSplineSegments);
+    writer.Finish();
+}
+
+SplineFile::SplineFile(const std::string& filename) {
+    if (!IsLittleEndian())
+        throw std::runtime_error("binary spline files need a little-endian "
+                                 "host");
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + filename);
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + filename);
+    }
+    size_ = static_cast<size_t>(status.st_size);
+    if (size_ < sizeof(SplineFileHeader)) {
+        close(fd);
+        throw std::runtime_error(filename + " is too short for a header");
+    }
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        throw std::runtime_error("cannot map " + filename);
+    }
+
+    // the mapping is page aligned, so every section is suitably aligned
+    const char* bytes = static_cast<const char*>(data_);
+    header_ = reinterpret_cast<const SplineFileHeader*>(bytes);
+    offsets_ = reinterpret_cast<const uint64_t*>(bytes +
+                                                 sizeof(SplineFileHeader));
+
+    std::string error;
+    if (std::memcmp(header_->magic, spline_file_magic, 4) != 0)
+        error = " is not a binary spline file";
+    else if (header_->version != spline_file_version)
+        error = " has unsupported version " + std::to_string(header_->version);
+    else if (header_->spline_type >
+             static_cast<uint32_t>(SplineType::Interpolating))
+        error = " has an unknown spline type";
+
+    // sizes are checked against the file before they are multiplied out
+    const uint64_t available = size_ - sizeof(SplineFileHeader);
+    if (error.empty() && header_->num_segments >= available / 8)
+        error = " is truncated in its offsets";
+    uint64_t offsets_size = 8 * (header_->num_segments + 1);
+    if (error.empty() &&
+        ((available - offsets_size) % 16 != 0 ||
+         header_->num_samples != (available - offsets_size) / 16))
+        error = " does not hold num_samples samples";
+    for (uint64_t k = 0; error.empty() && k < header_->num_segments; k++)
+        if (offsets_[k + 1] < offsets_[k]) error = " has decreasing offsets";
+    if (error.empty() &&
+        (offsets_[0] != 0 ||
+         offsets_[header_->num_segments] != header_->num_samples))
+        error = " has offsets that do not span the samples";
+    if (!error.empty()) {
+        munmap(data_, size_);
+        data_ = nullptr;
+        throw std::runtime_error(filename + error);
+    }
+    samples_ = reinterpret_cast<const double*>(offsets_ +
+                                               header_->num_segments + 1);
+}
+
+SplineFile::~SplineFile() {
+    if (data_ != nullptr) munmap(data_, size_);
+}
+
+SplineFileInfo SplineFile::Info() const {
+    SplineFileInfo info;
+    info.spline_type = static_cast<SplineType>(header_->spline_type);
+    info.degree = header_->degree;
+    info.subdiv = header_->subdiv;
+    info.tolerance = header_->tolerance;
+    return info;
+}
+
+size_t SplineFile::NumSegments() const {
+    return static_cast<size_t>(header_->num_segments);
+}
+
+size_t SplineFile::NumSamples() const {
+    return static_cast<size_t>(header_->num_samples);
+}
+
+Eigen::Map<const SplineMatrix> SplineFile::Segment(size_t k) const {
+    uint64_t first = offsets_[k];
+    return Eigen::Map<const SplineMatrix>(
+        samples_ + 2 * first,
+        static_cast<Eigen::Index>(offsets_[k + 1] - first), 2);
+}
@@ -0,0 +1,104 @@
+#ifndef SPLINE_PLOTTER_BINARY_H_
+#define SPLINE_PLOTTER_BINARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "spline.h"
+
+// Binary spline file (.splb), all fields little-endian:
+//   SplineFileHeader                          48 bytes
+//   uint64 offsets[num_segments + 1]          first sample of every segment,
+//                                             the last entry is num_samples
+//   double samples[num_samples][2]            x, y of every sample in order
+// Every section starts on an 8 byte boundary, so once mapped the samples of
+// segment k are read in place as rows offsets[k] to offsets[k + 1]
+const char spline_file_magic[4] = {'S', 'P', 'L', 'B'};
+const uint32_t spline_file_version = 1;
+
+struct SplineFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t spline_type;  // SplineType enumerator
+    uint32_t degree;
+    uint32_t subdiv;  // 0 when sampled at equal arc length
+    uint32_t reserved;
+    double tolerance;  // 0 unless sampled adaptively
+    uint64_t num_segments;
+    uint64_t num_samples;
+};
+static_assert(sizeof(SplineFileHeader) == 48, "unexpected header padding");
+
+struct SplineFileInfo {
+    SplineType spline_type = SplineType::Hermite;
+    unsigned int degree = 3;
+    unsigned int subdiv = 0;
+    double tolerance = 0.0;
+};
+
+void WriteSplinesBinary(std::ostream& output,
+                        const SampleArena& allSplineSegments,
+                        const SplineFileInfo& info);
+
+// Writes a binary spline file a few segments at a time. The number of
+// segments is fixed up front so the offsets can be reserved; each Append
+// writes its samples at the end and fills in their offsets, so the output
+// must be seekable. Finish writes the sample count into the header
+class SplineFileWriter {
+   public:
+    SplineFileWriter(std::ostream& output, const SplineFileInfo& info,
+                     uint64_t num_segments);
+
+    // appends every segment of segments
+    void Append(const SampleArena& segments);
+    // throws std::runtime_error unless num_segments segments were appended
+    void Finish();
+
+   private:
+    std::ostream& output_;
+    uint64_t num_segments_;
+    uint64_t segments_written_ = 0;
+    uint64_t samples_written_ = 0;
+    std::vector<char> buffer_;
+};
+
+// Binary control point file, little-endian:
+//   char magic[4] = "SPLP", uint32 version
+//   double points[][2]                        x, y of every point until EOF
+// Version 1 files, written before control points were real-valued, hold
+// int32 points instead
+const char point_file_magic[4] = {'S', 'P', 'L', 'P'};
+const uint32_t point_file_int_version = 1;
+const uint32_t point_file_version = 2;
+const size_t point_file_header_size = 8;
+
+// Read-only mapping of a binary spline file. The constructor checks the
+// header, the file size and the offsets, and throws std::runtime_error if
+// they are inconsistent. Mapping requires a little-endian host
+class SplineFile {
+   public:
+    explicit SplineFile(const std::string& filename);
+    ~SplineFile();
+    SplineFile(const SplineFile&) = delete;
+    SplineFile& operator=(const SplineFile&) = delete;
+
+    const SplineFileHeader& Header() const { return *header_; }
+    SplineFileInfo Info() const;
+    size_t NumSegments() const;
+    size_t NumSamples() const;
+    // samples of segment k, viewed in place
+    Eigen::Map<const SplineMatrix> Segment(size_t k) const;
+
+   private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    const SplineFileHeader* header_ = nullptr;
+    const uint64_t* offsets_ = nullptr;
+    const double* samples_ = nullptr;
+};
+
+#endif  // SPLINE_PLOTTER_BINARY_H_
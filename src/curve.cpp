@@ -0,0 +1,160 @@
+#include "curve.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "nurbs.h"
+
+static const unsigned int max_newton_iterations = 8;
+
+SegmentCurve::SegmentCurve(const PairVector& control_points,
+                           const double* weights, const double* knots,
+                           SplineType spline_type_,
+                           unsigned int spline_degree_)
+    : type_(spline_type_),
+      degree_(spline_degree_),
+      t_start_(ParamStart(spline_type_)) {
+    if (type_ != SplineType::NURBS) {
+        coefficients_ = ComputeCoefficients(control_points, type_);
+        return;
+    }
+    for (unsigned int j = 0; j <= degree_; j++) {
+        double w = weights == nullptr ? 1.0 : weights[j];
+        homogeneous_.emplace_back(w * control_points[j].first,
+                                  w * control_points[j].second, w);
+    }
+    knots_ = knots == nullptr
+                 ? UniformKnots(degree_, degree_ + 1)
+                 : std::vector<double>(knots, knots + 2 * degree_ + 2);
+}
+
+SegmentCurve::SegmentCurve(const CoefficientMatrix& coefficients)
+    : type_(SplineType::Interpolating),
+      degree_(3),
+      t_start_(0.0),
+      coefficients_(coefficients) {}
+
+void SegmentCurve::Derivatives(double t, unsigned int order,
+                               Eigen::Vector2d* derivatives) const {
+    if (order > 2)
+        throw std::invalid_argument("Choose from derivatives = {0, 1, 2}");
+
+    if (type_ != SplineType::NURBS) {
+        // Horner on p(t) = at^3 + bt^2 + ct + d and its derivatives
+        Eigen::Vector2d a = coefficients_.row(0).transpose();
+        Eigen::Vector2d b = coefficients_.row(1).transpose();
+        Eigen::Vector2d c = coefficients_.row(2).transpose();
+        Eigen::Vector2d d = coefficients_.row(3).transpose();
+        derivatives[0] = ((a * t + b) * t + c) * t + d;
+        if (order >= 1) derivatives[1] = (3.0 * a * t + 2.0 * b) * t + c;
+        if (order >= 2) derivatives[2] = 6.0 * a * t + 2.0 * b;
+        return;
+    }
+
+    // each derivative with respect to t is the span width times that in u
+    const double width = knots_[degree_ + 1] - knots_[degree_];
+    double basis[3 * (max_nurbs_degree + 1)];
+    BasisFunctionDerivatives(knots_, degree_, degree_,
+                             knots_[degree_] + t * width, order, basis);
+    Eigen::Vector3d homogeneous[3];
+    double scale = 1.0;
+    for (unsigned int k = 0; k <= order; k++) {
+        homogeneous[k].setZero();
+        for (unsigned int j = 0; j <= degree_; j++)
+            homogeneous[k] +=
+                scale * basis[k * (degree_ + 1) + j] * homogeneous_[j];
+        scale *= width;
+    }
+
+    // quotient rule on Q = A / w
+    double w = homogeneous[0](2);
+    derivatives[0] = homogeneous[0].head<2>() / w;
+    if (order >= 1)
+        derivatives[1] =
+            (homogeneous[1].head<2>() - homogeneous[1](2) * derivatives[0]) /
+            w;
+    if (order >= 2)
+        derivatives[2] = (homogeneous[2].head<2>() -
+                          2.0 * homogeneous[1](2) * derivatives[1] -
+                          homogeneous[2](2) * derivatives[0]) /
+                         w;
+}
+
+Eigen::Vector2d SegmentCurve::Point(double t) const {
+    Eigen::Vector2d point;
+    Derivatives(t, 0, &point);
+    return point;
+}
+
+double SegmentCurve::Speed(double t) const {
+    Eigen::Vector2d derivatives[2];
+    Derivatives(t, 1, derivatives);
+    return derivatives[1].norm();
+}
+
+double SegmentCurve::Curvature(double t) const {
+    // k = (x'y'' - y'x'') / |Q'|^3
+    Eigen::Vector2d derivatives[3];
+    Derivatives(t, 2, derivatives);
+    double speed = derivatives[1].norm();
+    if (speed == 0.0) return 0.0;
+    double cross = derivatives[1](0) * derivatives[2](1) -
+                   derivatives[1](1) * derivatives[2](0);
+    return cross / (speed * speed * speed);
+}
+
+// Newton's method on f(t) = Q'.(Q - point) = 0 from t, within [low, high],
+// with f'(t) = Q''.(Q - point) + |Q'|^2
+static double RefineClosest(const SegmentCurve& curve,
+                            const Eigen::Vector2d& point, double t, double low,
+                            double high) {
+    for (unsigned int iteration = 0; iteration < max_newton_iterations;
+         iteration++) {
+        Eigen::Vector2d derivatives[3];
+        curve.Derivatives(t, 2, derivatives);
+        Eigen::Vector2d offset = derivatives[0] - point;
+        double slope =
+            derivatives[2].dot(offset) + derivatives[1].squaredNorm();
+        if (!(slope > 0.0)) break;
+        double next =
+            std::clamp(t - derivatives[1].dot(offset) / slope, low, high);
+        bool converged = std::abs(next - t) < 1e-12;
+        t = next;
+        if (converged) break;
+    }
+    return t;
+}
+
+double SegmentCurve::ClosestParam(const Eigen::Vector2d& point) const {
+    const double step = (1.0 - t_start_) / closest_point_samples;
+    auto param = [&](unsigned int i) {
+        return i == closest_point_samples ? 1.0 : t_start_ + step * i;
+    };
+    double distances[closest_point_samples + 1];
+    for (unsigned int i = 0; i <= closest_point_samples; i++)
+        distances[i] = (Point(param(i)) - point).squaredNorm();
+
+    // a segment can pass near point more than once, so every sample nearer
+    // than its neighbours is refined
+    double nearest = t_start_;
+    double nearest_distance = distances[0];
+    for (unsigned int i = 0; i <= closest_point_samples; i++) {
+        if ((i > 0 && distances[i] > distances[i - 1]) ||
+            (i < closest_point_samples && distances[i] > distances[i + 1]))
+            continue;
+        double t = RefineClosest(*this, point, param(i),
+                                 param(i > 0 ? i - 1 : 0),
+                                 param(std::min(i + 1, closest_point_samples)));
+        double distance = (Point(t) - point).squaredNorm();
+        if (distances[i] < distance) {
+            t = param(i);
+            distance = distances[i];
+        }
+        if (distance < nearest_distance) {
+            nearest = t;
+            nearest_distance = distance;
+        }
+    }
+    return nearest;
+}
@@ -0,0 +1,56 @@
+#ifndef SPLINE_PLOTTER_CURVE_H_
+#define SPLINE_PLOTTER_CURVE_H_
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "spline.h"
+
+// samples a segment is searched at before refining the nearest ones
+const unsigned int closest_point_samples = 32;
+
+// A single segment evaluated at any t in [Start(), 1] rather than at tabulated
+// samples, with its derivatives with respect to t and its curvature. Cubic
+// segments use their power basis coefficients, NURBS segments the derivatives
+// of their basis functions and the quotient rule
+class SegmentCurve {
+   public:
+    // weights holds the weights of the p + 1 control points, or is nullptr for
+    // unit weights, and knots the 2p + 2 knots of the segment, see
+    // SegmentKnots, or is nullptr for uniform knots. Both are only used by
+    // NURBS
+    SegmentCurve(const PairVector& control_points, const double* weights,
+                 const double* knots, SplineType spline_type_,
+                 unsigned int spline_degree_);
+    // Cubic over t in [0, 1] from its power basis coefficients, as the
+    // segments of Interpolating curves are given
+    explicit SegmentCurve(const CoefficientMatrix& coefficients);
+
+    double Start() const { return t_start_; }
+
+    // Writes the derivatives of orders 0 to order, at most 2, at t
+    void Derivatives(double t, unsigned int order,
+                     Eigen::Vector2d* derivatives) const;
+    Eigen::Vector2d Point(double t) const;
+    // |dQ/dt|
+    double Speed(double t) const;
+    // Signed curvature, positive where the curve turns counter-clockwise and
+    // 0 where its speed vanishes
+    double Curvature(double t) const;
+    // t of the point of the segment closest to point. Of closest_point_samples
+    // equally spaced samples, each nearer than its neighbours is refined by
+    // Newton's method on Q'(t) . (Q(t) - point) = 0 between them
+    double ClosestParam(const Eigen::Vector2d& point) const;
+
+   private:
+    SplineType type_;
+    unsigned int degree_;
+    double t_start_;
+    CoefficientMatrix coefficients_;  // cubic types
+    // (wx, wy, w) of the NURBS control points and the knots of the segment,
+    // which spans [knots_[p], knots_[p + 1]]
+    std::vector<Eigen::Vector3d> homogeneous_;
+    std::vector<double> knots_;
+};
+
+#endif  // SPLINE_PLOTTER_CURVE_H_
@@ -0,0 +1,268 @@
+#include "export.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "scene.h"
+#include "trace.h"
+
+ExportFormat export_format = ExportFormat::CSV;
+
+// exports are chained so that each waits for the one before it
+static std::future<void> pending_export;
+
+SplineFileInfo CurrentSplineFileInfo() {
+    SplineFileInfo info;
+    info.spline_type = spline_type;
+    info.degree = spline_degree;
+    // equal arc length samples are not at fixed steps of t
+    info.subdiv = spline_spacing > 0.0 ? 0 : spline_subdiv;
+    info.tolerance = spline_tolerance;
+    return info;
+}
+
+bool ParseExportFormat(std::string name, ExportFormat& format) {
+    if (name == "csv") {
+        format = ExportFormat::CSV;
+    } else if (name == "binary") {
+        format = ExportFormat::Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void WriteSplines(std::ostream& output,
+                  const SampleArena& allSplineSegments) {
+    Eigen::IOFormat printFmt(Eigen::FullPrecision, 0, ", ", "\n", "", "");
+    for (unsigned int k = 0; k < allSplineSegments.NumSegments(); k++) {
+        output << allSplineSegments.Segment(k).format(printFmt) << std::endl;
+    }
+}
+
+void WriteSplines(std::ostream& output,
+                  const SampleArena& allSplineSegments,
+                  ExportFormat format) {
+    if (format == ExportFormat::CSV) {
+        WriteSplines(output, allSplineSegments);
+        return;
+    }
+    WriteSplinesBinary(output, allSplineSegments, CurrentSplineFileInfo());
+}
+
+void ExportData(const SampleArena& allSplineSegments,
+                bool printTimeStamp) {
+    static int count = 0;
+    auto now = std::chrono::system_clock::now();
+    auto UTC = std::chrono::duration_cast<std::chrono::seconds>(
+        now.time_since_epoch());
+
+    std::filesystem::create_directory("results");
+
+    std::string filename = fmt::format("results/splines_{}_{}",
+                                       SplineTypeName(spline_type), count);
+    if (printTimeStamp) filename += "_" + std::to_string(UTC.count());
+    filename += export_format == ExportFormat::Binary ? ".splb" : ".csv";
+    count++;
+
+    // the header settings are read now, the samples are copied for the
+    // writer so the scene can keep changing
+    ScopedTrace trace("export copy");
+    ExportFormat format = export_format;
+    SplineFileInfo info = CurrentSplineFileInfo();
+    SampleArena snapshot(allSplineSegments);
+
+    pending_export = std::async(
+        std::launch::async,
+        [filename, format, info, snapshot = std::move(snapshot),
+         previous = std::move(pending_export)]() mutable {
+            if (previous.valid()) previous.wait();
+            ScopedTrace write_trace("export write");
+            std::ofstream output(filename, std::ios::binary);
+            if (!output) {
+                std::cout << "cannot open " << filename << std::endl;
+                return;
+            }
+            if (format == ExportFormat::Binary) {
+                WriteSplinesBinary(output, snapshot, info);
+            } else {
+                WriteSplines(output, snapshot);
+            }
+            output.close();
+            std::cout << "Exported " << snapshot.NumSegments()
+                      << " spline segments to " << filename << std::endl;
+        });
+}
+
+void WriteIntersections(std::ostream& output,
+                        const std::vector<Intersection>& intersections) {
+    for (const Intersection& crossing : intersections)
+        output << fmt::format("{}, {:.17g}, {}, {:.17g}, {:.17g}, {:.17g}\n",
+                              crossing.first_segment + 1, crossing.first_t,
+                              crossing.second_segment + 1, crossing.second_t,
+                              crossing.point(0), crossing.point(1));
+}
+
+std::string ExportIntersections(
+    const std::vector<Intersection>& intersections) {
+    static int count = 0;
+    auto UTC = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    std::filesystem::create_directory("results");
+    std::string filename =
+        fmt::format("results/intersections_{}_{}_{}.csv",
+                    SplineTypeName(spline_type), count++, UTC.count());
+    std::ofstream output(filename);
+    if (!output) throw std::runtime_error("cannot open " + filename);
+    WriteIntersections(output, intersections);
+    return filename;
+}
+
+void WriteCurvature(std::ostream& output, const CurveArcLength& curve,
+                    double step) {
+    const double length = curve.Length();
+    const long long num_steps = step > 0.0 ? std::llround(length / step) : 0;
+    for (long long j = 0; j <= num_steps; j++) {
+        double s = j == num_steps ? length : static_cast<double>(j) * step;
+        Eigen::Vector2d point = curve.PointAtLength(s);
+        output << fmt::format("{:.17g}, {:.17g}, {:.17g}, {:.17g}\n", s,
+                              point(0), point(1), curve.CurvatureAtLength(s));
+    }
+}
+
+void WaitForExports() {
+    if (pending_export.valid()) pending_export.wait();
+}
+
+PointReader::PointReader(const std::string& filename)
+    : input_(filename, std::ios::binary) {
+    if (!input_) throw std::runtime_error("cannot open " + filename);
+
+    char magic[point_file_header_size] = {};
+    input_.read(magic, point_file_header_size);
+    binary_ = input_.gcount() == point_file_header_size &&
+              std::equal(magic, magic + 4, point_file_magic);
+    if (binary_) {
+        uint32_t version = 0;
+        for (unsigned int i = 0; i < 4; i++)
+            version |= static_cast<uint32_t>(
+                           static_cast<unsigned char>(magic[4 + i]))
+                       << (8 * i);
+        if (version != point_file_int_version && version != point_file_version)
+            throw std::runtime_error(filename + " has unsupported version " +
+                                     std::to_string(version));
+        version_ = version;
+    } else {
+        input_.clear();
+        input_.seekg(0);
+    }
+}
+
+// Reads a whole field as a number, false unless it is one and finite
+static bool ParseFinite(const std::string& field, double& value) {
+    size_t end = 0;
+    try {
+        value = std::stod(field, &end);
+    } catch (const std::logic_error&) {
+        return false;
+    }
+    return end == field.size() && std::isfinite(value);
+}
+
+size_t PointReader::Read(PairVector& chunk, size_t max_points,
+                         std::vector<double>* weights_) {
+    size_t count = 0;
+    if (binary_) {
+        const std::streamsize point_size = PointSize();
+        const unsigned int field_size =
+            version_ == point_file_int_version ? 4 : 8;
+        unsigned char bytes[16];
+        while (count < max_points &&
+               input_.read(reinterpret_cast<char*>(bytes), point_size)) {
+            uint64_t fields[2] = {0, 0};
+            for (unsigned int i = 0; i < 2 * field_size; i++)
+                fields[i / field_size] |= static_cast<uint64_t>(bytes[i])
+                                          << (8 * (i % field_size));
+            ControlPoint point;
+            if (version_ == point_file_int_version) {
+                point = ControlPoint(
+                    static_cast<int32_t>(static_cast<uint32_t>(fields[0])),
+                    static_cast<int32_t>(static_cast<uint32_t>(fields[1])));
+            } else {
+                std::memcpy(&point.first, &fields[0], sizeof(double));
+                std::memcpy(&point.second, &fields[1], sizeof(double));
+                if (!std::isfinite(point.first) || !std::isfinite(point.second))
+                    throw std::runtime_error(
+                        fmt::format("invalid control point: {}, {}",
+                                    point.first, point.second));
+            }
+            chunk.push_back(point);
+            if (weights_ != nullptr) weights_->push_back(1.0);
+            count++;
+        }
+        if (input_.gcount() != 0 && input_.gcount() != point_size)
+            throw std::runtime_error("truncated binary control point");
+        return count;
+    }
+
+    while (count < max_points && std::getline(input_, line_)) {
+        line_number_++;
+        if (line_.empty() || line_[0] == '#') continue;
+        std::string text = line_;
+        std::replace(text.begin(), text.end(), ',', ' ');
+        std::istringstream fields(text);
+        // x, y and an optional weight, each a whole field
+        double values[3] = {0.0, 0.0, 1.0};
+        unsigned int num_fields = 0;
+        std::string field;
+        bool valid = true;
+        while (valid && fields >> field)
+            valid = num_fields < 3 && ParseFinite(field, values[num_fields++]);
+        if (!valid || num_fields < 2)
+            throw std::runtime_error(fmt::format(
+                "invalid control point on line {}: {}", line_number_, line_));
+        if (!(values[2] > 0.0))
+            throw std::runtime_error(fmt::format(
+                "invalid weight on line {}: {}", line_number_, line_));
+        chunk.push_back(std::make_pair(values[0], values[1]));
+        if (weights_ != nullptr) weights_->push_back(values[2]);
+        count++;
+    }
+    return count;
+}
+
+unsigned long long PointReader::CountRemaining() {
+    std::streampos position = input_.tellg();
+    unsigned long long count = 0;
+    if (binary_) {
+        input_.seekg(0, std::ios::end);
+        count = static_cast<unsigned long long>(input_.tellg() - position) /
+                static_cast<unsigned long long>(PointSize());
+    } else {
+        while (std::getline(input_, line_))
+            if (!line_.empty() && line_[0] != '#') count++;
+    }
+    input_.clear();
+    input_.seekg(position);
+    return count;
+}
+
+PairVector ImportPoints(std::string filename,
+                        std::vector<double>* weights_) {
+    PointReader reader(filename);
+    PairVector coordinates;
+    reader.Read(coordinates, std::numeric_limits<size_t>::max(),
+                weights_);
+    return coordinates;
+}
@@ -0,0 +1,88 @@
+#ifndef SPLINE_PLOTTER_EXPORT_H_
+#define SPLINE_PLOTTER_EXPORT_H_
+
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "arclength.h"
+#include "arena.h"
+#include "binary.h"
+#include "intersect.h"
+#include "spline.h"
+
+enum class ExportFormat { CSV, Binary };
+
+// format of exported spline files, binary files are described in binary.h
+extern ExportFormat export_format;
+
+bool ParseExportFormat(std::string name, ExportFormat& format);
+
+// Binary file header settings of the current spline type and sampling
+SplineFileInfo CurrentSplineFileInfo();
+
+void WriteSplines(std::ostream& output,
+                  const SampleArena& allSplineSegments);
+// Binary files record the current spline type, degree, subdivision and
+// tolerance in their header
+void WriteSplines(std::ostream& output,
+                  const SampleArena& allSplineSegments,
+                  ExportFormat format);
+
+// Copies the segments and writes them to the results directory on a
+// background thread, so the caller does not wait for the file. Exports are
+// written one after another in the order they were requested
+void ExportData(const SampleArena& allSplineSegments,
+                bool printTimeStamp = true);
+// Blocks until every requested export has been written
+void WaitForExports();
+
+// Writes "first segment, first t, second segment, second t, x, y" lines,
+// segments numbered from 1 as they are on the console
+void WriteIntersections(std::ostream& output,
+                        const std::vector<Intersection>& intersections);
+// Writes intersections to the results directory, returns the file name
+std::string ExportIntersections(const std::vector<Intersection>& intersections);
+
+// Writes "s, x, y, curvature" lines at every multiple of step along curve, the
+// last at its end, see CurveArcLength::Step
+void WriteCurvature(std::ostream& output, const CurveArcLength& curve,
+                    double step);
+
+// Reads control points a chunk at a time from a CSV file of "x, y" lines, or
+// from a binary point file (see binary.h), recognised by its magic. CSV lines
+// may add a positive NURBS weight, "x, y, w", and every field must be a
+// finite number with nothing after it. Throws std::runtime_error if the file
+// cannot be opened or a point is invalid, naming the line of CSV files
+class PointReader {
+   public:
+    explicit PointReader(const std::string& filename);
+
+    // Appends up to max_points points to chunk, returns how many were read,
+    // 0 once the file is exhausted. Unless weights_ is nullptr the weight of
+    // every point, 1 if it has none, is appended to it
+    size_t Read(PairVector& chunk, size_t max_points,
+                std::vector<double>* weights_ = nullptr);
+    // Number of points left, counted without parsing them
+    unsigned long long CountRemaining();
+
+   private:
+    // bytes of a binary point
+    std::streamsize PointSize() const {
+        return version_ == point_file_int_version ? 8 : 16;
+    }
+
+    std::ifstream input_;
+    bool binary_ = false;
+    uint32_t version_ = 0;  // of a binary file
+    std::string line_;
+    unsigned long long line_number_ = 0;  // of line_ in a CSV file
+};
+
+// Reads every control point of a file at once, and their weights unless
+// weights_ is nullptr
+PairVector ImportPoints(std::string filename,
+                        std::vector<double>* weights_ = nullptr);
+
+#endif  // SPLINE_PLOTTER_EXPORT_H_
@@ -0,0 +1,291 @@
+#include "fit.h"
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+#include "basis.h"
+
+double fit_tolerance = 0.0;
+
+// rounds of splitting before the fit settles for what it has
+static const unsigned int max_fit_rounds = 64;
+// longest span may be next to one this many times shorter
+static const double fit_span_ratio = 2.0;
+// samples per span fitted while splitting, every sample is fitted once no
+// more spans need splitting at that density
+static const size_t fit_span_samples = 64;
+
+// Symmetric positive definite matrix with 3 diagonals either side, row i
+// holding entries (i, i - d) for d = 0, ..., 3
+typedef std::vector<std::array<double, 4>> BandMatrix;
+
+// Factors band into L L^T in place, L taking the same layout
+static void CholeskyBand(BandMatrix& band) {
+    const size_t n = band.size();
+    for (size_t i = 0; i < n; i++) {
+        for (size_t d = std::min<size_t>(i, 3); d > 0; d--) {
+            const size_t j = i - d;
+            double sum = band[i][d];
+            // L(i, k) L(j, k) over the columns both rows reach
+            for (size_t k = i - std::min<size_t>(i, 3); k < j; k++)
+                sum -= band[i][i - k] * band[j][j - k];
+            band[i][d] = sum / band[j][0];
+        }
+        double pivot = band[i][0];
+        for (size_t d = 1; d <= std::min<size_t>(i, 3); d++)
+            pivot -= band[i][d] * band[i][d];
+        if (!(pivot > 0.0))
+            throw std::invalid_argument("fit normal equations are singular");
+        band[i][0] = std::sqrt(pivot);
+    }
+}
+
+// Solves L L^T x = values in place for the factor of CholeskyBand
+static void SolveBand(const BandMatrix& factor,
+                      std::vector<Eigen::Vector2d>& values) {
+    const size_t n = values.size();
+    for (size_t i = 0; i < n; i++) {
+        for (size_t d = 1; d <= std::min<size_t>(i, 3); d++)
+            values[i] -= factor[i][d] * values[i - d];
+        values[i] /= factor[i][0];
+    }
+    for (size_t i = n; i-- > 0;) {
+        for (size_t d = 1; d <= 3 && i + d < n; d++)
+            values[i] -= factor[i + d][d] * values[i + d];
+        values[i] /= factor[i][0];
+    }
+}
+
+// Weights of control points j, ..., j + 3 of span j at t, or of their
+// derivative, the columns of T(t)M
+static void SpanWeights(double t, unsigned int derivative, double* weights) {
+    typedef Basis<SplineType::BSpline, 3> BSplineBasis;
+    double powers[4] = {t * t * t, t * t, t, 1.0};
+    if (derivative == 1) {
+        powers[0] = 3.0 * t * t, powers[1] = 2.0 * t, powers[2] = 1.0;
+        powers[3] = 0.0;
+    } else if (derivative == 2) {
+        powers[0] = 6.0 * t, powers[1] = 2.0, powers[2] = powers[3] = 0.0;
+    }
+    for (size_t k = 0; k < 4; k++)
+        weights[k] = powers[0] * BSplineBasis::matrix[0][k] +
+                     powers[1] * BSplineBasis::matrix[1][k] +
+                     powers[2] * BSplineBasis::matrix[2][k] +
+                     powers[3] * BSplineBasis::matrix[3][k];
+}
+
+// Point, or derivative, of span j of control at t
+static Eigen::Vector2d SpanPoint(const std::vector<Eigen::Vector2d>& control,
+                                 size_t j, double t, unsigned int derivative) {
+    double weights[4];
+    SpanWeights(t, derivative, weights);
+    return weights[0] * control[j] + weights[1] * control[j + 1] +
+           weights[2] * control[j + 2] + weights[3] * control[j + 3];
+}
+
+// Parameters t of samples at chord lengths along spans between knots. A
+// linear map from chord length to t would change speed wherever spans of
+// different lengths meet, which a uniform B-spline cannot follow, so t is the
+// cubic Hermite blend through t = j at every knot j whose slope there is the
+// inverse of the mean length of the spans either side
+class ChordParameters {
+   public:
+    explicit ChordParameters(const std::vector<double>& knots)
+        : knots_(knots), slopes_(knots.size()) {
+        const size_t num_spans = knots.size() - 1;
+        for (size_t j = 0; j <= num_spans; j++) {
+            // the ends only have one span
+            double before = knots[j > 0 ? j : 1] - knots[j > 0 ? j - 1 : 0];
+            double after = j < num_spans ? knots[j + 1] - knots[j] : before;
+            slopes_[j] = 2.0 / (before + after);
+        }
+    }
+
+    size_t NumSpans() const { return knots_.size() - 1; }
+    // Span of the chord length, for chord lengths visited in order
+    size_t Span(double chord, size_t j) const {
+        while (j + 2 < knots_.size() && chord >= knots_[j + 1]) j++;
+        return j;
+    }
+    double Param(double chord, size_t j) const {
+        const double length = knots_[j + 1] - knots_[j];
+        const double x = std::clamp((chord - knots_[j]) / length, 0.0, 1.0);
+        const double start = slopes_[j] * length;
+        const double end = slopes_[j + 1] * length;
+        // both slopes stay under 2, so t rises monotonically
+        return ((start + end - 2.0) * x + 3.0 - 2.0 * start - end) * x * x +
+               start * x;
+    }
+
+   private:
+    const std::vector<double>& knots_;
+    std::vector<double> slopes_;  // dt/ds at every knot
+};
+
+PairVector FitBSpline(const PairVector& samples, double tolerance,
+                      FitReport* report) {
+    const size_t num_samples = samples.size();
+    if (num_samples < 2)
+        throw std::invalid_argument("fitting needs at least 2 samples");
+
+    // chord length of every sample from the first
+    std::vector<double> chords(num_samples, 0.0);
+    for (size_t i = 1; i < num_samples; i++)
+        chords[i] = chords[i - 1] +
+                    std::hypot(samples[i].first - samples[i - 1].first,
+                               samples[i].second - samples[i - 1].second);
+    if (!(chords.back() > 0.0))
+        throw std::invalid_argument("fitting samples must not all coincide");
+
+    // knots[j] is the chord length span j starts at
+    std::vector<double> knots = {0.0, chords.back()};
+    std::vector<Eigen::Vector2d> control;
+    std::vector<double> errors;
+    std::vector<unsigned int> counts;
+    FitReport result;
+    bool every_sample = false;
+    while (true) {
+        const ChordParameters params(knots);
+        const size_t num_spans = params.NumSpans();
+        const size_t n = num_spans + 3;
+        const size_t stride =
+            every_sample ? 1
+                         : std::max<size_t>(
+                               1, num_samples / (num_spans * fit_span_samples));
+        result.num_rounds++;
+
+        // normal equations, one span and 4 control points per sample
+        BandMatrix band(n, std::array<double, 4>{0.0, 0.0, 0.0, 0.0});
+        control.assign(n, Eigen::Vector2d::Zero());
+        for (size_t i = 0, j = 0; i < num_samples; i += stride) {
+            j = params.Span(chords[i], j);
+            double weights[4];
+            SpanWeights(params.Param(chords[i], j), 0, weights);
+            Eigen::Vector2d sample(samples[i].first, samples[i].second);
+            for (size_t a = 0; a < 4; a++) {
+                for (size_t b = 0; b <= a; b++)
+                    band[j + a][a - b] += weights[a] * weights[b];
+                control[j + a] += weights[a] * sample;
+            }
+        }
+        // second differences c_i - 2 c_(i+1) + c_(i+2), scaled to the
+        // samples per span so the penalty stays as small next to them
+        const double smoothing = fit_smoothing *
+                                 static_cast<double>(num_samples / stride) /
+                                 static_cast<double>(num_spans);
+        const double difference[3] = {1.0, -2.0, 1.0};
+        for (size_t i = 0; i + 2 < n; i++)
+            for (size_t a = 0; a < 3; a++)
+                for (size_t b = 0; b <= a; b++)
+                    band[i + a][a - b] +=
+                        smoothing * difference[a] * difference[b];
+
+        CholeskyBand(band);
+        SolveBand(band, control);
+
+        // the error is the distance to the curve a Newton step from the
+        // sample's parameter towards the closest point of its span finds,
+        // as samples are fitted by parameter but only their distance shows
+        errors.assign(num_spans, 0.0);
+        counts.assign(num_spans, 0);
+        for (size_t i = 0, j = 0; i < num_samples; i += stride) {
+            j = params.Span(chords[i], j);
+            const double t = params.Param(chords[i], j);
+            Eigen::Vector2d sample(samples[i].first, samples[i].second);
+            Eigen::Vector2d offset = SpanPoint(control, j, t, 0) - sample;
+            Eigen::Vector2d tangent = SpanPoint(control, j, t, 1);
+            double curvature = tangent.squaredNorm() +
+                               offset.dot(SpanPoint(control, j, t, 2));
+            double error = offset.norm();
+            if (curvature > 0.0) {
+                double closest = std::clamp(
+                    t - offset.dot(tangent) / curvature, 0.0, 1.0);
+                error = std::min(
+                    error, (SpanPoint(control, j, closest, 0) - sample).norm());
+            }
+            errors[j] = std::max(errors[j], error);
+            counts[j] += static_cast<unsigned int>(stride);
+        }
+        result.num_spans = static_cast<unsigned int>(num_spans);
+        result.max_error = *std::max_element(errors.begin(), errors.end());
+
+        // spans that miss the samples and still have some to fit are cut
+        // into as many as their error asks for, which falls with the fourth
+        // power of their length, and then graded so no span is more than
+        // fit_span_ratio times as long as a neighbour
+        std::vector<double> lengths(num_spans);
+        for (size_t s = 0; s < num_spans; s++) {
+            lengths[s] = knots[s + 1] - knots[s];
+            if (errors[s] > tolerance && counts[s] >= min_fit_span_samples) {
+                size_t wanted = static_cast<size_t>(
+                    std::ceil(std::sqrt(std::sqrt(errors[s] / tolerance))));
+                lengths[s] /= static_cast<double>(std::min(
+                    std::max<size_t>(2, wanted),
+                    std::max<size_t>(2, counts[s] / min_fit_span_samples)));
+            }
+        }
+        for (size_t s = 1; s < num_spans; s++)
+            lengths[s] = std::min(lengths[s], fit_span_ratio * lengths[s - 1]);
+        for (size_t s = num_spans - 1; s-- > 0;)
+            lengths[s] = std::min(lengths[s], fit_span_ratio * lengths[s + 1]);
+        std::vector<double> split = {knots[0]};
+        for (size_t s = 0; s < num_spans; s++) {
+            const double length = knots[s + 1] - knots[s];
+            const size_t pieces = static_cast<size_t>(
+                std::ceil(length / lengths[s] * (1.0 - 1e-9)));
+            for (size_t p = 1; p < pieces; p++)
+                split.push_back(knots[s] + length * static_cast<double>(p) /
+                                               static_cast<double>(pieces));
+            split.push_back(knots[s + 1]);
+        }
+        const bool settled = split.size() == knots.size();
+        if ((settled && stride == 1) || result.num_rounds == max_fit_rounds)
+            break;
+        every_sample = settled;
+        if (!settled) knots.swap(split);
+    }
+
+    if (report) *report = result;
+    PairVector control_points;
+    control_points.reserve(control.size());
+    for (const Eigen::Vector2d& point : control)
+        control_points.emplace_back(point.x(), point.y());
+    return control_points;
+}
+
+PairVector BSplineToBezier(const PairVector& control_points) {
+    PairVector bezier;
+    if (control_points.size() < 4) return bezier;
+    auto combine = [&](size_t i, double a, double b, double c, double d) {
+        return ControlPoint((a * control_points[i].first +
+                             b * control_points[i + 1].first +
+                             c * control_points[i + 2].first +
+                             d * control_points[i + 3].first) / 6.0,
+                            (a * control_points[i].second +
+                             b * control_points[i + 1].second +
+                             c * control_points[i + 2].second +
+                             d * control_points[i + 3].second) / 6.0);
+    };
+    bezier.push_back(combine(0, 1.0, 4.0, 1.0, 0.0));
+    for (size_t k = 0; k + 4 <= control_points.size(); k++) {
+        bezier.push_back(combine(k, 0.0, 4.0, 2.0, 0.0));
+        bezier.push_back(combine(k, 0.0, 2.0, 4.0, 0.0));
+        bezier.push_back(combine(k, 0.0, 1.0, 4.0, 1.0));
+    }
+    return bezier;
+}
+
+PairVector FitControlPoints(const PairVector& samples, SplineType spline_type_,
+                            double tolerance, FitReport* report) {
+    if (spline_type_ != SplineType::BSpline &&
+        spline_type_ != SplineType::Bezier)
+        throw std::invalid_argument(
+            "only BSpline and Bezier curves are fitted");
+    PairVector control_points = FitBSpline(samples, tolerance, report);
+    if (spline_type_ == SplineType::Bezier)
+        return BSplineToBezier(control_points);
+    return control_points;
+}
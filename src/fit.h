@@ -0,0 +1,49 @@
+#ifndef SPLINE_PLOTTER_FIT_H_
+#define SPLINE_PLOTTER_FIT_H_
+
+#include "spline.h"
+
+// px fitted curves may stray from their samples, 0 inserts samples as they are
+extern double fit_tolerance;
+
+// spans holding fewer samples than this are not split any further, which
+// stops the fit at corners no cubic can follow
+const unsigned int min_fit_span_samples = 4;
+// weight of the second differences of the control points against the
+// samples, which only keeps spans without samples determined
+const double fit_smoothing = 1e-6;
+
+struct FitReport {
+    unsigned int num_spans = 0;
+    unsigned int num_rounds = 0;  // least squares solves
+    // px, largest distance of a sample from the point of its span found by a
+    // Newton step towards the closest, an upper bound on its distance from
+    // the curve
+    double max_error = 0.0;
+};
+
+// Control points of a uniform cubic B-spline (SplineType::BSpline) fitted by
+// least squares to a dense polyline of samples, span j of the fit being the
+// curve's segment j. Samples are parameterized by chord length between knots
+// placed in chord length. The normal equations have 3 diagonals either side,
+// so they are built in one pass over the samples and solved by banded
+// Cholesky in time linear in the spans. The fit starts from one span and
+// cuts every span with a sample further than tolerance from the curve until
+// none is, so knots gather where the path bends. Rounds fit every few
+// samples while spans are long and end with a pass over all of them, each
+// O(n). Spans with fewer than min_fit_span_samples are left as they are.
+// Throws std::invalid_argument for fewer than 2 samples, samples all in one
+// place or normal equations that are singular
+PairVector FitBSpline(const PairVector& samples, double tolerance,
+                      FitReport* report = nullptr);
+
+// Points of the cubic Bezier segments (SplineType::Bezier) tracing a uniform
+// cubic B-spline exactly, consecutive segments sharing their end points
+PairVector BSplineToBezier(const PairVector& control_points);
+
+// Fits BSpline or Bezier control points to samples, throws
+// std::invalid_argument for other spline types
+PairVector FitControlPoints(const PairVector& samples, SplineType spline_type_,
+                            double tolerance, FitReport* report = nullptr);
+
+#endif  // SPLINE_PLOTTER_FIT_H_
@@ -0,0 +1,223 @@
+#include "headless.h"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+#include "args.h"
+#include "export.h"
+#include "fit.h"
+#include "scene.h"
+#include "stream.h"
+#include "trace.h"
+
+// points evaluated at a time by RunImport, about 10 MB of samples at the
+// default subdivision
+static const unsigned int default_chunk_size = 4096;
+
+int RunHeadless(std::vector<std::string> args) {
+    std::string input_file = CheckArgString(args, "--input");
+    std::string output_file = CheckArgString(args, "--output");
+    if (input_file.empty() || output_file.empty()) {
+        std::cout << "--headless requires --input {file} and --output {file}"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string curvature_file = CheckArgString(args, "--curvature");
+    if (!curvature_file.empty() && spline_spacing == 0.0) {
+        std::cout << "--curvature needs --spacing {px}" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    PairVector input_points;
+    std::vector<double> input_weights;  // only read for NURBS
+    try {
+        input_points = ImportPoints(
+            input_file,
+            spline_type == SplineType::NURBS ? &input_weights : nullptr);
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // continuity is enforced point by point as if they had been clicked in,
+    // the segments are then evaluated together
+    RemoveAllPoints();
+    auto start = std::chrono::steady_clock::now();
+    if (fit_tolerance > 0.0) {
+        // the input holds samples of a curve rather than its control points
+        try {
+            InsertFittedPoints(input_points);
+        } catch (const std::invalid_argument& error) {
+            std::cout << error.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else {
+        InsertPoints(input_points, input_weights);
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format(
+                     "Evaluated {} segments in {:.1f} ms ({} kernel, {} "
+                     "threads)",
+                     num_splines, elapsed.count(),
+                     BatchKernelName(batch_kernel), num_threads)
+              << std::endl;
+
+    std::ofstream output(output_file, std::ios::binary);
+    if (!output) {
+        std::cout << "cannot open " << output_file << std::endl;
+        return EXIT_FAILURE;
+    }
+    {
+        ScopedTrace trace("export write");
+        WriteSplines(output, splines, export_format);
+    }
+    std::cout << "Wrote " << num_splines << " spline segments ("
+              << splines.NumSamples() << " samples) to " << output_file
+              << std::endl;
+
+    if (!curvature_file.empty()) {
+        std::ofstream curvature_output(curvature_file);
+        if (!curvature_output) {
+            std::cout << "cannot open " << curvature_file << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            WriteCurvature(curvature_output, curve_length,
+                           curve_length.Step(spline_spacing));
+        } catch (const std::invalid_argument& error) {
+            std::cout << error.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << fmt::format("Wrote the curvature of {:.1f} px of curve "
+                                 "to {}",
+                                 curve_length.Length(), curvature_file)
+                  << std::endl;
+    }
+
+    std::string intersections_file = CheckArgString(args, "--intersections");
+    if (intersections_file.empty()) return EXIT_SUCCESS;
+    std::vector<Intersection> intersections;
+    start = std::chrono::steady_clock::now();
+    try {
+        ScopedTrace trace("find intersections");
+        intersections = FindCurveIntersections();
+    } catch (const std::invalid_argument& error) {
+        std::cout << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::ofstream intersections_output(intersections_file);
+    if (!intersections_output) {
+        std::cout << "cannot open " << intersections_file << std::endl;
+        return EXIT_FAILURE;
+    }
+    WriteIntersections(intersections_output, intersections);
+    std::cout << fmt::format("Wrote {} intersections to {}, found in {:.1f} ms",
+                             intersections.size(), intersections_file,
+                             elapsed.count())
+              << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int RunImport(std::vector<std::string> args) {
+    std::string import_file = CheckArgString(args, "--import");
+    std::string output_file = CheckArgString(args, "--output");
+    if (output_file.empty()) {
+        std::cout << "--import requires --output {file}" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (spline_type == SplineType::Interpolating) {
+        // every segment depends on every point, so none is final until the
+        // whole file has been read
+        std::cout << "--import cannot stream Interpolating curves, use "
+                     "--headless"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (spline_knots == KnotVector::Clamped) {
+        // the last knots are only known once the whole file has been read
+        std::cout << "--import cannot stream clamped knots, use --headless"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (fit_tolerance > 0.0) {
+        // a fit changes with every sample read
+        std::cout << "--import cannot stream fitted curves, use --headless"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (spline_spacing > 0.0) {
+        // the step is set by the length of the whole curve
+        std::cout << "--import cannot stream --spacing, use --headless"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!CheckArgString(args, "--intersections").empty()) {
+        // any two segments of the file may cross
+        std::cout << "--import cannot find intersections, use --headless"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string chunk_arg = CheckArgString(args, "--chunk");
+    unsigned int chunk_size =
+        chunk_arg.empty() ? default_chunk_size
+                          : static_cast<unsigned int>(std::stoul(chunk_arg));
+    if (chunk_size == 0) {
+        std::cout << "--chunk must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        PointReader reader(import_file);
+        std::ofstream output(output_file, std::ios::binary);
+        if (!output) throw std::runtime_error("cannot open " + output_file);
+
+        // binary files reserve their offsets, so count the segments first
+        std::unique_ptr<SplineFileWriter> writer;
+        if (export_format == ExportFormat::Binary) {
+            unsigned long long num_points_ = reader.CountRemaining();
+            if (num_points_ > std::numeric_limits<unsigned int>::max())
+                throw std::runtime_error("too many control points");
+            writer = std::make_unique<SplineFileWriter>(
+                output, CurrentSplineFileInfo(),
+                NumSegments(spline_type, spline_degree,
+                            static_cast<unsigned int>(num_points_)));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        StreamStats stats = StreamSplines(
+            reader, chunk_size,
+            [&](const SampleArena& segments) {
+                if (writer) {
+                    writer->Append(segments);
+                } else {
+                    WriteSplines(output, segments);
+                }
+            });
+        if (writer) writer->Finish();
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << fmt::format(
+                         "Streamed {} points in chunks of {} in {:.1f} ms ({} "
+                         "kernel, {} threads)",
+                         stats.num_points, chunk_size, elapsed.count(),
+                         BatchKernelName(batch_kernel), num_threads)
+                  << std::endl;
+        std::cout << "Wrote " << stats.num_segments << " spline segments ("
+                  << stats.num_samples << " samples) to " << output_file
+                  << std::endl;
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
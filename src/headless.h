@@ -0,0 +1,16 @@
+#ifndef SPLINE_PLOTTER_HEADLESS_H_
+#define SPLINE_PLOTTER_HEADLESS_H_
+
+#include <string>
+#include <vector>
+
+// Evaluates the splines through the control points of --input and writes the
+// samples to --output without creating a window. Returns the exit status
+int RunHeadless(std::vector<std::string> args);
+
+// Streams the control points of --import to the samples in --output a chunk
+// of --chunk points at a time, so inputs larger than memory can be evaluated.
+// Returns the exit status
+int RunImport(std::vector<std::string> args);
+
+#endif  // SPLINE_PLOTTER_HEADLESS_H_
@@ -0,0 +1,305 @@
+#include "interpolate.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "basis.h"
+
+// rows solved either side of an edit of a periodic curve, past which its
+// effect has shrunk by (2 - sqrt(3))^32 < 1e-18
+static const unsigned int periodic_margin = 32;
+
+std::string EndConditionName(EndCondition ends) {
+    switch (ends) {
+        case EndCondition::Natural:
+            return "natural";
+        case EndCondition::Clamped:
+            return "clamped";
+        case EndCondition::Periodic:
+            return "periodic";
+        default:
+            return "unknown";
+    }
+}
+
+bool ParseEndCondition(std::string name, EndCondition& ends) {
+    for (EndCondition candidate : {EndCondition::Natural, EndCondition::Clamped,
+                                   EndCondition::Periodic}) {
+        if (name == EndConditionName(candidate)) {
+            ends = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Value>
+static void Thomas(const std::vector<double>& lower,
+                   const std::vector<double>& diagonal,
+                   const std::vector<double>& upper,
+                   std::vector<Value>& values) {
+    const size_t n = values.size();
+    std::vector<double> factors(n);
+    for (size_t i = 0; i < n; i++) {
+        double pivot = diagonal[i];
+        if (i > 0) {
+            pivot -= lower[i] * factors[i - 1];
+            values[i] -= lower[i] * values[i - 1];
+        }
+        factors[i] = i + 1 < n ? upper[i] / pivot : 0.0;
+        values[i] /= pivot;
+    }
+    for (size_t i = n; i-- > 1;) values[i - 1] -= factors[i - 1] * values[i];
+}
+
+void SolveTridiagonal(const std::vector<double>& lower,
+                      const std::vector<double>& diagonal,
+                      const std::vector<double>& upper,
+                      std::vector<Eigen::Vector2d>& values) {
+    Thomas(lower, diagonal, upper, values);
+}
+
+void SolveCyclicTridiagonal(const std::vector<double>& lower,
+                            const std::vector<double>& diagonal,
+                            const std::vector<double>& upper,
+                            std::vector<Eigen::Vector2d>& values) {
+    const size_t n = values.size();
+    if (n < 3)
+        throw std::invalid_argument("cyclic systems need at least 3 unknowns");
+
+    // A = T + u v^T, where u = (gamma, 0, ..., 0, upper_(n-1)) and
+    // v = (1, 0, ..., 0, lower_0 / gamma) carry the corners and T is
+    // tridiagonal, so x = y - z (v.y) / (1 + v.z) with T y = b and T z = u
+    const double gamma = -diagonal[0];
+    const double corner = lower[0] / gamma;
+    std::vector<double> modified(diagonal);
+    modified[0] -= gamma;
+    modified[n - 1] -= upper[n - 1] * corner;
+    Thomas(lower, modified, upper, values);
+
+    std::vector<double> correction(n, 0.0);
+    correction[0] = gamma;
+    correction[n - 1] = upper[n - 1];
+    Thomas(lower, modified, upper, correction);
+
+    Eigen::Vector2d scale = (values[0] + corner * values[n - 1]) /
+                            (1.0 + correction[0] + corner * correction[n - 1]);
+    for (size_t i = 0; i < n; i++) values[i] -= correction[i] * scale;
+}
+
+HermiteMatrix InterpolatedGeometry(const PairVector& coordinates,
+                                   const std::vector<Eigen::Vector2d>& tangents,
+                                   unsigned int k) {
+    const size_t end = (k + 1) % coordinates.size();
+    HermiteMatrix geometry;
+    geometry << coordinates[k].first, coordinates[k].second,
+        coordinates[end].first, coordinates[end].second,
+        tangents[k].transpose(), tangents[end].transpose();
+    return geometry;
+}
+
+CoefficientMatrix InterpolatedCoefficients(
+    const PairVector& coordinates,
+    const std::vector<Eigen::Vector2d>& tangents, unsigned int k) {
+    return BasisMatrix<SplineType::Hermite, 3>() *
+           InterpolatedGeometry(coordinates, tangents, k);
+}
+
+BezierMatrix InterpolatedBezier(const PairVector& coordinates,
+                                const std::vector<Eigen::Vector2d>& tangents,
+                                unsigned int k) {
+    HermiteMatrix geometry = InterpolatedGeometry(coordinates, tangents, k);
+    BezierMatrix bezier;
+    bezier.row(0) = geometry.row(0);
+    bezier.row(1) = geometry.row(0) + geometry.row(2) / 3.0;
+    bezier.row(2) = geometry.row(1) - geometry.row(3) / 3.0;
+    bezier.row(3) = geometry.row(1);
+    return bezier;
+}
+
+CubicInterpolant::CubicInterpolant(EndCondition ends) : ends_(ends) {}
+
+unsigned int CubicInterpolant::NumSegments() const {
+    if (ends_ == EndCondition::Periodic)
+        return num_points_ >= 3 ? num_points_ : 0;
+    return num_points_ >= 2 ? num_points_ - 1 : 0;
+}
+
+void CubicInterpolant::Clear() {
+    num_points_ = 0;
+    tangents_.clear();
+    factors_.clear();
+    reduced_.clear();
+}
+
+void CubicInterpolant::Row(const PairVector& coordinates, unsigned int i,
+                           double* lower, double* diagonal, double* upper,
+                           Eigen::Vector2d* value) const {
+    const unsigned int n = num_points_;
+    auto chord = [&](unsigned int from, unsigned int to) {
+        return Eigen::Vector2d(coordinates[to].first - coordinates[from].first,
+                               coordinates[to].second -
+                                   coordinates[from].second);
+    };
+    *lower = 1.0, *diagonal = 4.0, *upper = 1.0;
+    if (ends_ == EndCondition::Periodic) {
+        *value = 3.0 * chord((i + n - 1) % n, (i + 1) % n);
+    } else if (i > 0 && i + 1 < n) {
+        *value = 3.0 * chord(i - 1, i + 1);
+    } else if (ends_ == EndCondition::Natural) {
+        // Q'' = 0: 2 M_0 + M_1 = 3 (P_1 - P_0), and mirrored at the end
+        *diagonal = 2.0;
+        *value = i == 0 ? 3.0 * chord(0, 1) : 3.0 * chord(n - 2, n - 1);
+    } else {
+        *diagonal = 1.0;
+        *value = i == 0 ? chord(0, 1) : chord(n - 2, n - 1);
+    }
+    if (ends_ != EndCondition::Periodic) {
+        if (i == 0) *lower = 0.0;
+        if (i + 1 == n) *upper = 0.0;
+        if (ends_ == EndCondition::Clamped && (i == 0 || i + 1 == n))
+            *lower = *upper = 0.0;
+    }
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> CubicInterpolant::Update(
+    const PairVector& coordinates, unsigned int first, unsigned int last) {
+    const unsigned int old_points = num_points_;
+    const unsigned int n = static_cast<unsigned int>(coordinates.size());
+    // appended or removed points count as changed
+    if (n != old_points) {
+        first = std::min({first, old_points, n});
+        last = n;
+    }
+    last = std::min(last, n);
+    first = std::min(first, last);
+    num_points_ = n;
+
+    std::vector<std::pair<unsigned int, unsigned int>> changed;
+    if (NumSegments() == 0) {
+        tangents_.assign(n, Eigen::Vector2d::Zero());
+        factors_.assign(n, 0.0);
+        reduced_.assign(n, Eigen::Vector2d::Zero());
+        return changed;
+    }
+    if (ends_ == EndCondition::Periodic)
+        return UpdatePeriodic(coordinates, first, last, old_points);
+    std::pair<unsigned int, unsigned int> segments =
+        UpdateOpen(coordinates, first, last, old_points);
+    if (segments.first < segments.second) changed.push_back(segments);
+    return changed;
+}
+
+std::pair<unsigned int, unsigned int> CubicInterpolant::UpdateOpen(
+    const PairVector& coordinates, unsigned int first, unsigned int last,
+    unsigned int old_points) {
+    const unsigned int n = num_points_;
+    tangents_.resize(n, Eigen::Vector2d::Zero());
+    factors_.resize(n, 0.0);
+    reduced_.resize(n, Eigen::Vector2d::Zero());
+
+    // rows [first - 1, last] hold the changed points, the forward sweep is
+    // redone from the first of them until it matches the previous one again
+    const unsigned int row = std::min(first > 0 ? first - 1 : 0, n - 1);
+    unsigned int end_row = n - 1;
+    for (unsigned int i = row; i < n; i++) {
+        double lower, diagonal, upper;
+        Eigen::Vector2d value;
+        Row(coordinates, i, &lower, &diagonal, &upper, &value);
+        double pivot = diagonal;
+        if (i > 0) {
+            pivot -= lower * factors_[i - 1];
+            value -= lower * reduced_[i - 1];
+        }
+        value /= pivot;
+        bool settled = n == old_points && i > last && i + 1 < n &&
+                       (value - reduced_[i]).cwiseAbs().maxCoeff() <
+                           interpolation_tolerance;
+        factors_[i] = upper / pivot;
+        reduced_[i] = value;
+        if (settled) {
+            end_row = i;
+            break;
+        }
+    }
+
+    // back substitution, until the tangents before the edit stop changing
+    unsigned int lowest = end_row;
+    for (unsigned int i = end_row + 1; i-- > 0;) {
+        Eigen::Vector2d tangent = reduced_[i];
+        if (i + 1 < n) tangent -= factors_[i] * tangents_[i + 1];
+        double change = (tangent - tangents_[i]).cwiseAbs().maxCoeff();
+        tangents_[i] = tangent;
+        lowest = i;
+        if (i < row && change < interpolation_tolerance) break;
+    }
+
+    // segment k joins points and tangents k and k + 1
+    unsigned int begin =
+        std::min(lowest > 0 ? lowest - 1 : 0, first > 0 ? first - 1 : 0);
+    unsigned int end = std::min(n - 1, std::max(end_row + 1, last));
+    return std::make_pair(begin, std::max(begin, end));
+}
+
+// Appends segment k to ranges, extending the last range if it ends at k
+static void AddSegment(
+    std::vector<std::pair<unsigned int, unsigned int>>& ranges,
+    unsigned int k) {
+    if (!ranges.empty() && ranges.back().second == k) {
+        ranges.back().second++;
+    } else {
+        ranges.emplace_back(k, k + 1);
+    }
+}
+
+std::vector<std::pair<unsigned int, unsigned int>>
+CubicInterpolant::UpdatePeriodic(const PairVector& coordinates,
+                                 unsigned int first, unsigned int last,
+                                 unsigned int old_points) {
+    const unsigned int n = num_points_;
+    // rows [first - 1, last] hold the changed points, wrapping around to row
+    // 0 when points were appended or removed, and are solved with
+    // periodic_margin rows either side. Short curves are solved whole
+    const unsigned int window = last - first + 2 + 2 * periodic_margin;
+    const bool whole = old_points < 3 || window >= n;
+    const unsigned int start =
+        whole ? 0 : (first + 2 * n - 1 - periodic_margin) % n;
+    const unsigned int size = whole ? n : window;
+
+    std::vector<double> lower(size), diagonal(size), upper(size);
+    std::vector<Eigen::Vector2d> values(size);
+    for (unsigned int j = 0; j < size; j++)
+        Row(coordinates, (start + j) % n, &lower[j], &diagonal[j], &upper[j],
+            &values[j]);
+    if (whole) {
+        SolveCyclicTridiagonal(lower, diagonal, upper, values);
+    } else {
+        // the tangents just outside the window have not changed
+        values[0] -= lower[0] * tangents_[(start + n - 1) % n];
+        values[size - 1] -= upper[size - 1] * tangents_[(start + size) % n];
+        SolveTridiagonal(lower, diagonal, upper, values);
+    }
+
+    tangents_.resize(n, Eigen::Vector2d::Zero());
+    std::vector<bool> moved(size);
+    for (unsigned int j = 0; j < size; j++) {
+        unsigned int i = (start + j) % n;
+        moved[j] = (i >= first && i < last) || i >= old_points ||
+                   (values[j] - tangents_[i]).cwiseAbs().maxCoeff() >=
+                       interpolation_tolerance;
+        tangents_[i] = values[j];
+    }
+
+    // segment k joins points and tangents k and k + 1, the window's rows
+    // lying between segments start - 1 and start + size - 1
+    std::vector<std::pair<unsigned int, unsigned int>> changed;
+    for (unsigned int j = whole ? 1 : 0; j <= size; j++) {
+        unsigned int k = (start + j + n - 1) % n;
+        bool before = j > 0 && moved[j - 1];
+        bool after = j < size ? moved[j] : whole && moved[0];
+        // the closing segment gains a new end whenever points are added
+        if (before || after || (k + 1 == n && n != old_points))
+            AddSegment(changed, k);
+    }
+    return changed;
+}
@@ -0,0 +1,102 @@
+#ifndef SPLINE_PLOTTER_INTERPOLATE_H_
+#define SPLINE_PLOTTER_INTERPOLATE_H_
+
+#include <Eigen/Core>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "adaptive.h"
+#include "spline.h"
+
+// px per unit of t. Updates stop propagating once tangents change by less
+// than this, which moves the curve by less than a sixth of it
+const double interpolation_tolerance = 1e-9;
+
+// Conditions closing the system at the ends of an Interpolating curve.
+// Natural ends have no curvature, clamped ends take the direction and length
+// of the end chords as tangents and periodic curves close back to the first
+// point, C2 there too
+enum class EndCondition { Natural, Clamped, Periodic };
+
+std::string EndConditionName(EndCondition ends);
+// Resolves an --ends name, returns false if it is not a known condition
+bool ParseEndCondition(std::string name, EndCondition& ends);
+
+// Solves lower_i x_(i-1) + diagonal_i x_i + upper_i x_(i+1) = values_i in
+// place with the Thomas algorithm, lower_0 and upper_(n-1) being unused
+void SolveTridiagonal(const std::vector<double>& lower,
+                      const std::vector<double>& diagonal,
+                      const std::vector<double>& upper,
+                      std::vector<Eigen::Vector2d>& values);
+// The same with lower_0 coupling x_(n-1) and upper_(n-1) coupling x_0, for
+// n >= 3, by the Sherman-Morrison formula over two tridiagonal solves
+void SolveCyclicTridiagonal(const std::vector<double>& lower,
+                            const std::vector<double>& diagonal,
+                            const std::vector<double>& upper,
+                            std::vector<Eigen::Vector2d>& values);
+
+// Hermite geometry of segment k of an Interpolating curve, its end points
+// followed by their tangents. The last segment of a periodic curve ends at the
+// first point
+typedef Eigen::Matrix<double, 4, 2> HermiteMatrix;
+HermiteMatrix InterpolatedGeometry(const PairVector& coordinates,
+                                   const std::vector<Eigen::Vector2d>& tangents,
+                                   unsigned int k);
+CoefficientMatrix InterpolatedCoefficients(
+    const PairVector& coordinates,
+    const std::vector<Eigen::Vector2d>& tangents, unsigned int k);
+BezierMatrix InterpolatedBezier(const PairVector& coordinates,
+                                const std::vector<Eigen::Vector2d>& tangents,
+                                unsigned int k);
+
+// Tangents of the C2 cubic through every point, over unit steps of t, which
+// satisfy M_(i-1) + 4 M_i + M_(i+1) = 3 (P_(i+1) - P_(i-1)) between the end
+// conditions. Open curves keep the Thomas algorithm's forward sweep, which
+// only depends on the rows before it, so an edit redoes the sweep from there
+// and back substitution stops once tangents change by less than
+// interpolation_tolerance: every step away from an edit shrinks its effect
+// by about 2 - sqrt(3), so appending or moving a point touches a few dozen
+// tangents whatever the length of the curve. Periodic curves have no sweep
+// to keep, so the rows around an edit are solved on their own with the
+// tangents either side of them held, which by the same decay changes nothing
+// once the window reaches far enough. Only a full solve is O(n)
+class CubicInterpolant {
+   public:
+    explicit CubicInterpolant(EndCondition ends = EndCondition::Natural);
+
+    EndCondition Ends() const { return ends_; }
+    unsigned int NumPoints() const { return num_points_; }
+    // n - 1, or n for periodic curves of at least 3 points
+    unsigned int NumSegments() const;
+    const std::vector<Eigen::Vector2d>& Tangents() const { return tangents_; }
+
+    // Brings the tangents up to date with coordinates after points
+    // [first, last) moved, and any after the previous last point were
+    // appended or removed. Returns the ranges of segments [begin, end) whose
+    // shape changed, including every new segment
+    std::vector<std::pair<unsigned int, unsigned int>> Update(
+        const PairVector& coordinates, unsigned int first, unsigned int last);
+    void Clear();
+
+   private:
+    // Coefficients of row i of the system over n points
+    void Row(const PairVector& coordinates, unsigned int i, double* lower,
+             double* diagonal, double* upper, Eigen::Vector2d* value) const;
+    std::pair<unsigned int, unsigned int> UpdateOpen(
+        const PairVector& coordinates, unsigned int first, unsigned int last,
+        unsigned int old_points);
+    std::vector<std::pair<unsigned int, unsigned int>> UpdatePeriodic(
+        const PairVector& coordinates, unsigned int first, unsigned int last,
+        unsigned int old_points);
+
+    EndCondition ends_;
+    unsigned int num_points_ = 0;
+    std::vector<Eigen::Vector2d> tangents_;
+    // forward sweep of open curves: row i reduced to
+    // M_i + factors_i M_(i+1) = reduced_i
+    std::vector<double> factors_;
+    std::vector<Eigen::Vector2d> reduced_;
+};
+
+#endif  // SPLINE_PLOTTER_INTERPOLATE_H_
@@ -0,0 +1,334 @@
+#include "intersect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "spatial.h"
+
+// deeper pieces are shorter than 2^-40 of the segment, and pieces that never
+// flatten, such as the ends of a cusp, stop there
+static const unsigned int max_intersection_depth = 40;
+// Newton steps stop once the curves are this fraction of tolerance apart, a
+// straight piece traced unevenly can take several
+static const unsigned int crossing_newton_steps = 8;
+static const double crossing_newton_gap = 1e-6;
+static const double half_turn = 3.14159265358979323846;
+
+// Part of a segment over [t0, t1] of its Bezier form
+struct BezierPiece {
+    BezierMatrix bezier;
+    double t0 = 0.0;
+    double t1 = 1.0;
+};
+
+// Crossings found so far between two segments, or within one
+struct PairSearch {
+    unsigned int first_segment;
+    unsigned int second_segment;
+    double tolerance;
+    unsigned int max_found;
+    const BezierMatrix* first_bezier;
+    const BezierMatrix* second_bezier;
+    // end points the pieces share, which are not crossings
+    std::vector<Eigen::Vector2d> joints;
+    // whether either segment starts where the one before it ends, so that
+    // crossings there are reported from that segment instead
+    bool first_joined;
+    bool second_joined;
+    std::vector<Intersection> found;
+};
+
+static ControlPoint BezierPoint(const BezierMatrix& bezier, Eigen::Index i) {
+    return ControlPoint(bezier(i, 0), bezier(i, 1));
+}
+
+static PairVector BezierPolygon(const BezierMatrix& bezier) {
+    PairVector polygon;
+    for (Eigen::Index i = 0; i < 4; i++)
+        polygon.push_back(BezierPoint(bezier, i));
+    return polygon;
+}
+
+static void SplitPiece(const BezierPiece& piece, BezierPiece& left,
+                       BezierPiece& right) {
+    SplitBezier(piece.bezier, left.bezier, right.bezier);
+    const double middle = 0.5 * (piece.t0 + piece.t1);
+    left.t0 = piece.t0, left.t1 = middle;
+    right.t0 = middle, right.t1 = piece.t1;
+}
+
+static Eigen::Vector2d BezierAt(const BezierMatrix& bezier, double t) {
+    const double u = 1.0 - t;
+    return (u * u * u * bezier.row(0) + 3.0 * u * u * t * bezier.row(1) +
+            3.0 * u * t * t * bezier.row(2) + t * t * t * bezier.row(3))
+        .transpose();
+}
+
+static Eigen::Vector2d BezierTangent(const BezierMatrix& bezier, double t) {
+    const double u = 1.0 - t;
+    return (3.0 * u * u * (bezier.row(1) - bezier.row(0)) +
+            6.0 * u * t * (bezier.row(2) - bezier.row(1)) +
+            3.0 * t * t * (bezier.row(3) - bezier.row(2)))
+        .transpose();
+}
+
+// Angle the control polygon turns through in all, skipping repeated points
+static double Turning(const BezierMatrix& bezier) {
+    double turning = 0.0;
+    Eigen::RowVector2d previous = Eigen::RowVector2d::Zero();
+    for (Eigen::Index i = 1; i < 4; i++) {
+        Eigen::RowVector2d edge = bezier.row(i) - bezier.row(i - 1);
+        if (edge.isZero(0.0)) continue;
+        if (!previous.isZero(0.0))
+            turning += std::abs(
+                std::atan2(previous(0) * edge(1) - previous(1) * edge(0),
+                           previous.dot(edge)));
+        previous = edge;
+    }
+    return turning;
+}
+
+bool HullsOverlap(const PairVector& first, const PairVector& second) {
+    // hulls are counter-clockwise, so their outside is right of every edge
+    auto separates = [](const PairVector& hull, const PairVector& other) {
+        for (size_t i = 0; i < hull.size(); i++) {
+            const ControlPoint& from = hull[i];
+            const ControlPoint& to = hull[(i + 1) % hull.size()];
+            if (from == to) continue;
+            if (std::all_of(other.begin(), other.end(),
+                            [&](const ControlPoint& point) {
+                                return CheckCCW(from, to, point) < 0.0;
+                            }))
+                return true;
+        }
+        return false;
+    };
+    return !separates(first, second) && !separates(second, first);
+}
+
+static void AddCrossing(PairSearch& search, double first_t, double second_t,
+                        const Eigen::Vector2d& point) {
+    // a crossing at the end of a piece is found from the pieces either side.
+    // Both curves stay near it between the two parameters, unlike a curve
+    // that leaves and comes back to cross at the same point again
+    const double radius = 2.0 * search.tolerance;
+    for (const Eigen::Vector2d& joint : search.joints)
+        if ((point - joint).norm() <= radius) return;
+    auto at_start = [&](const BezierMatrix& bezier, double t) {
+        return t <= 0.5 &&
+               (point - bezier.row(0).transpose()).norm() <= radius;
+    };
+    if ((search.first_joined && at_start(*search.first_bezier, first_t)) ||
+        (search.second_joined && at_start(*search.second_bezier, second_t)))
+        return;
+    auto stays_near = [&](const BezierMatrix& bezier, double t,
+                          double other_t) {
+        return (BezierAt(bezier, 0.5 * (t + other_t)) - point).norm() <=
+               radius;
+    };
+    for (const Intersection& other : search.found)
+        if ((point - other.point).norm() <= radius &&
+            stays_near(*search.first_bezier, first_t, other.first_t) &&
+            stays_near(*search.second_bezier, second_t, other.second_t))
+            return;
+    Intersection crossing;
+    crossing.first_segment = search.first_segment;
+    crossing.second_segment = search.second_segment;
+    crossing.first_t = first_t;
+    crossing.second_t = second_t;
+    crossing.point = point;
+    search.found.push_back(crossing);
+}
+
+// Crosses the chords of two pieces flat to within tolerance
+static void CrossChords(const BezierPiece& first, const BezierPiece& second,
+                        PairSearch& search) {
+    const ControlPoint p = BezierPoint(first.bezier, 0);
+    const ControlPoint q = BezierPoint(first.bezier, 3);
+    const ControlPoint r = BezierPoint(second.bezier, 0);
+    const ControlPoint s = BezierPoint(second.bezier, 3);
+    const Eigen::Vector2d from(r.first, r.second);
+    const Eigen::Vector2d chord(s.first - r.first, s.second - r.second);
+    const double length = chord.norm();
+    if (p == q || length == 0.0) return;
+    auto param = [](const BezierPiece& piece, double u) {
+        return piece.t0 + u * (piece.t1 - piece.t0);
+    };
+
+    // twice the areas of the triangles either chord makes with the ends of
+    // the other, of opposite signs where they cross
+    const double p_side = CheckCCW(r, s, p), q_side = CheckCCW(r, s, q);
+    const double r_side = CheckCCW(p, q, r), s_side = CheckCCW(p, q, s);
+    if (std::abs(p_side) <= search.tolerance * length &&
+        std::abs(q_side) <= search.tolerance * length) {
+        // collinear chords touch where they overlap, taken at its middle
+        const double scale = 1.0 / (length * length);
+        const double p_along =
+            chord.dot(Eigen::Vector2d(p.first, p.second) - from) * scale;
+        const double q_along =
+            chord.dot(Eigen::Vector2d(q.first, q.second) - from) * scale;
+        const double low = std::max(0.0, std::min(p_along, q_along));
+        const double high = std::min(1.0, std::max(p_along, q_along));
+        if (low > high) return;
+        const double along = 0.5 * (low + high);
+        const double first_along = (along - p_along) / (q_along - p_along);
+        AddCrossing(search, param(first, first_along), param(second, along),
+                    from + along * chord);
+        return;
+    }
+    if (p_side * q_side > 0.0 || r_side * s_side > 0.0) return;
+
+    // the chords cross within tolerance of the curves, but the parameters
+    // there can be further out where the pieces are not traced evenly, so
+    // Newton steps on first(u) = second(v) over the whole segments refine
+    // them. A crossing near the end of a piece can be just past it
+    const BezierMatrix& first_bezier = *search.first_bezier;
+    const BezierMatrix& second_bezier = *search.second_bezier;
+    double u = param(first, p_side / (p_side - q_side));
+    double v = param(second, r_side / (r_side - s_side));
+    auto within = [](const BezierPiece& piece, double t) {
+        const double width = piece.t1 - piece.t0;
+        return t >= std::max(0.0, piece.t0 - width) &&
+               t <= std::min(1.0, piece.t1 + width);
+    };
+    Eigen::Vector2d point = from + r_side / (r_side - s_side) * chord;
+    for (unsigned int i = 0; i < crossing_newton_steps; i++) {
+        const Eigen::Vector2d gap =
+            BezierAt(second_bezier, v) - BezierAt(first_bezier, u);
+        if (gap.norm() <= crossing_newton_gap * search.tolerance) break;
+        const Eigen::Vector2d du = BezierTangent(first_bezier, u);
+        const Eigen::Vector2d dv = BezierTangent(second_bezier, v);
+        const double det = dv(0) * du(1) - dv(1) * du(0);
+        if (det == 0.0) break;
+        const double next_u = u + (dv(0) * gap(1) - dv(1) * gap(0)) / det;
+        const double next_v = v + (du(0) * gap(1) - du(1) * gap(0)) / det;
+        // a step off the pieces means they barely cross, where the chords'
+        // parameters are as good as any
+        if (!within(first, next_u) || !within(second, next_v)) break;
+        u = next_u, v = next_v;
+    }
+    const Eigen::Vector2d first_point = BezierAt(first_bezier, u);
+    const Eigen::Vector2d second_point = BezierAt(second_bezier, v);
+    if ((first_point - second_point).norm() <= search.tolerance)
+        point = 0.5 * (first_point + second_point);
+    AddCrossing(search, u, v, point);
+}
+
+static void CrossPieces(const BezierPiece& first, const BezierPiece& second,
+                        unsigned int depth, PairSearch& search) {
+    if (search.found.size() >= search.max_found) return;
+    if (!BezierBounds(first.bezier).Intersects(BezierBounds(second.bezier)))
+        return;
+    const double first_height = ChordHeight(first.bezier);
+    const double second_height = ChordHeight(second.bezier);
+    if ((first_height <= search.tolerance &&
+         second_height <= search.tolerance) ||
+        depth >= max_intersection_depth) {
+        CrossChords(first, second, search);
+        return;
+    }
+    // the piece further from flat is split
+    BezierPiece left, right;
+    if (first_height >= second_height) {
+        SplitPiece(first, left, right);
+        CrossPieces(left, second, depth + 1, search);
+        CrossPieces(right, second, depth + 1, search);
+    } else {
+        SplitPiece(second, left, right);
+        CrossPieces(first, left, depth + 1, search);
+        CrossPieces(first, right, depth + 1, search);
+    }
+}
+
+static void CrossItself(const BezierPiece& piece, unsigned int depth,
+                        PairSearch& search) {
+    // a loop turns through more than half a turn, and the curve turns by at
+    // most as much as its control polygon
+    if (depth >= max_intersection_depth || Turning(piece.bezier) < half_turn)
+        return;
+    BezierPiece left, right;
+    SplitPiece(piece, left, right);
+    CrossItself(left, depth + 1, search);
+    CrossItself(right, depth + 1, search);
+    search.joints.push_back(left.bezier.row(3).transpose());
+    CrossPieces(left, right, depth + 1, search);
+    search.joints.pop_back();
+}
+
+std::vector<Intersection> FindIntersections(
+    const std::vector<BezierMatrix>& segments, double tolerance) {
+    const unsigned int num_segments_ =
+        static_cast<unsigned int>(segments.size());
+    SpatialGrid grid;
+    std::vector<PairVector> segment_hulls(num_segments_);
+    for (unsigned int k = 0; k < num_segments_; k++) {
+        grid.Insert(k, BezierBounds(segments[k]));
+        segment_hulls[k] = SortConvex(BezierPolygon(segments[k]));
+    }
+
+    // segments joined to the one before them, and the first to the last
+    // where the curve closes
+    auto joins = [&](unsigned int a, unsigned int b) {
+        return (segments[a].row(3) - segments[b].row(0)).norm() <= tolerance;
+    };
+    std::vector<bool> joined(num_segments_, false);
+    for (unsigned int k = 1; k < num_segments_; k++)
+        joined[k] = joins(k - 1, k);
+    const bool closed = num_segments_ > 1 && joins(num_segments_ - 1, 0);
+    if (closed) joined[0] = true;
+
+    std::vector<Intersection> intersections;
+    // reused for every pair, so pairs that never cross allocate nothing
+    PairSearch search{0,     0,     tolerance, 0, nullptr, nullptr,
+                      {},    false, false,     {}};
+    auto cross = [&](unsigned int a, unsigned int b) {
+        if (a != b && !HullsOverlap(segment_hulls[a], segment_hulls[b])) return;
+        search.first_segment = a;
+        search.second_segment = b;
+        // a cubic crosses itself at most once
+        search.max_found = a == b ? 1 : max_pair_intersections;
+        search.first_bezier = &segments[a];
+        search.second_bezier = &segments[b];
+        search.joints.clear();
+        search.first_joined = a != b && joined[a];
+        search.second_joined = a != b && joined[b];
+        search.found.clear();
+        BezierPiece first, second;
+        first.bezier = segments[a];
+        second.bezier = segments[b];
+        if (a == b) {
+            CrossItself(first, 0, search);
+        } else {
+            // only the ends where the curve runs from one segment into the
+            // next are joints, other segments ending there cross it
+            if (b == a + 1 && joined[b])
+                search.joints.push_back(first.bezier.row(3).transpose());
+            if (closed && a == 0 && b == num_segments_ - 1)
+                search.joints.push_back(first.bezier.row(0).transpose());
+            CrossPieces(first, second, 0, search);
+        }
+        intersections.insert(intersections.end(), search.found.begin(),
+                             search.found.end());
+    };
+
+    // each pair is crossed from its earlier segment
+    std::vector<unsigned int> nearby;
+    for (unsigned int k = 0; k < num_segments_; k++) {
+        nearby.clear();
+        grid.Query(grid.Bounds(k), nearby);
+        std::sort(nearby.begin(), nearby.end());
+        for (unsigned int j : nearby)
+            if (j > k) cross(k, j);
+        cross(k, k);
+    }
+
+    std::sort(intersections.begin(), intersections.end(),
+              [](const Intersection& a, const Intersection& b) {
+                  return std::tie(a.first_segment, a.second_segment,
+                                  a.first_t) < std::tie(b.first_segment,
+                                                        b.second_segment,
+                                                        b.first_t);
+              });
+    return intersections;
+}
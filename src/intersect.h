@@ -0,0 +1,48 @@
+#ifndef SPLINE_PLOTTER_INTERSECT_H_
+#define SPLINE_PLOTTER_INTERSECT_H_
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "adaptive.h"
+#include "spline.h"
+
+// px, crossings are located to within this
+const double intersection_tolerance = 1e-3;
+// two cubics cross at most 9 times, so a pair stops being searched after that,
+// which also bounds the points reported where two curves overlap
+const unsigned int max_pair_intersections = 9;
+
+struct Intersection {
+    unsigned int first_segment = 0;
+    // the same as first_segment where a segment crosses itself
+    unsigned int second_segment = 0;
+    // parameters over [0, 1] of the Bezier forms of either segment,
+    // first_t < second_t where a segment crosses itself
+    double first_t = 0.0;
+    double second_t = 0.0;
+    Eigen::Vector2d point = Eigen::Vector2d::Zero();
+};
+
+// Whether two convex hulls in the counter-clockwise order of SortConvex
+// overlap, false if an edge of either has every point of the other strictly
+// outside it
+bool HullsOverlap(const PairVector& first, const PairVector& second);
+
+// Every crossing between and within segments given in Bezier form, ordered by
+// first_segment, second_segment and first_t, with first_segment <=
+// second_segment. Candidate pairs are those whose boxes meet in a SpatialGrid,
+// dropped unless their convex hulls overlap. Each survivor is split in half by
+// de Casteljau, dropping pieces whose boxes are apart, until both pieces are
+// flat to within tolerance and their chords are intersected, the parameters
+// there refined by Newton steps where the pieces cross at an angle. A segment
+// can only cross itself if its control polygon turns by more than pi, so
+// those are split until their pieces turn by less and the pieces crossed with
+// each other. Consecutive segments, and the last and first of a closed
+// curve, are not taken to cross where they join. Other segments ending there
+// do cross, reported once from the segments that end rather than start there
+std::vector<Intersection> FindIntersections(
+    const std::vector<BezierMatrix>& segments,
+    double tolerance = intersection_tolerance);
+
+#endif  // SPLINE_PLOTTER_INTERSECT_H_
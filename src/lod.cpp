@@ -0,0 +1,155 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// levels past this would have tolerances of over 10^9 world units
+static const unsigned int max_lod_levels = 32;
+
+// Writes the strips of from, decimated to tolerance, to to
+static void Decimate(const LodStrips& from, double tolerance, LodStrips& to) {
+    to.Clear();
+    const double squared_tolerance = tolerance * tolerance;
+    float kept_x = 0.0f, kept_y = 0.0f;  // last vertex appended
+    float end_x = 0.0f, end_y = 0.0f;  // last vertex read
+    bool pending = false;  // the last vertex read was dropped
+    auto keep = [&](float x, float y) {
+        to.vertices.push_back(x);
+        to.vertices.push_back(y);
+        to.counts.back()++;
+        kept_x = x;
+        kept_y = y;
+    };
+    // strips always keep their last vertex
+    auto close = [&] {
+        if (pending) keep(end_x, end_y);
+        pending = false;
+    };
+    auto distance = [](float x0, float y0, float x1, float y1) {
+        double dx = x1 - x0, dy = y1 - y0;
+        return dx * dx + dy * dy;
+    };
+
+    for (size_t s = 0; s < from.firsts.size(); s++) {
+        const float* vertex =
+            from.vertices.data() + 2 * static_cast<size_t>(from.firsts[s]);
+        const float* end = vertex + 2 * static_cast<size_t>(from.counts[s]);
+        // strips whose ends meet within tolerance are joined
+        if (to.counts.empty() || distance(end_x, end_y, vertex[0],
+                                          vertex[1]) > squared_tolerance) {
+            if (!to.counts.empty()) close();
+            to.firsts.push_back(to.NumVertices());
+            to.counts.push_back(0);
+            keep(vertex[0], vertex[1]);
+            end_x = vertex[0];
+            end_y = vertex[1];
+            vertex += 2;
+        }
+        for (; vertex < end; vertex += 2) {
+            end_x = vertex[0];
+            end_y = vertex[1];
+            pending = distance(kept_x, kept_y, end_x, end_y) <=
+                      squared_tolerance;
+            if (!pending) keep(end_x, end_y);
+        }
+    }
+    if (!to.counts.empty()) close();
+}
+
+double LodPyramid::Tolerance(unsigned int level) {
+    return level == 0 ? 0.0
+                      : std::ldexp(lod_base_tolerance,
+                                   static_cast<int>(level) - 1);
+}
+
+unsigned int LodPyramid::ChooseLevel(double pixel_size) {
+    unsigned int level = 0;
+    while (level < max_lod_levels &&
+           Tolerance(level + 1) <= lod_pixel_error * pixel_size)
+        level++;
+    return level;
+}
+
+void LodPyramid::BuildChunk(const SampleArena& splines, unsigned int c) {
+    LodChunk& chunk = chunks_[c];
+    const unsigned int first = c * lod_chunk_segments;
+    const unsigned int last =
+        std::min(first + lod_chunk_segments, splines.NumSegments());
+
+    // level 0 as strips, one per segment
+    LodStrips samples;
+    const double inf = std::numeric_limits<double>::infinity();
+    chunk.bounds = BoundingBox{inf, inf, -inf, -inf};
+    for (unsigned int k = first; k < last; k++) {
+        samples.firsts.push_back(samples.NumVertices());
+        samples.counts.push_back(
+            static_cast<int>(splines.SegmentSamples(k)));
+        const double* sample = splines.Data() + 2 * splines.SegmentOffset(k);
+        const double* end = splines.Data() + 2 * splines.SegmentOffset(k + 1);
+        for (; sample < end; sample += 2) {
+            samples.vertices.push_back(static_cast<float>(sample[0]));
+            samples.vertices.push_back(static_cast<float>(sample[1]));
+            chunk.bounds.min_x = std::min(chunk.bounds.min_x, sample[0]);
+            chunk.bounds.min_y = std::min(chunk.bounds.min_y, sample[1]);
+            chunk.bounds.max_x = std::max(chunk.bounds.max_x, sample[0]);
+            chunk.bounds.max_y = std::max(chunk.bounds.max_y, sample[1]);
+        }
+    }
+
+    const double extent = std::hypot(chunk.bounds.max_x - chunk.bounds.min_x,
+                                     chunk.bounds.max_y - chunk.bounds.min_y);
+    size_t num_levels = 0;
+    for (unsigned int level = 1; level <= max_lod_levels; level++) {
+        if (chunk.levels.size() < level) chunk.levels.emplace_back();
+        Decimate(level == 1 ? samples : chunk.levels[level - 2],
+                 Tolerance(level), chunk.levels[level - 1]);
+        num_levels = level;
+        if (Tolerance(level) >= extent) break;
+    }
+    chunk.levels.resize(num_levels);
+}
+
+void LodPyramid::Update(const SampleArena& splines, unsigned int first,
+                        unsigned int last) {
+    const unsigned int total_segments = splines.NumSegments();
+    if (total_segments < num_segments_) {
+        first = std::min(first, total_segments);
+        last = std::max(last, total_segments);
+    }
+    num_segments_ = total_segments;
+    const unsigned int num_chunks =
+        (total_segments + lod_chunk_segments - 1) / lod_chunk_segments;
+    unsigned int end_chunk = std::min(
+        num_chunks, (last + lod_chunk_segments - 1) / lod_chunk_segments);
+    chunks_.resize(num_chunks);
+    for (unsigned int c = first / lod_chunk_segments; c < end_chunk; c++)
+        BuildChunk(splines, c);
+}
+
+void LodPyramid::Clear() {
+    chunks_.clear();
+    num_segments_ = 0;
+}
+
+void LodPyramid::VisibleChunks(const BoundingBox& view,
+                               std::vector<unsigned int>& chunks) const {
+    for (unsigned int c = 0; c < chunks_.size(); c++)
+        if (chunks_[c].bounds.Intersects(view)) chunks.push_back(c);
+}
+
+void LodPyramid::Gather(const std::vector<unsigned int>& chunks,
+                        unsigned int level, LodStrips& strips) const {
+    for (unsigned int c : chunks) {
+        const std::vector<LodStrips>& levels = chunks_[c].levels;
+        if (levels.empty() || level == 0) continue;
+        const LodStrips& from =
+            levels[std::min<size_t>(level, levels.size()) - 1];
+        const int offset = strips.NumVertices();
+        strips.vertices.insert(strips.vertices.end(), from.vertices.begin(),
+                               from.vertices.end());
+        for (int first : from.firsts) strips.firsts.push_back(first + offset);
+        strips.counts.insert(strips.counts.end(), from.counts.begin(),
+                             from.counts.end());
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef SPLINE_PLOTTER_LOD_H_
+#define SPLINE_PLOTTER_LOD_H_
+
+#include <vector>
+
+#include "arena.h"
+#include "spatial.h"
+
+// segments per chunk, the unit that is culled and rebuilt after an edit
+const unsigned int lod_chunk_segments = 32;
+// world units the samples of level 1 may move, doubling with every level
+const double lod_base_tolerance = 0.25;
+// px a level's tolerance may cover on screen. Levels are built from the one
+// before, so their errors add up to at most twice this
+const double lod_pixel_error = 0.25;
+
+// Line strips of one level of detail of a chunk
+struct LodStrips {
+    std::vector<float> vertices;  // x, y
+    std::vector<int> firsts;  // first vertex of every strip
+    std::vector<int> counts;
+
+    int NumVertices() const {
+        return static_cast<int>(vertices.size() / 2);
+    }
+    void Clear() {
+        vertices.clear();
+        firsts.clear();
+        counts.clear();
+    }
+};
+
+struct LodChunk {
+    BoundingBox bounds;
+    // levels[l - 1] is level l, level 0 being the samples themselves. Levels
+    // stop once the tolerance exceeds the chunk, when nothing is left to drop
+    std::vector<LodStrips> levels;
+};
+
+// Simplified copies of the samples of every chunk of segments, for drawing
+// at any zoom with about as many vertices as the curve covers px. Level l
+// keeps a sample only if it is more than Tolerance(l) from the last one kept
+// in level l - 1, which moves the polyline by at most that, and joins
+// segments whose ends are that close into one strip. Every level takes one
+// pass over the level below, so a chunk rebuilds in time linear in its
+// samples
+class LodPyramid {
+   public:
+    // 0 for level 0
+    static double Tolerance(unsigned int level);
+    // Coarsest level whose tolerance covers at most lod_pixel_error px when a
+    // px is pixel_size world units
+    static unsigned int ChooseLevel(double pixel_size);
+
+    unsigned int NumChunks() const {
+        return static_cast<unsigned int>(chunks_.size());
+    }
+    const LodChunk& Chunk(unsigned int c) const { return chunks_[c]; }
+
+    // Rebuilds the chunks holding segments [first, last) of splines, and the
+    // last one if segments were removed from the end since the last update
+    void Update(const SampleArena& splines, unsigned int first,
+                unsigned int last);
+    void Clear();
+
+    // Appends the chunks whose bounds intersect view to chunks
+    void VisibleChunks(const BoundingBox& view,
+                       std::vector<unsigned int>& chunks) const;
+    // Appends level l > 0 of chunks to strips, or the coarsest level of the
+    // chunks that have fewer
+    void Gather(const std::vector<unsigned int>& chunks, unsigned int level,
+                LodStrips& strips) const;
+
+   private:
+    void BuildChunk(const SampleArena& splines, unsigned int c);
+
+    std::vector<LodChunk> chunks_;
+    unsigned int num_segments_ = 0;
+};
+
+#endif  // SPLINE_PLOTTER_LOD_H_
@@ -2,38 +2,61 @@
 #include <GL/gl.h>
 #include <GL/glut.h>
 #include <fmt/format.h>
-#include <math.h>
 
-#include <Eigen/Core>
-#include <algorithm>
 #include <chrono>
 #include <cmath>
-#include <filesystem>
-#include <fstream>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "args.h"
+#include "export.h"
+#include "fit.h"
+#include "headless.h"
+#include "lod.h"
+#include "renderer.h"
+#include "scene.h"
+#include "serve.h"
+#include "spline.h"
+#include "trace.h"
+#include "viewport.h"
+
 const int screen_height = 800;
 const int screen_width = 1280;
-
-unsigned int spline_degree = 3;  // p
-unsigned int spline_subdiv = 150;
-std::string spline_type = "Hermite";
-
-typedef std::vector<std::pair<int, int>> PairVector;
-typedef Eigen::Matrix<double, Eigen::Dynamic, 2, Eigen::RowMajor> SplineMatrix;
-
-PairVector points;
-std::vector<SplineMatrix> splines;
-
-unsigned int num_points = 0;
-unsigned int num_splines = 0;
-unsigned int num_control_points = spline_degree + 1;
-
-unsigned int showConvexHull = 0;
-unsigned int GCont = 0;
-unsigned int CCont = 0;
+const int pick_radius = 8;  // px
+const double zoom_step = 1.25;  // per notch of the mouse wheel
+const double fit_margin = 20.0;  // px
+// bitmap labels are drawn one call each, so large scenes are left unlabelled
+const unsigned int max_labelled_points = 500;
+
+int dragged_point = -1;  // index of the point being dragged, -1 if none
+bool dragging = false;
+Viewport view(screen_width, screen_height);
+bool panning = false;  // the middle button is dragging the view
+// samples of the stroke being drawn with --fit, fitted when it is released
+PairVector stroke;
+int pan_x = 0, pan_y = 0;  // window position of the last pan event
+// crossings of the curve marked since 'i' was pressed, cleared once any
+// segment changes
+std::vector<Intersection> intersections;
+unsigned int intersected_splines = 0;
+bool intersections_requested = false;
+
+struct FrameStats {
+    unsigned long redraws = 0;
+    double frame_ms = 0.0;  // CPU time to submit and swap the last frame
+    unsigned int vertices = 0;
+};
+
+FrameStats frame_stats;
+std::chrono::steady_clock::time_point last_frame;
+bool redraw_pending = false;
+// time of the oldest input not yet shown in a frame, for tracing
+uint64_t input_time = 0;
+bool input_pending = false;
 
 void CreateScreen() {
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
@@ -42,128 +65,44 @@ void CreateScreen() {
     glutInitWindowSize(screen_width, screen_height);
     glutCreateWindow("Spline Plotter");
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+}
 
+void SetProjection(const BoundingBox& box) {
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluOrtho2D(0.0, screen_width, 0.0, screen_height);
+    gluOrtho2D(box.min_x, box.max_x, box.min_y, box.max_y);
+    glMatrixMode(GL_MODELVIEW);
 }
 
-PairVector ReturnLastNFromM(PairVector& coordinates, unsigned int n,
-                            unsigned int m) {
-    // returns elements of index n to m of the PairVector
-    PairVector control_points(&coordinates[m - n], &coordinates[m]);
-    return control_points;
-}
-
-PairVector ReturnLastN(PairVector& coordinates, unsigned int n) {
-    // returns the last n points of the PairVector
-    unsigned int m = static_cast<unsigned int>(coordinates.size());
-    return ReturnLastNFromM(coordinates, n, m);
-}
-
-unsigned int ReturnPointIndex(std::string spline_type_) {
-    unsigned int index = num_points;
-
-    if (num_points >= num_control_points) {
-        if (spline_type_ == "Hermite" || spline_type_ == "Bezier" ||
-            spline_type_ == "MINVO") {
-            index = (num_points - 1) % spline_degree;
-        } else {
-            index = 0;
-        }
+void FitView() {
+    // the curve can leave the control polygon, so both are fitted
+    BoundingBox bounds = SplineBounds();
+    for (auto point : points) {
+        bounds.min_x = std::min<double>(bounds.min_x, point.first);
+        bounds.min_y = std::min<double>(bounds.min_y, point.second);
+        bounds.max_x = std::max<double>(bounds.max_x, point.first);
+        bounds.max_y = std::max<double>(bounds.max_y, point.second);
     }
-    return index;
-}
-
-double ComputePolarAngle(std::pair<int, int> p0, std::pair<int, int> p1) {
-    double polar_angle;
-    double dy = p0.second - p1.second;
-    double dx = p0.first - p1.first;
-
-    if (dy != 0)
-        polar_angle = atan2(dy, dx);
-    else
-        polar_angle = -M_PI;
-    return polar_angle;
-}
-
-int CheckCCW(std::pair<int, int> p0, std::pair<int, int> p1,
-             std::pair<int, int> p2) {
-    // Check whether p2 lies left of line segment p0-p1 with cross product
-    return (p1.first - p0.first) * (p2.second - p0.second) -
-           (p2.first - p0.first) * (p1.second - p0.second);
+    view.Fit(bounds, fit_margin);
 }
 
-PairVector SortConvex(PairVector& control_points) {
-    // Graham Scan convex sorting algorithm
-    if (control_points.size() < 3)
-        throw std::invalid_argument("number of control points less than 3");
-    PairVector sorted_points;
-
-    // STEP 1: Find the bottom left point
-    std::pair<int, int> bl_point = control_points[0];
-    for (auto point : control_points) {
-        if ((point.second < bl_point.second) ||
-            (point.second == bl_point.second && point.first < bl_point.first))
-            bl_point = point;
-    }
-
-    // STEP 2: Sort the points by ascending polar angle with bl_point
-    std::sort(control_points.begin(), control_points.end(),
-              [bl_point](std::pair<int, int>& p0, std::pair<int, int>& p1) {
-                  double angle0 = ComputePolarAngle(bl_point, p0);
-                  double angle1 = ComputePolarAngle(bl_point, p1);
-                  return angle0 < angle1;
-              });
-
-    // STEP3: Remove interior points by checking CCW condition
-    for (auto point : control_points) {
-        while (sorted_points.size() > 1 &&
-               CheckCCW(*(sorted_points.end() - 2), sorted_points.back(),
-                        point) <= 0) {
-            sorted_points.pop_back();
-        }
-        sorted_points.push_back(point);
-    }
-
-    return sorted_points;
+// window px, y from the top as GLUT reports them, to world coordinates
+ControlPoint WorldPoint(int x, int y) {
+    Eigen::Vector2d world = view.ScreenToWorld(x, screen_height - y);
+    return std::make_pair(world(0), world(1));
 }
 
-void DrawPoint(int x, int y) {
-    glPointSize(7);
+void DrawText(double x, double y, std::string str,
+              void* font = GLUT_BITMAP_9_BY_15) {
     glColor3f(0.0f, 0.0f, 0.0f);
-    glEnable(GL_POINT_SMOOTH);
-    glEnable(GL_BLEND);
-
-    glBegin(GL_POINTS);
-    glVertex2i(x, y);
-    glEnd();
-}
-
-void DrawText(int x, int y, std::string str, void* font = GLUT_BITMAP_9_BY_15) {
-    glColor3f(0.0f, 0.0f, 0.0f);
-    glRasterPos2i(x + 5, y + 5);
+    glRasterPos2d(x + 5, y + 5);
     auto cstr = str.c_str();
     glutBitmapString(font, reinterpret_cast<const unsigned char*>(cstr));
 }
 
-void DrawSpline(SplineMatrix& spline) {
-    glColor3f(1.0f, 0.0f, 0.0f);
-    glLineWidth(2.5f);
-    glEnable(GL_LINE_SMOOTH);
-
-    glBegin(GL_LINE_STRIP);
-    for (unsigned int i = 1; i < spline.rows(); i++) {
-        glVertex2i(static_cast<int>(spline(i - 1, 0)),
-                   static_cast<int>(spline(i - 1, 1)));
-        glVertex2i(static_cast<int>(spline(i, 0)),
-                   static_cast<int>(spline(i, 1)));
-    }
-    glEnd();
-}
-
-void DrawSimplex(std::string spline_type_, unsigned int style = 0) {
+unsigned int DrawSimplex(SplineType spline_type_, unsigned int style = 0) {
     // Draw lines or polygons to illustrate the simplex ("control polygon")
+    unsigned int vertices = 0;
     if (num_points >= num_control_points) {
         glPushAttrib(GL_ENABLE_BIT);
         switch (style) {
@@ -176,31 +115,24 @@ void DrawSimplex(std::string spline_type_, unsigned int style = 0) {
                 // Draw lines between adjacent points
                 glBegin(GL_LINES);
                 for (unsigned int i = 0; i < num_points - 1; i++) {
-                    glVertex2i(points[i].first, points[i].second);
-                    glVertex2i(points[i + 1].first, points[i + 1].second);
+                    glVertex2d(points[i].first, points[i].second);
+                    glVertex2d(points[i + 1].first, points[i + 1].second);
                 }
                 glEnd();
+                vertices += 2 * (num_points - 1);
                 break;
             case (2):
                 glColor4f(0.2f, 0.5f, 0.2f, 0.2f);
 
-                for (unsigned int i = 0; i < num_splines; i++) {
-                    unsigned int iter = 1;
-                    if (spline_type_ == "Hermite" || spline_type_ == "Bezier" ||
-                        spline_type == "MINVO")
-                        iter = spline_degree;
-
-                    PairVector control_points =
-                        ReturnLastNFromM(points, num_control_points,
-                                         num_control_points + iter * i);
-                    control_points = SortConvex(control_points);
-
+                // hulls are computed when their segment is created or edited
+                for (const PairVector& hull : hulls) {
                     // Draw control polygon
                     glBegin(GL_POLYGON);
-                    for (auto point : control_points) {
-                        glVertex2i(point.first, point.second);
+                    for (auto point : hull) {
+                        glVertex2d(point.first, point.second);
                     }
                     glEnd();
+                    vertices += static_cast<unsigned int>(hull.size());
                 }
                 break;
             default:
@@ -209,13 +141,16 @@ void DrawSimplex(std::string spline_type_, unsigned int style = 0) {
         }
         glPopAttrib();
     }
+    return vertices;
 }
 
-void DisplayData(std::string spline_type_, unsigned int num_points_,
-                 unsigned int CCont_, unsigned int GCont_) {
+void DisplayData(SplineType spline_type_, unsigned int num_points_,
+                 unsigned int CCont_, unsigned int GCont_,
+                 const FrameStats& stats) {
     auto font = GLUT_BITMAP_HELVETICA_12;
 
-    std::string display_spline_type = "Spline type: " + spline_type_;
+    std::string display_spline_type =
+        "Spline type: " + SplineTypeName(spline_type_);
     DrawText(10, screen_height - 30 - 25 * 0, display_spline_type, font);
 
     std::string display_points =
@@ -225,247 +160,178 @@ void DisplayData(std::string spline_type_, unsigned int num_points_,
     std::string display_cont =
         fmt::format("Continuity: C{}, G{}", CCont_, GCont_);
     DrawText(10, screen_height - 30 - 25 * 2, display_cont, font);
-}
 
-SplineMatrix ComputeSpline(PairVector& control_points, std::string spline_type_,
-                           unsigned int spline_degree_,
-                           unsigned int derivative) {
-    int num_control_points_ = static_cast<int>(spline_degree_) + 1;
-    assert(static_cast<int>(control_points.size()) == num_control_points_);
-
-    // declare dynamic size matrices as spline degree not known at compile time
-    // allocate array of coefficients with constructors that take size
-    // allocates on the heap
-    SplineMatrix spline;                                             // Q
-    Eigen::Matrix<double, 1, -1> param_vec(1, num_control_points_);  // T^(p)
-    Eigen::Matrix<double, -1, -1> basis_matrix(num_control_points_,
-                                               num_control_points_);        // M
-    Eigen::Matrix<double, -1, -1> geometry_matrix(num_control_points_, 2);  // G
-
-    Eigen::Matrix<double, 1, 2> spline_point(0.0, 0.0);
-
-    if (spline_type_ == "Hermite") {
-        basis_matrix << 2, -2, 1, 1, -3, 3, -2, -1, 0, 0, 1, 0, 1, 0, 0, 0;
-
-        std::pair<int, int> tangent1 =
-            std::make_pair(control_points[1].first - control_points[0].first,
-                           control_points[1].second - control_points[0].second);
-        std::pair<int, int> tangent2 =
-            std::make_pair(control_points[3].first - control_points[2].first,
-                           control_points[3].second - control_points[2].second);
-
-        geometry_matrix << control_points[0].first, control_points[0].second,
-            control_points[3].first, control_points[3].second, tangent1.first,
-            tangent1.second, tangent2.first, tangent2.second;
-    } else {
-        geometry_matrix << control_points[0].first, control_points[0].second,
-            control_points[1].first, control_points[1].second,
-            control_points[2].first, control_points[2].second,
-            control_points[3].first, control_points[3].second;
-
-        if (spline_type_ == "Bezier") {
-            basis_matrix << -1, 3, -3, 1, 3, -6, 3, 0, -3, 3, 0, 0, 1, 0, 0, 0;
-        } else if (spline_type_ == "BSpline") {
-            basis_matrix << -1, 3, -3, 1, 3, -6, 3, 0, -3, 0, 3, 0, 1, 4, 1, 0;
-            basis_matrix /= 6;
-        } else if (spline_type_ == "CatmullRom") {
-            basis_matrix << -1, 3, -3, 1, 2, -5, 4, -1, -1, 0, 1, 0, 0, 2, 0, 0;
-            basis_matrix /= 2;
-        } else if (spline_type_ == "MINVO") {
-            basis_matrix << -0.4302, 0.4568, -0.02698, 0.0004103, 0.8349,
-                -0.4568, -0.7921, 0.4996, -0.8349, -0.4568, 0.7921, 0.4996,
-                0.4302, 0.4568, 0.02698, 0.0004103;
-            basis_matrix.transposeInPlace();
-        }
-    }
+    std::string display_stats =
+        fmt::format("Frame: {:.2f} ms, redraws: {}, vertices: {}",
+                    stats.frame_ms, stats.redraws, stats.vertices);
+    DrawText(10, screen_height - 30 - 25 * 3, display_stats, font);
 
-    double t_range[2] = {0.0, 1.0};
-    if (spline_type_ == "MINVO") t_range[0] = -1.0;
-
-    // Q = TMG
-    for (double t = t_range[0]; t <= t_range[1]; t += 1.0 / spline_subdiv) {
-        for (unsigned int i = spline_degree_; spline_degree_ >= i; i--) {
-            switch (derivative) {
-                case 0:  // compute points of the spline
-                    param_vec(i) = pow(t, i);
-                    break;
-                case 1:  // compute parametric velocity
-                    param_vec(i) = i * pow(t, i - 1);
-                    break;
-                case 2:  // compute parametric acceleration
-                    i*(i - 1) * pow(t, i - 2);
-                    break;
-                default:
-                    std::cout << "Choose from derivatives = {0, 1, 2}"
-                              << std::endl;
-                    break;
-            }
-        }
-        param_vec.reverseInPlace();  // t parameter ordered in descending powers
-        spline_point = param_vec * basis_matrix * geometry_matrix;
-        spline.conservativeResize(spline.rows() + 1, spline.cols());
-        spline.row(spline.rows() - 1) = spline_point;
-    }
-    return spline;
+    std::string display_view =
+        fmt::format("Zoom: {:.3g}x, detail level: {}", view.Scale(),
+                    LodPyramid::ChooseLevel(view.PixelSize()));
+    DrawText(10, screen_height - 30 - 25 * 4, display_view, font);
 }
 
-void EnforceContinuity(PairVector& coordinates, unsigned int GCont_,
-                       unsigned int CCont_) {
-    Eigen::Vector2d prevDir;
-    Eigen::Vector2d currDir;
-    Eigen::Vector2d prevPoint;
-    Eigen::Vector2d newPoint;
-
-    // Enforce G1 continuity
-    if (GCont_ == 1 && (spline_type == "Hermite" || spline_type == "Bezier")) {
-        if (ReturnPointIndex(spline_type) == 1 &&
-            num_points > num_control_points) {
-            // indices further reduced by 1 as num_points starts from 1
-            prevDir << static_cast<double>(
-                coordinates[num_points - 1 - 1].first -
-                coordinates[num_points - 2 - 1].first),
-                static_cast<double>(coordinates[num_points - 1 - 1].second -
-                                    coordinates[num_points - 2 - 1].second);
-
-            currDir << static_cast<double>(
-                coordinates[num_points - 1].first -
-                coordinates[num_points - 1 - 1].first),
-                static_cast<double>(coordinates[num_points - 1].second -
-                                    coordinates[num_points - 1 - 1].second);
-
-            prevPoint << static_cast<double>(
-                coordinates[num_points - 1 - 1].first),
-                static_cast<double>(coordinates[num_points - 1 - 1].second);
-
-            double vel = currDir.dot(prevDir.normalized());
-            // Enforce C1 continuity
-            if (CCont_ == 1) vel = prevDir.norm();
-
-            prevDir = prevDir.normalized();
-            newPoint = vel * prevDir + prevPoint;
-            newPoint(0) = static_cast<int>(newPoint(0));
-            newPoint(1) = static_cast<int>(newPoint(1));
-
-            std::cout << "Adjust Point " << num_points << "\t\t"
-                      << "(" << newPoint(0) << ", " << newPoint(1) << ")"
-                      << std::endl;
-
-            coordinates[num_points - 1].first = (newPoint(0));
-            coordinates[num_points - 1].second = (newPoint(1));
-        }
-    }
+void MarkInput() {
+    if (!trace_enabled || input_pending) return;
+    input_time = TraceNow();
+    input_pending = true;
 }
 
-void GroupPoints(std::string spline_type_) {
-    if (spline_type_ == "Hermite" || spline_type_ == "Bezier" ||
-        spline_type == "MINVO") {
-        if (ReturnPointIndex(spline_type_) == 0) {
-            PairVector control_points = ReturnLastN(points, num_control_points);
-            splines.push_back(
-                ComputeSpline(control_points, spline_type_, spline_degree, 0));
-            num_splines++;
-        }
-    } else if (spline_type_ == "BSpline" || spline_type_ == "CatmullRom") {
-        if (ReturnPointIndex(spline_type_) == 0) {
-            PairVector control_points = ReturnLastN(points, num_control_points);
-            splines.push_back(
-                ComputeSpline(control_points, spline_type_, spline_degree, 0));
-            num_splines++;
-        }
+void FindAndExportIntersections() {
+    intersected_splines = num_splines;
+    try {
+        auto start = std::chrono::steady_clock::now();
+        intersections = FindCurveIntersections();
+        std::chrono::duration<double, std::milli> find_time =
+            std::chrono::steady_clock::now() - start;
+        std::cout << fmt::format(
+                         "Found {} intersections among {} segments in "
+                         "{:.3f} ms",
+                         intersections.size(), num_splines, find_time.count())
+                  << std::endl;
+        std::cout << "Exported intersections to "
+                  << ExportIntersections(intersections) << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << e.what() << std::endl;
     }
 }
 
 void RenderScene(void) {
+    ScopedTrace trace("render");
+    auto frame_start = std::chrono::steady_clock::now();
+    unsigned int vertices = 0;
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    SetProjection(view.Visible());
 
     // Convex Hull drawn in first "layer" below points and splines
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
-    if (showConvexHull) DrawSimplex(spline_type, showConvexHull);
-
-    int i = 1;
-    for (std::pair<int, int> point : points) {
-        DrawPoint(point.first, point.second);
-        std::string point_string = 'P' + std::to_string(i);
-        DrawText(point.first, point.second, point_string);
-        i++;
+    if (showConvexHull) {
+        ScopedTrace hull_trace("draw hulls");
+        vertices += DrawSimplex(spline_type, showConvexHull);
     }
 
-    for (SplineMatrix spline : splines) {
-        DrawSpline(spline);
+    // the buffers clear the dirty range, so stale markers are found first
+    if (!dirty_splines.Empty() || num_splines != intersected_splines)
+        intersections.clear();
+    {
+        ScopedTrace sync_trace("upload buffers");
+        SyncRenderBuffers();
+    }
+    if (intersections_requested) {
+        ScopedTrace intersect_trace("find intersections");
+        intersections_requested = false;
+        FindAndExportIntersections();
+    }
+    {
+        ScopedTrace points_trace("draw points");
+        vertices += DrawPoints();
+        if (num_points <= max_labelled_points) {
+            int i = 1;
+            for (const ControlPoint& point : points) {
+                std::string point_string = 'P' + std::to_string(i);
+                DrawText(point.first, point.second, point_string);
+                i++;
+            }
+        }
+    }
+    {
+        ScopedTrace splines_trace("draw splines");
+        vertices += DrawSplines(view);
+    }
+    if (!intersections.empty()) {
+        glPointSize(9);
+        glColor3f(0.0f, 0.4f, 1.0f);
+        glBegin(GL_POINTS);
+        for (const Intersection& crossing : intersections)
+            glVertex2d(crossing.point(0), crossing.point(1));
+        glEnd();
+        vertices += static_cast<unsigned int>(intersections.size());
+    }
+    if (!stroke.empty()) {
+        glColor3f(0.5f, 0.5f, 0.5f);
+        glBegin(GL_LINE_STRIP);
+        for (const ControlPoint& sample : stroke)
+            glVertex2d(sample.first, sample.second);
+        glEnd();
+        vertices += static_cast<unsigned int>(stroke.size());
     }
 
-    DisplayData(spline_type, num_points, CCont, GCont);
+    // the overlay stays put in window coordinates
+    SetProjection(BoundingBox{0.0, 0.0, static_cast<double>(screen_width),
+                              static_cast<double>(screen_height)});
+    DisplayData(spline_type, num_points, CCont, GCont, frame_stats);
 
-    glFlush();
-    glutSwapBuffers();
-}
+    {
+        ScopedTrace swap_trace("swap buffers");
+        glFlush();
+        glutSwapBuffers();
+    }
+    TraceCounter("vertices", vertices);
+    if (input_pending) {
+        TraceSpan("input to frame", input_time, TraceNow());
+        input_pending = false;
+    }
 
-void RemoveAllPoints() {
-    std::cout << "Remove all inserted points" << std::endl;
-    points.clear();
-    splines.clear();
-    num_points = 0;
-    num_splines = 0;
+    last_frame = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> frame_time =
+        last_frame - frame_start;
+    frame_stats.redraws++;
+    frame_stats.frame_ms = frame_time.count();
+    frame_stats.vertices = vertices;
+    if (printStats)
+        std::cout << fmt::format("frame {}: {:.3f} ms, {} vertices",
+                                 frame_stats.redraws, frame_stats.frame_ms,
+                                 frame_stats.vertices)
+                  << std::endl;
 }
 
-void RemovePrevPoint() {
-    if (num_points > 0) {
-        std::cout << "Remove Point " << num_points << std::endl;
-        points.pop_back();
-        num_points--;
-        if (spline_type == "Hermite" || spline_type == "Bezier" ||
-            spline_type == "MINVO") {
-            if (num_points == num_control_points - 1 ||
-                ((num_points - num_control_points) % spline_degree ==
-                     (spline_degree - 1) &&
-                 num_points >= num_control_points)) {
-                num_splines--;
-                splines.pop_back();
-            }
-        } else {
-            if (num_points >= num_control_points - 1) {
-                splines.pop_back();
-                num_splines--;
-            }
-        }
-    } else {
-        std::cout << "Cannot remove points as num_points = 0" << std::endl;
-    }
+void PacedRedraw(int value) {
+    redraw_pending = false;
+    glutPostRedisplay();
 }
 
-void ExportData(std::vector<SplineMatrix>& allSplineSegments,
-                bool printTimeStamp = true) {
-    static int count = 0;
-    auto now = std::chrono::system_clock::now();
-    auto UTC = std::chrono::duration_cast<std::chrono::seconds>(
-        now.time_since_epoch());
-
-    std::filesystem::create_directory("results");
-    Eigen::IOFormat printFmt(Eigen::FullPrecision, 0, ", ", "\n", "", "");
-
-    std::string filename =
-        fmt::format("results/splines_{}_{}", spline_type, count);
-    if (printTimeStamp) filename += "_" + std::to_string(UTC.count());
-    filename += ".csv";
-    std::ofstream output(filename);
-    count++;
-
-    for (const SplineMatrix& spline : allSplineSegments) {
-        output << spline.format(printFmt) << std::endl;
+void RequestRedraw() {
+    // redraw only when the scene changed, at most frameRate times a second
+    if (frameRate == 0) {
+        glutPostRedisplay();
+        return;
+    }
+    if (redraw_pending) return;
+    std::chrono::duration<double, std::milli> since_last =
+        std::chrono::steady_clock::now() - last_frame;
+    double interval = 1000.0 / frameRate;
+    if (since_last.count() >= interval) {
+        glutPostRedisplay();
+    } else {
+        redraw_pending = true;
+        glutTimerFunc(static_cast<unsigned int>(interval - since_last.count()),
+                      PacedRedraw, 0);
     }
-    output.close();
 }
 
 void ProcessNormalKeyPress(unsigned char key, int x, int y) {
     // keyboard input (normal keys)
+    ScopedTrace trace("input");
     switch (key) {
         case 'r':
+            MarkInput();
             RemovePrevPoint();
+            RequestRedraw();
             break;
         case 'e':
             ExportData(splines);
             break;
+        case 'f':
+            FitView();
+            RequestRedraw();
+            break;
+        case 'i':
+            // found once the next frame has taken in every edit
+            intersections_requested = true;
+            RequestRedraw();
+            break;
         default:
             break;
     }
@@ -473,9 +339,12 @@ void ProcessNormalKeyPress(unsigned char key, int x, int y) {
 
 void ProcessSpecialKeyPress(int key, int x, int y) {
     // keyboard input (special keys)
+    ScopedTrace trace("input");
     switch (key) {
         case GLUT_KEY_F1:
+            MarkInput();
             RemoveAllPoints();
+            RequestRedraw();
             break;
         default:
             break;
@@ -487,121 +356,164 @@ void ProcessKeyRelease(int key, int x, int y) {
 }
 
 void ProcessMouse(int button, int state, int x, int y) {
-    // click motion
-    y = screen_height - y;
-    if ((state == GLUT_UP) && (button == GLUT_LEFT_BUTTON)) {
-        points.push_back(std::pair(x, y));
-        num_points = points.size();
-        std::cout << "Insert Point " << num_points << "\t\t"
-                  << "(" << x << ", " << y << ")" << std::endl;
-        EnforceContinuity(points, GCont, CCont);
-        GroupPoints(spline_type);
+    // click motion: press on a point to drag it, click elsewhere to insert,
+    // or with --fit drag elsewhere to draw a stroke and insert the points
+    // fitted to it, right click to report the nearest point of the curve,
+    // drag with the middle button to pan
+    ScopedTrace trace("input");
+    if (button == GLUT_MIDDLE_BUTTON) {
+        panning = state == GLUT_DOWN;
+        pan_x = x, pan_y = y;
+        return;
     }
-}
-
-void ProcessMouseActiveMotion(int x, int y) {
-    // drag motion
-    // if ((state == GLUT_DOWN) && (button == GLUT_LEFT_BUTTON)) {
-    // }
-}
-
-bool CheckArgSplineType(std::vector<std::string> args) {
-    bool valid = false;
-    auto checkSplineType =
-        std::find(std::begin(args), std::end(args), "--spline_type");
-    if (checkSplineType != std::end(args)) {
-        std::string spline_type_ = *(++checkSplineType);
-        if (spline_type_ == "Hermite" || spline_type_ == "Bezier" ||
-            spline_type_ == "BSpline" || spline_type_ == "CatmullRom" ||
-            spline_type_ == "MINVO") {
-            valid = true;
-            spline_type = spline_type_;
-        } else {
-            std::cout
-                << "Invalid argument --spline_type {Hermite, Bezier, BSpline, "
-                   "CatmullRom, MINVO}"
-                << std::endl;
+    if (button == GLUT_RIGHT_BUTTON && state == GLUT_DOWN) {
+        Eigen::Vector2d world = view.ScreenToWorld(x, screen_height - y);
+        CurvePoint nearest = ClosestPoint(world(0), world(1));
+        if (nearest.segment >= 0)
+            std::cout << "Nearest Segment " << nearest.segment + 1 << "\t\t"
+                      << "t = " << nearest.t << ", (" << nearest.point(0)
+                      << ", " << nearest.point(1) << "), "
+                      << nearest.distance << " px" << std::endl;
+        return;
+    }
+    if (button != GLUT_LEFT_BUTTON) return;
+    ControlPoint world = WorldPoint(x, y);
+    if (state == GLUT_DOWN) {
+        dragged_point = FindPoint(world.first, world.second,
+                                  pick_radius * view.PixelSize());
+        dragging = false;
+        if (dragged_point < 0 && fit_tolerance > 0.0) stroke = {world};
+    } else if (state == GLUT_UP) {
+        if (dragged_point < 0) {
+            MarkInput();
+            bool fitted = false;
+            if (stroke.size() > 1) {
+                stroke.push_back(world);
+                try {
+                    InsertFittedPoints(stroke);
+                    fitted = true;
+                } catch (const std::invalid_argument&) {
+                    // a stroke that never left its point is a click
+                }
+            }
+            if (!fitted) InsertPoint(world.first, world.second);
+            stroke.clear();
+            RequestRedraw();
+        } else if (dragging && log_points) {
+            std::cout << "Move Point " << dragged_point + 1 << "\t\t"
+                      << "(" << world.first << ", " << world.second << ")"
+                      << std::endl;
         }
-    } else {
-        std::cout << "No argument --spline_type {Hermite, Bezier, BSpline, "
-                     "CatmullRom, MINVO}"
-                  << std::endl;
+        dragged_point = -1;
     }
-    return valid;
 }
 
-void CheckArgConvexHull(std::vector<std::string> args) {
-    auto checkConvexHullPlotting =
-        std::find(std::begin(args), std::end(args), "--show_convex_hull");
-    if (checkConvexHullPlotting != std::end(args)) {
-        showConvexHull = std::stoul(*(++checkConvexHullPlotting));
+void WriteTraceAtExit() {
+    // exports still being written add their own events
+    WaitForExports();
+    if (WriteTraceFile(traceFile)) {
+        std::cout << "Wrote trace to " << traceFile << std::endl;
+    } else {
+        std::cout << "cannot write trace " << traceFile << std::endl;
     }
 }
 
-void CheckArgContinuity(std::vector<std::string> args) {
-    bool C2_spline = (spline_type == "BSpline" || spline_type == "CatmullRom");
-
-    if (C2_spline) {
-        std::cout << "C2 spline chosen: setting continuity C2, G2" << std::endl;
-        CCont = 2, GCont = 2;
-    } else {
-        auto checkGCont =
-            std::find(std::begin(args), std::end(args), "--GCont");
-        auto checkCCont =
-            std::find(std::begin(args), std::end(args), "--CCont");
-
-        if (checkCCont != std::end(args)) {
-            CCont = std::stoul(*(++checkCCont));
-            if (checkGCont != std::end(args)) {
-                GCont = std::stoul(*(++checkGCont));
-            }
-            if (GCont > CCont) {
-                std::cout << "Invalid continuity specified (GCont > CCont): "
-                             "setting GCont = CCont"
-                          << std::endl;
-                GCont = CCont;
-            }
-            std::cout << fmt::format("Setting continuity C{}, G{}", CCont,
-                                     GCont)
-                      << std::endl;
-        } else if (checkGCont != std::end(args)) {
-            GCont = std::stoul(*(++checkGCont));
-            std::cout << fmt::format("Setting continuity C{}, G{}", CCont,
-                                     GCont)
-                      << std::endl;
-        } else {
-            std::cout << "--CCont not specified. Defaulting to C0, G0"
-                      << std::endl;
-            CCont = 0;
-            GCont = 0;
-        }
+void ProcessMouseActiveMotion(int x, int y) {
+    // drag motion
+    if (panning) {
+        view.Pan(x - pan_x, pan_y - y);
+        pan_x = x, pan_y = y;
+        RequestRedraw();
+        return;
     }
-    std::cout << std::endl;
+    if (!stroke.empty()) {
+        stroke.push_back(WorldPoint(x, y));
+        RequestRedraw();
+        return;
+    }
+    if (dragged_point < 0) return;
+    ScopedTrace trace("input");
+    MarkInput();
+    dragging = true;
+    ControlPoint world = WorldPoint(x, y);
+    MovePoint(static_cast<unsigned int>(dragged_point), world.first,
+              world.second);
+    RequestRedraw();
 }
 
-void CheckArgDegree() {
-    // checks whether the spline degree is less than 2
-    if (spline_degree < 2)
-        throw std::invalid_argument("specified spline degree is less than 3");
+void ProcessMouseWheel(int wheel, int direction, int x, int y) {
+    // zooms about the cursor
+    view.ZoomAt(x, screen_height - y,
+                direction > 0 ? zoom_step : 1.0 / zoom_step);
+    RequestRedraw();
 }
 
 int main(int argc, char* argv[]) {
     std::vector<std::string> args(argv, argv + argc);
+    // every request to the service carries its own spline settings
+    if (!CheckArgString(args, "--serve").empty()) {
+        CheckArgThreads(args);
+        if (CheckArgTrace(args) == false) return EXIT_FAILURE;
+        if (trace_enabled) std::atexit(WriteTraceAtExit);
+        return RunServer(args);
+    }
+
     // required arguments
     if (CheckArgSplineType(args) == false) return EXIT_FAILURE;
 
     // optional arguments
     CheckArgConvexHull(args);
+    CheckArgFrameRate(args);
+    if (CheckArgDegree(args) == false) return EXIT_FAILURE;
+    if (CheckArgEnds(args) == false) return EXIT_FAILURE;
+    if (CheckArgKnots(args) == false) return EXIT_FAILURE;
     CheckArgContinuity(args);
-    CheckArgDegree();
+    if (CheckArgKernel(args) == false) return EXIT_FAILURE;
+    CheckArgThreads(args);
+    if (CheckArgTolerance(args) == false) return EXIT_FAILURE;
+    if (CheckArgSpacing(args) == false) return EXIT_FAILURE;
+    if (CheckArgFit(args) == false) return EXIT_FAILURE;
+    if (CheckArgExportFormat(args) == false) return EXIT_FAILURE;
+    if (CheckArgTrace(args) == false) return EXIT_FAILURE;
+    // glutMainLoop exits the process when the window closes, so the trace is
+    // written from an exit handler on every path
+    if (trace_enabled) std::atexit(WriteTraceAtExit);
+
+    if (CheckArgFlag(args, "--headless")) return RunHeadless(args);
+    if (!CheckArgString(args, "--import").empty()) return RunImport(args);
 
     glutInit(&argc, argv);
     CreateScreen();
+    InitRenderBuffers();
+    // a scene to explore can be loaded up front
+    std::string input_file = CheckArgString(args, "--input");
+    if (!input_file.empty()) {
+        std::vector<double> input_weights;  // only read for NURBS
+        try {
+            PairVector input_points = ImportPoints(
+                input_file,
+                spline_type == SplineType::NURBS ? &input_weights : nullptr);
+            if (fit_tolerance > 0.0) {
+                InsertFittedPoints(input_points);
+            } else {
+                InsertPoints(input_points, input_weights);
+            }
+        } catch (const std::runtime_error& error) {
+            std::cout << error.what() << std::endl;
+            return EXIT_FAILURE;
+        } catch (const std::invalid_argument& error) {
+            std::cout << error.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        SyncRenderBuffers();
+        FitView();
+    }
+    // redrawn on demand through RequestRedraw rather than from an idle loop
     glutDisplayFunc(RenderScene);
-    glutIdleFunc(RenderScene);
 
     glutMouseFunc(ProcessMouse);
     glutMotionFunc(ProcessMouseActiveMotion);
+    glutMouseWheelFunc(ProcessMouseWheel);
 
     glutIgnoreKeyRepeat(1);
     glutKeyboardFunc(ProcessNormalKeyPress);
@@ -0,0 +1,434 @@
+#include "nurbs.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+
+std::string KnotVectorName(KnotVector knot_vector) {
+    switch (knot_vector) {
+        case KnotVector::Uniform:
+            return "uniform";
+        case KnotVector::Clamped:
+            return "clamped";
+        default:
+            return "unknown";
+    }
+}
+
+bool ParseKnotVector(std::string name, KnotVector& knot_vector) {
+    for (KnotVector candidate : {KnotVector::Uniform, KnotVector::Clamped}) {
+        if (name == KnotVectorName(candidate)) {
+            knot_vector = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<double> UniformKnots(unsigned int spline_degree_,
+                                 unsigned int num_points_) {
+    std::vector<double> knots;
+    ResizeKnots(knots, KnotVector::Uniform, spline_degree_, num_points_);
+    return knots;
+}
+
+std::vector<double> ClampedKnots(unsigned int spline_degree_,
+                                 unsigned int num_points_) {
+    std::vector<double> knots;
+    ResizeKnots(knots, KnotVector::Clamped, spline_degree_, num_points_);
+    return knots;
+}
+
+size_t ResizeKnots(std::vector<double>& knots, KnotVector knot_vector,
+                   unsigned int spline_degree_, unsigned int num_points_) {
+    const size_t kept =
+        knots.size() > spline_degree_
+            ? std::min<size_t>(knots.size() - spline_degree_ - 1, num_points_)
+            : 0;
+    knots.resize(num_points_ + spline_degree_ + 1);
+    // u_{n + 1} ends the last span, 0 while there is no segment
+    const double last =
+        num_points_ > spline_degree_
+            ? static_cast<double>(num_points_ - spline_degree_)
+            : 0.0;
+    for (size_t i = kept; i < knots.size(); i++) {
+        double u = static_cast<double>(i);
+        if (knot_vector == KnotVector::Clamped)
+            u = std::clamp(u - spline_degree_, 0.0, last);
+        knots[i] = u;
+    }
+    return kept;
+}
+
+const double* SegmentKnots(const std::vector<double>& knots,
+                           SplineType spline_type_,
+                           unsigned int spline_degree_, unsigned int k) {
+    if (knots.empty() || spline_type_ != SplineType::NURBS) return nullptr;
+    return knots.data() + SegmentStart(spline_type_, spline_degree_, k);
+}
+
+unsigned int FirstSegmentWithKnot(unsigned int spline_degree_, size_t index) {
+    const size_t reach = 2 * static_cast<size_t>(spline_degree_) + 1;
+    return index > reach ? static_cast<unsigned int>(index - reach) : 0;
+}
+
+unsigned int FindKnotSpan(const std::vector<double>& knots,
+                          unsigned int spline_degree_, double u) {
+    // the curve is defined over [u_p, u_{n + 1}], where u_{n + 1} belongs to
+    // the last span
+    unsigned int last = static_cast<unsigned int>(knots.size()) -
+                        spline_degree_ - 2;
+    if (u >= knots[last + 1]) return last;
+    if (u <= knots[spline_degree_]) return spline_degree_;
+
+    unsigned int low = spline_degree_, high = last + 1;
+    unsigned int mid = (low + high) / 2;
+    while (u < knots[mid] || u >= knots[mid + 1]) {
+        if (u < knots[mid]) {
+            high = mid;
+        } else {
+            low = mid;
+        }
+        mid = (low + high) / 2;
+    }
+    return mid;
+}
+
+KnotSpanCache::KnotSpanCache(const std::vector<double>& knots,
+                             unsigned int spline_degree_)
+    : knots_(knots), degree_(spline_degree_), span_(spline_degree_) {}
+
+unsigned int KnotSpanCache::Find(double u) {
+    unsigned int last = static_cast<unsigned int>(knots_.size()) - degree_ - 2;
+    if (u >= knots_[span_] && (u < knots_[span_ + 1] || span_ == last))
+        return span_;
+    // samples usually step into the next span
+    if (span_ < last && u >= knots_[span_ + 1] &&
+        (u < knots_[span_ + 2] || span_ + 1 == last))
+        return ++span_;
+    span_ = FindKnotSpan(knots_, degree_, u);
+    return span_;
+}
+
+void BasisFunctions(const std::vector<double>& knots,
+                    unsigned int spline_degree_, unsigned int span, double u,
+                    double* basis) {
+    assert(spline_degree_ <= max_nurbs_degree);
+    double left[max_nurbs_degree + 1];
+    double right[max_nurbs_degree + 1];
+
+    // raises the degree of the non-zero functions one step at a time,
+    // N_{i, j} from N_{i, j - 1} and N_{i + 1, j - 1}
+    basis[0] = 1.0;
+    for (unsigned int j = 1; j <= spline_degree_; j++) {
+        left[j] = u - knots[span + 1 - j];
+        right[j] = knots[span + j] - u;
+        double saved = 0.0;
+        for (unsigned int r = 0; r < j; r++) {
+            double term = basis[r] / (right[r + 1] + left[j - r]);
+            basis[r] = saved + right[r + 1] * term;
+            saved = left[j - r] * term;
+        }
+        basis[j] = saved;
+    }
+}
+
+void BasisFunctionDerivatives(const std::vector<double>& knots,
+                              unsigned int spline_degree_, unsigned int span,
+                              double u, unsigned int order,
+                              double* derivatives) {
+    // Piegl and Tiller's algorithm A2.3
+    assert(spline_degree_ <= max_nurbs_degree);
+    const int p = static_cast<int>(spline_degree_);
+    const int n = std::min(static_cast<int>(order), p);
+    double left[max_nurbs_degree + 1];
+    double right[max_nurbs_degree + 1];
+    // basis functions of every degree in the upper triangle, knot differences
+    // in the lower one
+    double ndu[max_nurbs_degree + 1][max_nurbs_degree + 1];
+    double a[2][max_nurbs_degree + 1];
+    auto derivative = [&](int k, int j) -> double& {
+        return derivatives[k * (p + 1) + j];
+    };
+
+    ndu[0][0] = 1.0;
+    for (int j = 1; j <= p; j++) {
+        left[j] = u - knots[span + 1 - static_cast<unsigned int>(j)];
+        right[j] = knots[span + static_cast<unsigned int>(j)] - u;
+        double saved = 0.0;
+        for (int r = 0; r < j; r++) {
+            ndu[j][r] = right[r + 1] + left[j - r];
+            double term = ndu[r][j - 1] / ndu[j][r];
+            ndu[r][j] = saved + right[r + 1] * term;
+            saved = left[j - r] * term;
+        }
+        ndu[j][j] = saved;
+    }
+    for (int j = 0; j <= p; j++) derivative(0, j) = ndu[j][p];
+
+    // the k-th derivative of N_{span - p + r, p} is a combination of the
+    // degree p - k functions, whose coefficients a are built up order by order
+    for (int r = 0; r <= p; r++) {
+        int s1 = 0, s2 = 1;
+        a[0][0] = 1.0;
+        for (int k = 1; k <= n; k++) {
+            double d = 0.0;
+            int rk = r - k, pk = p - k;
+            if (r >= k) {
+                a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+                d = a[s2][0] * ndu[rk][pk];
+            }
+            int j1 = rk >= -1 ? 1 : -rk;
+            int j2 = r - 1 <= pk ? k - 1 : p - r;
+            for (int j = j1; j <= j2; j++) {
+                a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rk + j];
+                d += a[s2][j] * ndu[rk + j][pk];
+            }
+            if (r <= pk) {
+                a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+                d += a[s2][k] * ndu[r][pk];
+            }
+            derivative(k, r) = d;
+            std::swap(s1, s2);
+        }
+    }
+
+    // scale by p! / (p - k)!
+    double factor = p;
+    for (int k = 1; k <= n; k++) {
+        for (int j = 0; j <= p; j++) derivative(k, j) *= factor;
+        factor *= p - k;
+    }
+    for (int k = n + 1; k <= static_cast<int>(order); k++)
+        for (int j = 0; j <= p; j++) derivative(k, j) = 0.0;
+}
+
+Eigen::Vector2d DeBoor(const std::vector<double>& knots,
+                       const PairVector& control_points,
+                       const std::vector<double>& weights,
+                       unsigned int spline_degree_, unsigned int span,
+                       double u) {
+    assert(spline_degree_ <= max_nurbs_degree);
+    const unsigned int p = spline_degree_;
+
+    // (wx, wy, w) of the p + 1 points the span depends on
+    Eigen::Vector3d points_[max_nurbs_degree + 1];
+    for (unsigned int j = 0; j <= p; j++) {
+        const ControlPoint& point = control_points[span - p + j];
+        double w = weights.empty() ? 1.0 : weights[span - p + j];
+        points_[j] << w * point.first, w * point.second, w;
+    }
+
+    // each level blends neighbouring points, leaving the curve point last
+    for (unsigned int r = 1; r <= p; r++) {
+        for (unsigned int j = p; j >= r; j--) {
+            double u0 = knots[j + span - p];
+            double alpha = (u - u0) / (knots[j + 1 + span - r] - u0);
+            points_[j] = (1.0 - alpha) * points_[j - 1] + alpha * points_[j];
+        }
+    }
+    return points_[p].head<2>() / points_[p](2);
+}
+
+static BasisTable BuildBasisTable(unsigned int spline_degree_,
+                                 unsigned int spline_subdiv_,
+                                 unsigned int derivative) {
+    // every uniform span has the same basis functions, so tabulate the first
+    // span of a single segment, [u_p, u_{p + 1}]
+    std::vector<double> knots = UniformKnots(spline_degree_,
+                                             spline_degree_ + 1);
+    BasisTable table(spline_subdiv_ + 1, spline_degree_ + 1);
+    std::vector<double> derivatives((derivative + 1) * (spline_degree_ + 1));
+    for (unsigned int i = 0; i <= spline_subdiv_; i++) {
+        double u = spline_degree_ + static_cast<double>(i) / spline_subdiv_;
+        if (derivative == 0) {
+            BasisFunctions(knots, spline_degree_, spline_degree_, u,
+                           table.row(i).data());
+        } else {
+            BasisFunctionDerivatives(knots, spline_degree_, spline_degree_, u,
+                                     derivative, derivatives.data());
+            table.row(i) = Eigen::Map<const Eigen::RowVectorXd>(
+                derivatives.data() + derivative * (spline_degree_ + 1),
+                spline_degree_ + 1);
+        }
+    }
+    return table;
+}
+
+const BasisTable& LookupBasisTable(unsigned int spline_degree_,
+                                   unsigned int spline_subdiv_,
+                                   unsigned int derivative) {
+    typedef std::tuple<unsigned int, unsigned int, unsigned int> Key;
+    static std::map<Key, BasisTable> basis_tables;
+    static std::mutex basis_tables_mutex;
+
+    if (spline_degree_ < 1 || spline_degree_ > max_nurbs_degree)
+        throw std::invalid_argument("unsupported NURBS degree");
+    if (derivative > 2)
+        throw std::invalid_argument("Choose from derivatives = {0, 1, 2}");
+
+    const Key key = std::make_tuple(spline_degree_, spline_subdiv_, derivative);
+    {
+        // std::map never moves its elements, so references stay valid
+        std::lock_guard<std::mutex> lock(basis_tables_mutex);
+        auto cached = basis_tables.find(key);
+        if (cached != basis_tables.end()) return cached->second;
+        if (spline_subdiv_ <= max_cached_subdiv &&
+            basis_tables.size() < max_cached_tables)
+            return basis_tables
+                .emplace(key, BuildBasisTable(spline_degree_, spline_subdiv_,
+                                              derivative))
+                .first->second;
+    }
+
+    // kept by this thread, one table for each derivative order, which
+    // ComputeNURBS looks up together
+    thread_local std::optional<Key> scratch_keys[3];
+    thread_local BasisTable scratch_tables[3];
+    if (scratch_keys[derivative] != key) {
+        scratch_tables[derivative] =
+            BuildBasisTable(spline_degree_, spline_subdiv_, derivative);
+        scratch_keys[derivative] = key;
+    }
+    return scratch_tables[derivative];
+}
+
+const double* SegmentWeights(const std::vector<double>& weights,
+                             SplineType spline_type_,
+                             unsigned int spline_degree_, unsigned int k) {
+    if (weights.empty()) return nullptr;
+    return weights.data() + SegmentStart(spline_type_, spline_degree_, k);
+}
+
+// Whether the 2p + 2 knots of a segment are evenly spaced, so that its basis
+// functions over t are those of the uniform table
+static bool EvenKnots(const double* knots, unsigned int spline_degree_) {
+    const double width = knots[1] - knots[0];
+    for (unsigned int i = 2; i <= 2 * spline_degree_ + 1; i++)
+        if (knots[i] - knots[i - 1] != width) return false;
+    return width > 0.0;
+}
+
+// C, C' or C'' of C = A / w from the homogeneous (wx, wy, w) A and its
+// derivatives up to that order, with C' = (A' - w'C) / w and
+// C'' = (A'' - 2w'C' - w''C) / w
+static Eigen::Vector2d RationalDerivative(const Eigen::Vector3d* homogeneous,
+                                          unsigned int derivative) {
+    double w = homogeneous[0](2);
+    Eigen::Vector2d point = homogeneous[0].head<2>() / w;
+    if (derivative == 0) return point;
+    Eigen::Vector2d first =
+        (homogeneous[1].head<2>() - homogeneous[1](2) * point) / w;
+    if (derivative == 1) return first;
+    return (homogeneous[2].head<2>() - 2.0 * homogeneous[1](2) * first -
+            homogeneous[2](2) * point) /
+           w;
+}
+
+// Segments whose knots are unevenly spaced, such as the end segments of a
+// clamped curve, from their basis functions at every sample
+static void ComputeUnevenNURBS(const ControlPoint* control_points,
+                               const double* weights, const double* knots,
+                               unsigned int spline_degree_,
+                               unsigned int spline_subdiv_,
+                               unsigned int derivative,
+                               Eigen::Map<SplineMatrix> spline) {
+    if (derivative > 2)
+        throw std::invalid_argument("Choose from derivatives = {0, 1, 2}");
+    const unsigned int p = spline_degree_;
+    const std::vector<double> segment_knots(knots, knots + 2 * p + 2);
+    const double start = segment_knots[p];
+    const double width = segment_knots[p + 1] - start;
+    if (!(width > 0.0))
+        throw std::invalid_argument("NURBS segment spans an empty knot span");
+    assert(spline.rows() == static_cast<Eigen::Index>(spline_subdiv_) + 1);
+
+    double basis[3 * (max_nurbs_degree + 1)];
+    for (unsigned int i = 0; i <= spline_subdiv_; i++) {
+        double t = static_cast<double>(i) / spline_subdiv_;
+        BasisFunctionDerivatives(segment_knots, p, p, start + t * width,
+                                 derivative, basis);
+        // each derivative with respect to t is width times that in u
+        Eigen::Vector3d homogeneous[3];
+        double scale = 1.0;
+        for (unsigned int k = 0; k <= derivative; k++) {
+            homogeneous[k].setZero();
+            for (unsigned int j = 0; j <= p; j++) {
+                double b = scale * basis[k * (p + 1) + j] *
+                           (weights == nullptr ? 1.0 : weights[j]);
+                homogeneous[k] += b * Eigen::Vector3d(control_points[j].first,
+                                                      control_points[j].second,
+                                                      1.0);
+            }
+            scale *= width;
+        }
+        spline.row(i) = RationalDerivative(homogeneous, derivative).transpose();
+    }
+}
+
+void ComputeNURBS(const ControlPoint* control_points,
+                  const double* weights, const double* knots,
+                  unsigned int spline_degree_, unsigned int spline_subdiv_,
+                  unsigned int derivative, Eigen::Map<SplineMatrix> spline) {
+    if (knots != nullptr && !EvenKnots(knots, spline_degree_)) {
+        ComputeUnevenNURBS(control_points, weights, knots, spline_degree_,
+                           spline_subdiv_, derivative, spline);
+        return;
+    }
+    const BasisTable& table = LookupBasisTable(spline_degree_, spline_subdiv_);
+    assert(spline.rows() == table.rows());
+
+    const Eigen::Index num_basis = table.cols();
+    if (derivative == 0) {
+        for (Eigen::Index i = 0; i < table.rows(); i++) {
+            const double* basis = table.row(i).data();
+            double x = 0.0, y = 0.0;
+            if (weights == nullptr) {
+                for (Eigen::Index j = 0; j < num_basis; j++) {
+                    x += basis[j] * control_points[j].first;
+                    y += basis[j] * control_points[j].second;
+                }
+            } else {
+                // projects the weighted sum back from homogeneous coordinates
+                double w = 0.0;
+                for (Eigen::Index j = 0; j < num_basis; j++) {
+                    double b = basis[j] * weights[j];
+                    x += b * control_points[j].first;
+                    y += b * control_points[j].second;
+                    w += b;
+                }
+                x /= w;
+                y /= w;
+            }
+            spline(i, 0) = x;
+            spline(i, 1) = y;
+        }
+        return;
+    }
+
+    // homogeneous (wx, wy, w) and its derivatives up to the requested order
+    const BasisTable* tables[3] = {&table, nullptr, nullptr};
+    for (unsigned int k = 1; k <= derivative; k++)
+        tables[k] = &LookupBasisTable(spline_degree_, spline_subdiv_, k);
+    for (Eigen::Index i = 0; i < table.rows(); i++) {
+        Eigen::Vector3d homogeneous[3];
+        for (unsigned int k = 0; k <= derivative; k++) {
+            const double* basis = tables[k]->row(i).data();
+            homogeneous[k].setZero();
+            for (Eigen::Index j = 0; j < num_basis; j++) {
+                double b = weights == nullptr ? basis[j]
+                                              : basis[j] * weights[j];
+                homogeneous[k] += b * Eigen::Vector3d(control_points[j].first,
+                                                      control_points[j].second,
+                                                      1.0);
+            }
+        }
+        Eigen::Vector2d result = RationalDerivative(homogeneous, derivative);
+        spline(i, 0) = result(0);
+        spline(i, 1) = result(1);
+    }
+}
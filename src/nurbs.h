@@ -0,0 +1,122 @@
+#ifndef SPLINE_PLOTTER_NURBS_H_
+#define SPLINE_PLOTTER_NURBS_H_
+
+#include <Eigen/Core>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "spline.h"
+
+// NURBS curves of any degree p up to max_nurbs_degree. Segment k spans
+// [u_{k+p}, u_{k+p+1}] and uses points k to k + p, so segments are laid out
+// like BSpline ones, which degree 3 with unit weights and uniform knots
+// reproduces. Spans whose knots are evenly spaced all have the same basis
+// functions, which are tabulated once, the others are evaluated sample by
+// sample
+const unsigned int max_nurbs_degree = 15;
+
+// Knot vectors of a curve over n + 1 points. Uniform knots are u_i = i, so
+// the curve starts and ends away from its end points. Clamped knots repeat
+// the first and last knots p + 1 times, u_i = min(max(i - p, 0), n + 1 - p),
+// so the curve starts at its first point and ends at its last
+enum class KnotVector { Uniform, Clamped };
+
+std::string KnotVectorName(KnotVector knot_vector);
+// Resolves a --knots name, returns false if it is not a known knot vector
+bool ParseKnotVector(std::string name, KnotVector& knot_vector);
+
+// Values of the p + 1 basis functions of a degree p segment, one row per
+// sample of the knot span
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    BasisTable;
+
+// Knots u_0 to u_{n + p} of a degree p curve over num_points_ points
+std::vector<double> UniformKnots(unsigned int spline_degree_,
+                                 unsigned int num_points_);
+std::vector<double> ClampedKnots(unsigned int spline_degree_,
+                                 unsigned int num_points_);
+// Changes knots, those of a curve over any number of points, to those of
+// num_points_ points and returns the index of the first knot that changed.
+// The knots below the smaller number of points are the same for both, so
+// adding or removing a point rewrites only p + 1 or so knots
+size_t ResizeKnots(std::vector<double>& knots, KnotVector knot_vector,
+                   unsigned int spline_degree_, unsigned int num_points_);
+
+// Knots u_k to u_{k + 2p + 1} of segment k of a NURBS curve, as ComputeNURBS
+// and SegmentCurve take them, or nullptr when knots is empty as it is for
+// uniform knots or other spline types
+const double* SegmentKnots(const std::vector<double>& knots,
+                           SplineType spline_type_,
+                           unsigned int spline_degree_, unsigned int k);
+// First segment whose knots include u_index
+unsigned int FirstSegmentWithKnot(unsigned int spline_degree_, size_t index);
+
+// Index i of the knot span [u_i, u_{i + 1}) holding u, clamped to the spans
+// [u_p, u_{n + 1}] the curve is defined over. Binary search over any
+// non-decreasing knots
+unsigned int FindKnotSpan(const std::vector<double>& knots,
+                          unsigned int spline_degree_, double u);
+
+// FindKnotSpan remembering the last span found, so stepping u along the
+// curve finds each span in constant time
+class KnotSpanCache {
+   public:
+    KnotSpanCache(const std::vector<double>& knots,
+                  unsigned int spline_degree_);
+
+    unsigned int Find(double u);
+
+   private:
+    const std::vector<double>& knots_;
+    unsigned int degree_;
+    unsigned int span_;
+};
+
+// Writes the p + 1 basis functions N_{span - p, p}(u) to N_{span, p}(u) that
+// are non-zero on span to basis, with the Cox-de Boor recurrence in O(p^2)
+void BasisFunctions(const std::vector<double>& knots,
+                    unsigned int spline_degree_, unsigned int span, double u,
+                    double* basis);
+
+// Writes the derivatives of orders 0 to order of the same p + 1 basis functions
+// to the rows of derivatives, a row-major (order + 1) x (p + 1) array. Orders
+// above p are 0
+void BasisFunctionDerivatives(const std::vector<double>& knots,
+                              unsigned int spline_degree_, unsigned int span,
+                              double u, unsigned int order,
+                              double* derivatives);
+
+// Point at u of the curve over all of control_points by de Boor's algorithm
+// on homogeneous points, O(p^2). weights is empty when every weight is 1
+Eigen::Vector2d DeBoor(const std::vector<double>& knots,
+                       const PairVector& control_points,
+                       const std::vector<double>& weights,
+                       unsigned int spline_degree_, unsigned int span,
+                       double u);
+
+// Cached basis functions of a uniform segment at spline_subdiv_ steps, or
+// their derivatives, so a segment costs O(p) per sample. Cached and kept like
+// the tables of LookupSampleTable
+const BasisTable& LookupBasisTable(unsigned int spline_degree_,
+                                   unsigned int spline_subdiv_,
+                                   unsigned int derivative = 0);
+
+// Weights of the control points of segment k, nullptr when every weight is 1
+const double* SegmentWeights(const std::vector<double>& weights,
+                             SplineType spline_type_,
+                             unsigned int spline_degree_, unsigned int k);
+
+// Samples a segment from its p + 1 control points and weights, or nullptr for
+// unit weights, into spline, which must have NumSplineSamples rows, at steps
+// of t over its span u = u_{k+p} + t (u_{k+p+1} - u_{k+p}). knots holds the
+// knots of the segment, see SegmentKnots, or is nullptr for uniform knots.
+// Segments whose knots are evenly spaced are sampled from LookupBasisTable,
+// the others with BasisFunctionDerivatives at every sample in O(p^2).
+// Rational derivatives, up to the second, follow from the quotient rule
+void ComputeNURBS(const ControlPoint* control_points,
+                  const double* weights, const double* knots,
+                  unsigned int spline_degree_, unsigned int spline_subdiv_,
+                  unsigned int derivative, Eigen::Map<SplineMatrix> spline);
+
+#endif  // SPLINE_PLOTTER_NURBS_H_
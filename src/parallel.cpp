@@ -0,0 +1,120 @@
+#include "parallel.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int num_threads) {
+    for (unsigned int i = 1; i < num_threads; i++)
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+}
+
+unsigned int ThreadPool::NumThreads() const {
+    return static_cast<unsigned int>(workers_.size()) + 1;
+}
+
+void ThreadPool::RunTasks(const std::function<void(unsigned int)>& task,
+                          unsigned int num_tasks) {
+    for (unsigned int i = next_task_++; i < num_tasks; i = next_task_++)
+        task(i);
+}
+
+void ThreadPool::WorkerLoop() {
+    unsigned long seen_generation = 0;
+    for (;;) {
+        const std::function<void(unsigned int)>* task;
+        unsigned int num_tasks;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [&] {
+                return stopping_ || generation_ != seen_generation;
+            });
+            if (stopping_) return;
+            seen_generation = generation_;
+            task = task_;
+            num_tasks = num_tasks_;
+        }
+
+        RunTasks(*task, num_tasks);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_workers_++;
+        }
+        work_done_.notify_one();
+    }
+}
+
+void ThreadPool::ParallelFor(unsigned int num_tasks,
+                             const std::function<void(unsigned int)>& task) {
+    if (workers_.empty() || num_tasks <= 1) {
+        for (unsigned int i = 0; i < num_tasks; i++) task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        num_tasks_ = num_tasks;
+        next_task_ = 0;
+        finished_workers_ = 0;
+        generation_++;
+    }
+    work_ready_.notify_all();
+
+    RunTasks(task, num_tasks);
+
+    // every worker checks in once per generation, so none can still be
+    // reading task_ or next_task_ when the next ParallelFor starts
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [&] { return finished_workers_ == workers_.size(); });
+}
+
+template <typename Scalar>
+void ComputeSplinesParallel(ThreadPool& pool, PairVector& coordinates,
+                            SplineType spline_type_,
+                            unsigned int spline_degree_,
+                            unsigned int spline_subdiv_,
+                            unsigned int first_segment,
+                            unsigned int num_segments_, BatchKernel kernel,
+                            Scalar* samples_out,
+                            const std::vector<double>& weights,
+                            const std::vector<Eigen::Vector2d>& tangents,
+                            const std::vector<double>& knots) {
+    // a few chunks per thread to even out the load, but large enough that the
+    // batch kernels work on full registers
+    const unsigned int min_chunk = 256;
+    unsigned int chunk =
+        std::max(min_chunk, num_segments_ / (4 * pool.NumThreads()) + 1);
+    unsigned int num_chunks = (num_segments_ + chunk - 1) / chunk;
+    const size_t num_samples = NumSplineSamples(spline_type_, spline_subdiv_);
+
+    pool.ParallelFor(num_chunks, [&](unsigned int c) {
+        unsigned int begin = c * chunk;
+        unsigned int count = std::min(chunk, num_segments_ - begin);
+        ComputeSplines(coordinates, spline_type_, spline_degree_,
+                       spline_subdiv_, first_segment + begin, count, kernel,
+                       samples_out + 2 * num_samples * begin, weights,
+                       tangents, knots);
+    });
+}
+
+template void ComputeSplinesParallel(ThreadPool&, PairVector&, SplineType,
+                                     unsigned int, unsigned int, unsigned int,
+                                     unsigned int, BatchKernel, double*,
+                                     const std::vector<double>&,
+                                     const std::vector<Eigen::Vector2d>&,
+                                     const std::vector<double>&);
+template void ComputeSplinesParallel(ThreadPool&, PairVector&, SplineType,
+                                     unsigned int, unsigned int, unsigned int,
+                                     unsigned int, BatchKernel, float*,
+                                     const std::vector<double>&,
+                                     const std::vector<Eigen::Vector2d>&,
+                                     const std::vector<double>&);
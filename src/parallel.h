@@ -0,0 +1,61 @@
+#ifndef SPLINE_PLOTTER_PARALLEL_H_
+#define SPLINE_PLOTTER_PARALLEL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "spline.h"
+
+// Fixed set of worker threads that run the tasks of one ParallelFor at a time
+class ThreadPool {
+   public:
+    // num_threads counts the calling thread, so num_threads - 1 are spawned
+    explicit ThreadPool(unsigned int num_threads);
+    ~ThreadPool();
+
+    unsigned int NumThreads() const;
+
+    // Runs task(0) to task(num_tasks - 1) on the workers and the calling
+    // thread, returning once all of them have finished
+    void ParallelFor(unsigned int num_tasks,
+                     const std::function<void(unsigned int)>& task);
+
+   private:
+    void WorkerLoop();
+    void RunTasks(const std::function<void(unsigned int)>& task,
+                  unsigned int num_tasks);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+
+    const std::function<void(unsigned int)>* task_ = nullptr;
+    unsigned int num_tasks_ = 0;
+    std::atomic<unsigned int> next_task_{0};
+    unsigned long generation_ = 0;
+    unsigned int finished_workers_ = 0;
+    bool stopping_ = false;
+};
+
+// ComputeSplines split into chunks of segments across the pool. Every segment
+// is written to its own range of samples_out, so the result is identical to
+// the serial one whatever the number of threads
+template <typename Scalar>
+void ComputeSplinesParallel(ThreadPool& pool, PairVector& coordinates,
+                            SplineType spline_type_,
+                            unsigned int spline_degree_,
+                            unsigned int spline_subdiv_,
+                            unsigned int first_segment,
+                            unsigned int num_segments_, BatchKernel kernel,
+                            Scalar* samples_out,
+                            const std::vector<double>& weights = {},
+                            const std::vector<Eigen::Vector2d>& tangents = {},
+                            const std::vector<double>& knots = {});
+
+#endif  // SPLINE_PLOTTER_PARALLEL_H_
@@ -0,0 +1,218 @@
+#define GL_GLEXT_PROTOTYPES
+#include "renderer.h"
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "lod.h"
+#include "scene.h"
+
+struct VertexBuffer {
+    GLuint id = 0;
+    GLsizeiptr capacity = 0;  // bytes
+};
+
+static VertexBuffer spline_buffer;
+static VertexBuffer point_buffer;
+
+// layout of the segments in spline_buffer, passed straight to
+// glMultiDrawArrays
+static std::vector<GLint> spline_firsts;
+static std::vector<GLsizei> spline_counts;
+static GLsizei num_point_vertices = 0;
+
+static std::vector<GLfloat> staging;
+
+static LodPyramid lod;
+// reused every frame: visible chunks, the segments of them drawn from the
+// buffer, and the strips drawn from a coarser level
+static std::vector<unsigned int> visible_chunks;
+static std::vector<GLint> visible_firsts;
+static std::vector<GLsizei> visible_counts;
+static LodStrips visible_strips;
+
+static bool Reserve(VertexBuffer& buffer, GLsizeiptr bytes) {
+    // grows geometrically, returns true if the contents were discarded
+    if (bytes <= buffer.capacity) return false;
+    buffer.capacity = std::max(bytes, 2 * buffer.capacity);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.id);
+    glBufferData(GL_ARRAY_BUFFER, buffer.capacity, nullptr, GL_DYNAMIC_DRAW);
+    return true;
+}
+
+static void UploadSplines(unsigned int first, unsigned int last) {
+    // segments [first, last) are contiguous from vertex spline_firsts[first]
+    if (first >= last) return;
+    // the segments are one span of the arena, converted to floats
+    const double* begin = splines.Data() + 2 * splines.SegmentOffset(first);
+    const double* end = splines.Data() + 2 * splines.SegmentOffset(last);
+    staging.resize(static_cast<size_t>(end - begin));
+    std::transform(begin, end, staging.begin(),
+                   [](double value) { return static_cast<GLfloat>(value); });
+    glBindBuffer(GL_ARRAY_BUFFER, spline_buffer.id);
+    glBufferSubData(
+        GL_ARRAY_BUFFER,
+        static_cast<GLintptr>(2 * sizeof(GLfloat)) * spline_firsts[first],
+        static_cast<GLsizeiptr>(staging.size() * sizeof(GLfloat)),
+        staging.data());
+}
+
+static void SyncSplines() {
+    unsigned int num_cached = std::min(
+        static_cast<unsigned int>(spline_counts.size()), num_splines);
+    spline_firsts.resize(num_cached);
+    spline_counts.resize(num_cached);
+
+    // rewrite changed segments in place while their length is unchanged
+    unsigned int begin = num_cached, end = num_cached;
+    if (!dirty_splines.Empty()) {
+        begin = std::min(dirty_splines.begin, num_cached);
+        end = std::min(dirty_splines.end, num_cached);
+    }
+    unsigned int k = begin;
+    while (k < end && splines.SegmentSamples(k) == spline_counts[k]) k++;
+    UploadSplines(begin, k);
+
+    // from the first resized or appended segment on, lay out and upload again
+    unsigned int relayout = k < end ? k : num_cached;
+    if (relayout < num_splines) {
+        spline_firsts.resize(num_splines);
+        spline_counts.resize(num_splines);
+        for (unsigned int j = relayout; j < num_splines; j++) {
+            spline_firsts[j] = static_cast<GLint>(splines.SegmentOffset(j));
+            spline_counts[j] = static_cast<GLsizei>(splines.SegmentSamples(j));
+        }
+        GLsizeiptr num_vertices = spline_firsts.back() + spline_counts.back();
+        GLsizeiptr vertex_size = static_cast<GLsizeiptr>(2 * sizeof(GLfloat));
+        if (Reserve(spline_buffer, num_vertices * vertex_size)) relayout = 0;
+        UploadSplines(relayout, num_splines);
+    }
+    if (dirty_splines.Empty()) {
+        lod.Update(splines, num_splines, num_splines);
+    } else {
+        lod.Update(splines, dirty_splines.begin, dirty_splines.end);
+    }
+    dirty_splines.Clear();
+}
+
+static void SyncPoints() {
+    GLsizei num_cached = std::min(num_point_vertices,
+                                  static_cast<GLsizei>(num_points));
+    GLsizei begin = num_cached;
+    if (!dirty_points.Empty())
+        begin = std::min(static_cast<GLsizei>(dirty_points.begin), begin);
+    num_point_vertices = static_cast<GLsizei>(num_points);
+
+    if (Reserve(point_buffer,
+                num_point_vertices *
+                    static_cast<GLsizeiptr>(2 * sizeof(GLfloat))))
+        begin = 0;
+    if (begin < num_point_vertices) {
+        staging.clear();
+        for (GLsizei i = begin; i < num_point_vertices; i++) {
+            const ControlPoint& point =
+                points[static_cast<size_t>(i)];
+            staging.push_back(static_cast<GLfloat>(point.first));
+            staging.push_back(static_cast<GLfloat>(point.second));
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, point_buffer.id);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        static_cast<GLintptr>(2 * sizeof(GLfloat)) * begin,
+                        static_cast<GLsizeiptr>(staging.size() *
+                                                sizeof(GLfloat)),
+                        staging.data());
+    }
+    dirty_points.Clear();
+}
+
+void InitRenderBuffers() {
+    glGenBuffers(1, &spline_buffer.id);
+    glGenBuffers(1, &point_buffer.id);
+}
+
+void SyncRenderBuffers() {
+    SyncSplines();
+    SyncPoints();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+BoundingBox SplineBounds() {
+    const double inf = std::numeric_limits<double>::infinity();
+    BoundingBox bounds{inf, inf, -inf, -inf};
+    for (unsigned int c = 0; c < lod.NumChunks(); c++) {
+        const BoundingBox& chunk = lod.Chunk(c).bounds;
+        bounds.min_x = std::min(bounds.min_x, chunk.min_x);
+        bounds.min_y = std::min(bounds.min_y, chunk.min_y);
+        bounds.max_x = std::max(bounds.max_x, chunk.max_x);
+        bounds.max_y = std::max(bounds.max_y, chunk.max_y);
+    }
+    return bounds;
+}
+
+unsigned int DrawSplines(const Viewport& view) {
+    if (spline_counts.empty()) return 0;
+    visible_chunks.clear();
+    lod.VisibleChunks(view.Visible(), visible_chunks);
+    if (visible_chunks.empty()) return 0;
+    glColor3f(1.0f, 0.0f, 0.0f);
+    glLineWidth(2.5f);
+    glEnable(GL_LINE_SMOOTH);
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    unsigned int vertices = 0;
+    unsigned int level = LodPyramid::ChooseLevel(view.PixelSize());
+    if (level == 0) {
+        visible_firsts.clear();
+        visible_counts.clear();
+        for (unsigned int c : visible_chunks) {
+            unsigned int first = c * lod_chunk_segments;
+            unsigned int last = std::min(first + lod_chunk_segments,
+                                         num_splines);
+            visible_firsts.insert(visible_firsts.end(),
+                                  spline_firsts.begin() + first,
+                                  spline_firsts.begin() + last);
+            visible_counts.insert(visible_counts.end(),
+                                  spline_counts.begin() + first,
+                                  spline_counts.begin() + last);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, spline_buffer.id);
+        glVertexPointer(2, GL_FLOAT, 0, nullptr);
+        glMultiDrawArrays(GL_LINE_STRIP, visible_firsts.data(),
+                          visible_counts.data(),
+                          static_cast<GLsizei>(visible_counts.size()));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (GLsizei count : visible_counts)
+            vertices += static_cast<unsigned int>(count);
+    } else {
+        // few enough vertices to send from client memory every frame
+        visible_strips.Clear();
+        lod.Gather(visible_chunks, level, visible_strips);
+        glVertexPointer(2, GL_FLOAT, 0, visible_strips.vertices.data());
+        glMultiDrawArrays(GL_LINE_STRIP, visible_strips.firsts.data(),
+                          visible_strips.counts.data(),
+                          static_cast<GLsizei>(visible_strips.counts.size()));
+        vertices = static_cast<unsigned int>(visible_strips.NumVertices());
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    return vertices;
+}
+
+unsigned int DrawPoints() {
+    if (num_point_vertices == 0) return 0;
+    glPointSize(7);
+    glColor3f(0.0f, 0.0f, 0.0f);
+    glEnable(GL_POINT_SMOOTH);
+    glEnable(GL_BLEND);
+
+    glBindBuffer(GL_ARRAY_BUFFER, point_buffer.id);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, nullptr);
+    glDrawArrays(GL_POINTS, 0, num_point_vertices);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return static_cast<unsigned int>(num_point_vertices);
+}
@@ -0,0 +1,26 @@
+#ifndef SPLINE_PLOTTER_RENDERER_H_
+#define SPLINE_PLOTTER_RENDERER_H_
+
+// Control points and spline samples are kept in persistent vertex buffers.
+// Each frame SyncRenderBuffers uploads only what the scene marked dirty, then
+// DrawSplines and DrawPoints each submit the whole scene in one call. Uses
+// GL 1.5 buffer objects with fixed-function vertex arrays, which software GL
+// (llvmpipe, OSMesa) supports.
+//
+// A LodPyramid of the samples is kept up to date alongside the buffers.
+// Splines are culled by chunk against the view, then drawn from the buffer
+// when zoomed in far enough for the samples to matter, otherwise from the
+// coarsest level that stays within lod_pixel_error px of them
+
+#include "spatial.h"
+#include "viewport.h"
+
+void InitRenderBuffers();
+void SyncRenderBuffers();
+// Box holding every spline sample, empty when there are none
+BoundingBox SplineBounds();
+// Returns the number of vertices submitted
+unsigned int DrawSplines(const Viewport& view);
+unsigned int DrawPoints();
+
+#endif  // SPLINE_PLOTTER_RENDERER_H_
@@ -0,0 +1,534 @@
+#include "scene.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include "adaptive.h"
+#include "arclength.h"
+#include "fit.h"
+#include "intersect.h"
+#include "nurbs.h"
+#include "parallel.h"
+#include "trace.h"
+
+unsigned int spline_degree = 3;  // p
+unsigned int spline_subdiv = 150;
+SplineType spline_type = SplineType::Hermite;
+unsigned int num_control_points = spline_degree + 1;
+BatchKernel batch_kernel = BatchKernel::Reference;
+unsigned int num_threads = 1;
+double spline_tolerance = 0.0;
+double spline_spacing = 0.0;
+KnotVector spline_knots = KnotVector::Uniform;
+bool log_points = true;
+
+unsigned int GCont = 0;
+unsigned int CCont = 0;
+
+PairVector points;
+std::vector<double> weights;
+std::vector<double> knots;
+SampleArena splines;
+std::vector<PairVector> hulls;
+SpatialGrid point_index;
+SpatialGrid segment_index;
+CubicInterpolant interpolant;
+CurveArcLength curve_length;
+
+unsigned int num_points = 0;
+unsigned int num_splines = 0;
+
+DirtyRange dirty_points;
+DirtyRange dirty_splines;
+
+static ThreadPool& ScenePool() {
+    // workers are spawned on first use and kept for later calls
+    static std::unique_ptr<ThreadPool> thread_pool;
+    if (!thread_pool || thread_pool->NumThreads() != num_threads)
+        thread_pool = std::make_unique<ThreadPool>(num_threads);
+    return *thread_pool;
+}
+
+static void IndexSegment(unsigned int k, const PairVector& control_points) {
+    segment_index.Insert(
+        k, SegmentBounds(control_points, spline_type, spline_degree));
+}
+
+static void TraceSceneSize() {
+    TraceCounter("points", num_points);
+    TraceCounter("segments", num_splines);
+}
+
+static SplineMatrix ComputeSegment(PairVector& control_points,
+                                   SplineType spline_type_,
+                                   const double* control_weights,
+                                   const double* control_knots) {
+    if (spline_tolerance > 0.0)
+        return ComputeSplineAdaptive(control_points, spline_type_,
+                                     spline_degree, spline_tolerance);
+    if (control_weights != nullptr || control_knots != nullptr) {
+        SplineMatrix spline(NumSplineSamples(spline_type_, spline_subdiv), 2);
+        ComputeNURBS(
+            control_points.data(), control_weights, control_knots,
+            spline_degree, spline_subdiv, 0,
+            Eigen::Map<SplineMatrix>(spline.data(), spline.rows(), 2));
+        return spline;
+    }
+    return ComputeSpline(control_points, spline_type_, spline_degree,
+                         spline_subdiv, 0);
+}
+
+static SplineMatrix ComputeInterpolatedSegment(
+    const PairVector& coordinates,
+    const std::vector<Eigen::Vector2d>& tangents_, unsigned int k) {
+    if (spline_tolerance > 0.0)
+        return ComputeSplineAdaptive(
+            InterpolatedBezier(coordinates, tangents_, k), spline_tolerance);
+    return LookupSampleTable(SplineType::Interpolating, spline_subdiv, 0) *
+           InterpolatedGeometry(coordinates, tangents_, k);
+}
+
+// Rebuilds the arc length tables of segments [first, last) and drops those of
+// removed segments, then resamples every segment, as the step is set by the
+// length of the whole curve and any change to it moves every sample
+static void RespaceSegments(unsigned int first, unsigned int last) {
+    last = std::min(last, num_splines);
+    curve_length.Truncate(num_splines);
+    {
+        ScopedTrace trace("arc length");
+        std::vector<std::optional<ArcLengthTable>> built(
+            first < last ? last - first : 0);
+        ScenePool().ParallelFor(
+            static_cast<unsigned int>(built.size()), [&](unsigned int i) {
+                unsigned int k = first + i;
+                built[i].emplace(
+                    spline_type == SplineType::Interpolating
+                        ? SegmentCurve(InterpolatedCoefficients(
+                              points, interpolant.Tangents(), k))
+                        : SegmentCurve(
+                              SegmentControlPoints(points, spline_type,
+                                                   spline_degree, k),
+                              SegmentWeights(weights, spline_type,
+                                             spline_degree, k),
+                              SegmentKnots(knots, spline_type, spline_degree,
+                                           k),
+                              spline_type, spline_degree));
+            });
+        std::vector<ArcLengthTable> tables;
+        tables.reserve(built.size());
+        for (std::optional<ArcLengthTable>& table : built)
+            tables.push_back(std::move(*table));
+        curve_length.Replace(first, std::move(tables));
+    }
+
+    ScopedTrace trace("compute spline");
+    const double step = curve_length.Step(spline_spacing);
+    std::vector<SplineMatrix> resampled(num_splines);
+    ScenePool().ParallelFor(num_splines, [&](unsigned int k) {
+        resampled[k] = curve_length.ResampleSegment(k, step);
+    });
+    splines.Clear();
+    for (const SplineMatrix& spline : resampled) splines.Append(spline);
+    dirty_splines.Mark(0, num_splines);
+}
+
+// Re-solves the tangents after points [first, last) moved, or points were
+// appended or removed from first on, and recomputes every segment whose shape
+// changed. Hulls are those of the Bezier points
+static void UpdateInterpolation(unsigned int first, unsigned int last) {
+    std::vector<std::pair<unsigned int, unsigned int>> changed;
+    {
+        ScopedTrace trace("solve tangents");
+        changed = interpolant.Update(points, first, last);
+    }
+    const std::vector<Eigen::Vector2d>& tangents = interpolant.Tangents();
+    const unsigned int kept = std::min(num_splines, interpolant.NumSegments());
+    for (unsigned int k = kept; k < num_splines; k++) segment_index.Remove(k);
+    splines.Truncate(kept);
+    num_splines = interpolant.NumSegments();
+    hulls.resize(num_splines);
+
+    if (spline_spacing > 0.0) {
+        unsigned int first_changed = kept;
+        for (auto [begin, end] : changed)
+            first_changed = std::min(first_changed, begin);
+        RespaceSegments(first_changed, num_splines);
+    } else {
+        ScopedTrace compute_trace("compute spline");
+        for (auto [begin, end] : changed)
+            for (unsigned int k = begin; k < std::min(end, kept); k++)
+                splines.Replace(
+                    k, ComputeInterpolatedSegment(points, tangents, k));
+        EvaluateSegments(points, weights, {}, tangents, kept,
+                         num_splines - kept, splines);
+    }
+    ScopedTrace hull_trace("hull");
+    for (auto [begin, end] : changed) {
+        for (unsigned int k = begin; k < end; k++) {
+            BezierMatrix bezier = InterpolatedBezier(points, tangents, k);
+            PairVector corners;
+            for (Eigen::Index i = 0; i < 4; i++)
+                corners.emplace_back(bezier(i, 0), bezier(i, 1));
+            hulls[k] = SortConvex(corners);
+            segment_index.Insert(k, BezierBounds(bezier));
+        }
+        dirty_splines.Mark(begin, end);
+    }
+}
+
+// Clamped knots end at the last point, so adding or removing points moves
+// the last knots. Updates knots to num_points and returns the first segment
+// whose knots changed, or num_splines if none did
+static unsigned int UpdateKnots() {
+    if (spline_knots != KnotVector::Clamped) return num_splines;
+    size_t changed =
+        ResizeKnots(knots, spline_knots, spline_degree, num_points);
+    return std::min(FirstSegmentWithKnot(spline_degree, changed), num_splines);
+}
+
+// Resamples segments [first, last) whose control points stayed, but whose
+// knots moved
+static void ResampleSegments(unsigned int first, unsigned int last) {
+    if (spline_spacing > 0.0 || first >= last) return;
+    ScopedTrace trace("compute spline");
+    for (unsigned int k = first; k < last; k++) {
+        PairVector control_points =
+            SegmentControlPoints(points, spline_type, spline_degree, k);
+        splines.Replace(
+            k, ComputeSegment(
+                   control_points, spline_type,
+                   SegmentWeights(weights, spline_type, spline_degree, k),
+                   SegmentKnots(knots, spline_type, spline_degree, k)));
+    }
+}
+
+void GroupPoints(SplineType spline_type_) {
+    unsigned int reknotted = UpdateKnots();
+    if (ReturnPointIndex(spline_type_, spline_degree, num_points) == 0 &&
+        num_points >= num_control_points) {
+        PairVector control_points = ReturnLastN(points, num_control_points);
+        if (spline_spacing == 0.0) {
+            ScopedTrace trace("compute spline");
+            splines.Append(ComputeSegment(
+                control_points, spline_type_,
+                SegmentWeights(weights, spline_type_, spline_degree,
+                               num_splines),
+                SegmentKnots(knots, spline_type_, spline_degree,
+                             num_splines)));
+        }
+        {
+            ScopedTrace trace("hull");
+            hulls.push_back(SortConvex(control_points));
+            IndexSegment(num_splines, control_points);
+        }
+        num_splines++;
+        ResampleSegments(reknotted, num_splines - 1);
+        dirty_splines.Mark(reknotted, num_splines);
+        if (spline_spacing > 0.0) RespaceSegments(reknotted, num_splines);
+    }
+}
+
+void InsertPoint(double x, double y) {
+    ScopedTrace trace("insert point");
+    points.push_back(std::pair(x, y));
+    if (!weights.empty()) weights.push_back(1.0);
+    num_points = static_cast<unsigned int>(points.size());
+    if (log_points)
+        std::cout << "Insert Point " << num_points << "\t\t"
+                  << "(" << x << ", " << y << ")" << std::endl;
+    bool adjusted;
+    {
+        ScopedTrace continuity_trace("enforce continuity");
+        adjusted = EnforceContinuity(points, spline_type, spline_degree,
+                                     num_points, GCont, CCont);
+    }
+    if (adjusted && log_points)
+        std::cout << "Adjust Point " << num_points << "\t\t"
+                  << "(" << points.back().first << ", "
+                  << points.back().second << ")" << std::endl;
+    point_index.Insert(num_points - 1, PointBounds(points.back()));
+    dirty_points.Mark(num_points - 1, num_points);
+    if (spline_type == SplineType::Interpolating) {
+        UpdateInterpolation(num_points - 1, num_points);
+    } else {
+        GroupPoints(spline_type);
+    }
+    TraceSceneSize();
+}
+
+void EvaluateSegments(PairVector& coordinates,
+                      const std::vector<double>& weights_,
+                      const std::vector<double>& knots_,
+                      const std::vector<Eigen::Vector2d>& tangents_,
+                      unsigned int first_segment, unsigned int num_segments_,
+                      SampleArena& splines_out) {
+    ThreadPool& thread_pool = ScenePool();
+    if (spline_tolerance > 0.0) {
+        // segment lengths vary, so hand them out one at a time and append
+        // them once they are all known
+        std::vector<SplineMatrix> adaptive(num_segments_);
+        auto compute_segment = [&](unsigned int k) {
+            if (spline_type == SplineType::Interpolating) {
+                adaptive[k] = ComputeInterpolatedSegment(
+                    coordinates, tangents_, first_segment + k);
+                return;
+            }
+            PairVector control_points = SegmentControlPoints(
+                coordinates, spline_type, spline_degree, first_segment + k);
+            adaptive[k] = ComputeSegment(
+                control_points, spline_type,
+                SegmentWeights(weights_, spline_type, spline_degree,
+                               first_segment + k),
+                SegmentKnots(knots_, spline_type, spline_degree,
+                             first_segment + k));
+        };
+        thread_pool.ParallelFor(num_segments_, compute_segment);
+        for (const SplineMatrix& spline : adaptive) splines_out.Append(spline);
+    } else {
+        double* samples_out = splines_out.AppendUniform(
+            num_segments_, NumSplineSamples(spline_type, spline_subdiv));
+        ComputeSplinesParallel(thread_pool, coordinates, spline_type,
+                               spline_degree, spline_subdiv, first_segment,
+                               num_segments_, batch_kernel, samples_out,
+                               weights_, tangents_, knots_);
+    }
+}
+
+void InsertPoints(const PairVector& new_points,
+                  const std::vector<double>& new_weights) {
+    ScopedTrace trace("insert points");
+    unsigned int first_point = num_points;
+    if (!new_weights.empty() || !weights.empty()) {
+        // earlier points were inserted with unit weights
+        weights.resize(first_point, 1.0);
+        if (new_weights.empty()) {
+            weights.resize(first_point + new_points.size(), 1.0);
+        } else {
+            weights.insert(weights.end(), new_weights.begin(),
+                           new_weights.end());
+        }
+    }
+    {
+        ScopedTrace continuity_trace("enforce continuity");
+        for (auto point : new_points) {
+            points.push_back(point);
+            num_points = static_cast<unsigned int>(points.size());
+            EnforceContinuity(points, spline_type, spline_degree, num_points,
+                              GCont, CCont);
+            point_index.Insert(num_points - 1, PointBounds(points.back()));
+        }
+    }
+    dirty_points.Mark(first_point, num_points);
+
+    if (spline_type == SplineType::Interpolating) {
+        UpdateInterpolation(first_point, num_points);
+        TraceSceneSize();
+        if (log_points)
+            std::cout << "Insert Points " << first_point + 1 << " to "
+                      << num_points << std::endl;
+        return;
+    }
+    unsigned int first_segment = num_splines;
+    unsigned int reknotted = UpdateKnots();
+    num_splines = NumSegments(spline_type, spline_degree, num_points);
+    hulls.resize(num_splines);
+    {
+        ScopedTrace hull_trace("hull");
+        for (unsigned int k = first_segment; k < num_splines; k++) {
+            PairVector control_points =
+                SegmentControlPoints(points, spline_type, spline_degree, k);
+            hulls[k] = SortConvex(control_points);
+            IndexSegment(k, control_points);
+        }
+    }
+    if (spline_spacing > 0.0) {
+        RespaceSegments(reknotted, num_splines);
+    } else {
+        ScopedTrace compute_trace("compute spline");
+        EvaluateSegments(points, weights, knots, {}, first_segment,
+                         num_splines - first_segment, splines);
+    }
+    ResampleSegments(reknotted, first_segment);
+    dirty_splines.Mark(reknotted, num_splines);
+    TraceSceneSize();
+    if (log_points)
+        std::cout << "Insert Points " << first_point + 1 << " to "
+                  << num_points << std::endl;
+}
+
+void InsertFittedPoints(const PairVector& samples) {
+    FitReport report;
+    PairVector fitted;
+    auto start = std::chrono::steady_clock::now();
+    {
+        ScopedTrace trace("fit");
+        fitted = FitControlPoints(samples, spline_type, fit_tolerance, &report);
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format(
+                     "Fitted {} samples with {} control points ({} spans, "
+                     "max error {:.3g} px) in {:.1f} ms",
+                     samples.size(), fitted.size(), report.num_spans,
+                     report.max_error, elapsed.count())
+              << std::endl;
+    InsertPoints(fitted);
+}
+
+int FindPoint(double x, double y, double radius) {
+    return NearestPoint(point_index, points, x, y, radius);
+}
+
+int FindSegment(double x, double y, double radius) {
+    return ClosestPointOnCurve(segment_index, points, weights, knots,
+                               interpolant.Tangents(), spline_type,
+                               spline_degree, x, y, radius)
+        .segment;
+}
+
+CurvePoint ClosestPoint(double x, double y) {
+    return ClosestPointOnCurve(segment_index, points, weights, knots,
+                               interpolant.Tangents(), spline_type,
+                               spline_degree, x, y);
+}
+
+std::vector<Intersection> FindCurveIntersections() {
+    if (spline_type == SplineType::NURBS)
+        throw std::invalid_argument("intersections need a cubic spline type");
+    std::vector<BezierMatrix> segments;
+    segments.reserve(num_splines);
+    for (unsigned int k = 0; k < num_splines; k++)
+        segments.push_back(
+            spline_type == SplineType::Interpolating
+                ? InterpolatedBezier(points, interpolant.Tangents(), k)
+                : ComputeBezierPoints(SegmentControlPoints(points, spline_type,
+                                                           spline_degree, k),
+                                      spline_type));
+
+    // Bezier forms run over [ParamStart, 1] of their segments
+    std::vector<Intersection> intersections = FindIntersections(segments);
+    const double start = ParamStart(spline_type);
+    for (Intersection& crossing : intersections) {
+        crossing.first_t = start + crossing.first_t * (1.0 - start);
+        crossing.second_t = start + crossing.second_t * (1.0 - start);
+    }
+    return intersections;
+}
+
+void MovePoint(unsigned int index, double x, double y) {
+    if (index >= num_points) return;
+    ScopedTrace trace("move point");
+    points[index] = std::make_pair(x, y);
+    point_index.Insert(index, PointBounds(points[index]));
+    dirty_points.Mark(index, index + 1);
+    if (spline_type == SplineType::Interpolating) {
+        UpdateInterpolation(index, index + 1);
+        return;
+    }
+
+    // EnforceContinuity adjusts the second point of a segment from the two
+    // before it, so re-apply it to any such point at index, index + 1 or
+    // index + 2 and recompute the segments around every point that moved
+    auto dirty =
+        SegmentsWithPoint(spline_type, spline_degree, num_points, index);
+    for (unsigned int m = index; m < std::min(index + 3, num_points); m++) {
+        ControlPoint before = points[m];
+        {
+            ScopedTrace continuity_trace("enforce continuity");
+            EnforceContinuity(points, spline_type, spline_degree, m + 1, GCont,
+                              CCont);
+        }
+        if (points[m] != before) {
+            point_index.Insert(m, PointBounds(points[m]));
+            dirty_points.Mark(m, m + 1);
+            auto moved = SegmentsWithPoint(spline_type, spline_degree,
+                                           num_points, m);
+            dirty.first = std::min(dirty.first, moved.first);
+            dirty.second = std::max(dirty.second, moved.second);
+        }
+    }
+
+    for (unsigned int k = dirty.first; k < dirty.second; k++) {
+        PairVector control_points =
+            SegmentControlPoints(points, spline_type, spline_degree, k);
+        if (spline_spacing == 0.0) {
+            ScopedTrace compute_trace("compute spline");
+            splines.Replace(
+                k, ComputeSegment(
+                       control_points, spline_type,
+                       SegmentWeights(weights, spline_type, spline_degree, k),
+                       SegmentKnots(knots, spline_type, spline_degree, k)));
+        }
+        ScopedTrace hull_trace("hull");
+        hulls[k] = SortConvex(control_points);
+        IndexSegment(k, control_points);
+    }
+    dirty_splines.Mark(dirty.first, dirty.second);
+    if (spline_spacing > 0.0) RespaceSegments(dirty.first, dirty.second);
+}
+
+void RemoveAllPoints() {
+    ScopedTrace trace("remove all points");
+    if (log_points) std::cout << "Remove all inserted points" << std::endl;
+    points.clear();
+    weights.clear();
+    knots.clear();
+    splines.Clear();
+    hulls.clear();
+    point_index.Clear();
+    segment_index.Clear();
+    interpolant.Clear();
+    curve_length.Truncate(0);
+    num_points = 0;
+    num_splines = 0;
+    TraceSceneSize();
+}
+
+void RemovePrevPoint() {
+    ScopedTrace trace("remove point");
+    if (num_points > 0) {
+        if (log_points)
+            std::cout << "Remove Point " << num_points << std::endl;
+        points.pop_back();
+        if (!weights.empty()) weights.pop_back();
+        num_points--;
+        point_index.Remove(num_points);
+        if (spline_type == SplineType::Interpolating) {
+            UpdateInterpolation(num_points, num_points);
+        } else if (IsSegmentedSpline(spline_type)) {
+            if (num_points == num_control_points - 1 ||
+                ((num_points - num_control_points) % spline_degree ==
+                     (spline_degree - 1) &&
+                 num_points >= num_control_points)) {
+                num_splines--;
+                splines.Truncate(num_splines);
+                hulls.pop_back();
+                segment_index.Remove(num_splines);
+            }
+        } else {
+            if (num_points >= num_control_points - 1) {
+                num_splines--;
+                splines.Truncate(num_splines);
+                hulls.pop_back();
+                segment_index.Remove(num_splines);
+            }
+        }
+        unsigned int reknotted = UpdateKnots();
+        ResampleSegments(reknotted, num_splines);
+        dirty_splines.Mark(reknotted, num_splines);
+        if (spline_spacing > 0.0 &&
+            (curve_length.NumSegments() > num_splines ||
+             reknotted < num_splines))
+            RespaceSegments(reknotted, num_splines);
+        TraceSceneSize();
+    } else {
+        std::cout << "Cannot remove points as num_points = 0" << std::endl;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef SPLINE_PLOTTER_SCENE_H_
+#define SPLINE_PLOTTER_SCENE_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arclength.h"
+#include "arena.h"
+#include "batch.h"
+#include "interpolate.h"
+#include "intersect.h"
+#include "nurbs.h"
+#include "spatial.h"
+#include "spline.h"
+
+// spline settings, set once from the command line
+extern unsigned int spline_degree;  // p
+extern unsigned int spline_subdiv;
+extern SplineType spline_type;
+extern unsigned int num_control_points;
+extern BatchKernel batch_kernel;
+extern unsigned int num_threads;
+extern double spline_tolerance;  // px, 0 samples at fixed spline_subdiv
+// px at most between samples equally spaced along the whole curve, or 0
+extern double spline_spacing;
+extern KnotVector spline_knots;  // of NURBS curves
+
+extern bool log_points;  // per-point console messages, off with --quiet
+
+extern unsigned int GCont;
+extern unsigned int CCont;
+
+// inserted control points and the spline segments computed from them, with
+// the convex hull of each segment's control points. weights holds the NURBS
+// weight of every point, or is empty while every weight is 1, and knots the
+// knots of a NURBS curve through points, or is empty while they are uniform
+extern PairVector points;
+extern std::vector<double> weights;
+extern std::vector<double> knots;
+extern SampleArena splines;
+extern std::vector<PairVector> hulls;
+// points and segments by bounding box, kept in step with every edit
+extern SpatialGrid point_index;
+extern SpatialGrid segment_index;
+// tangents of an Interpolating curve through points, with its end condition
+extern CubicInterpolant interpolant;
+// arc length tables of the segments while spline_spacing is set. Any edit
+// changes the step, so every segment is resampled from them
+extern CurveArcLength curve_length;
+
+extern unsigned int num_points;
+extern unsigned int num_splines;
+
+// Indices [begin, end) changed since a consumer, such as the renderer, last
+// cleared the range. Removed entries are not marked, consumers compare sizes
+struct DirtyRange {
+    unsigned int begin = 0;
+    unsigned int end = 0;
+
+    bool Empty() const { return begin >= end; }
+    void Mark(unsigned int first, unsigned int last) {
+        if (first >= last) return;
+        begin = Empty() ? first : std::min(begin, first);
+        end = std::max(end, last);
+    }
+    void Clear() { begin = end = 0; }
+};
+
+extern DirtyRange dirty_points;
+extern DirtyRange dirty_splines;
+
+// Evaluates segments [first_segment, first_segment + num_segments_) of
+// coordinates, weighted by weights_ and over knots_ unless they are empty,
+// with the current settings, on num_threads, and appends them to splines_out.
+// tangents_ holds the tangents of an Interpolating curve through coordinates.
+// Samples are at fixed steps of t unless spline_tolerance is set, as
+// spline_spacing depends on the whole curve
+void EvaluateSegments(PairVector& coordinates,
+                      const std::vector<double>& weights_,
+                      const std::vector<double>& knots_,
+                      const std::vector<Eigen::Vector2d>& tangents_,
+                      unsigned int first_segment, unsigned int num_segments_,
+                      SampleArena& splines_out);
+
+void GroupPoints(SplineType spline_type_);
+void InsertPoint(double x, double y);
+// Appends a stream of points, then computes all new segments in one batch.
+// new_weights is empty or holds the weight of every new point
+void InsertPoints(const PairVector& new_points,
+                  const std::vector<double>& new_weights = {});
+// Appends the control points of a curve fitted to a dense stream of samples
+// to within fit_tolerance px, see fit.h
+void InsertFittedPoints(const PairVector& samples);
+// Index of the point nearest to (x, y) within radius px, or -1 if none is
+int FindPoint(double x, double y, double radius);
+// Index of the segment whose curve passes nearest to (x, y) within radius px,
+// or -1 if none does
+int FindSegment(double x, double y, double radius);
+// Point of the curve nearest to (x, y), with segment -1 if there is none
+CurvePoint ClosestPoint(double x, double y);
+// Every crossing of the curve with itself, see FindIntersections, with the
+// parameters of either segment as it is sampled. Throws std::invalid_argument
+// for NURBS
+std::vector<Intersection> FindCurveIntersections();
+// Moves a point and recomputes only the segments that depend on it
+void MovePoint(unsigned int index, double x, double y);
+void RemoveAllPoints();
+void RemovePrevPoint();
+
+#endif  // SPLINE_PLOTTER_SCENE_H_
@@ -0,0 +1,528 @@
+#include "serve.h"
+
+#include <fmt/format.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "adaptive.h"
+#include "args.h"
+#include "nurbs.h"
+#include "parallel.h"
+#include "scene.h"
+#include "trace.h"
+
+// ms between checks for a signal while waiting for connections
+static const int accept_poll_ms = 100;
+
+static std::atomic<bool> stop_serving(false);
+
+static void StopServing(int) { stop_serving = true; }
+
+// Reads exactly size bytes, returns false if the peer closed the connection
+// before the first of them
+static bool ReceiveAll(int socket, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    size_t received = 0;
+    while (received < size) {
+        ssize_t count = recv(socket, bytes + received, size - received, 0);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) throw std::runtime_error(std::strerror(errno));
+        if (count == 0) {
+            if (received == 0) return false;
+            throw std::runtime_error("connection closed mid frame");
+        }
+        received += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Sends every byte of parts, which it consumes, in as few calls as the
+// socket allows
+static void SendAll(int socket, std::vector<iovec>& parts) {
+    msghdr message{};
+    message.msg_iov = parts.data();
+    message.msg_iovlen = parts.size();
+    while (message.msg_iovlen > 0) {
+        // MSG_NOSIGNAL reports a closed peer as EPIPE rather than SIGPIPE
+        ssize_t count = sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) throw std::runtime_error(std::strerror(errno));
+        size_t sent = static_cast<size_t>(count);
+        while (message.msg_iovlen > 0 && sent >= message.msg_iov->iov_len) {
+            sent -= message.msg_iov->iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if (message.msg_iovlen > 0) {
+            message.msg_iov->iov_base =
+                static_cast<char*>(message.msg_iov->iov_base) + sent;
+            message.msg_iov->iov_len -= sent;
+        }
+    }
+}
+
+static iovec Part(const void* data, size_t size) {
+    return iovec{const_cast<void*>(data), size};
+}
+
+static sockaddr_un SocketAddress(const std::string& socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + socket_path);
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+int ConnectToServer(const std::string& socket_path) {
+    sockaddr_un address = SocketAddress(socket_path);
+    int socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_ < 0) throw std::runtime_error(std::strerror(errno));
+    if (connect(socket_, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) < 0) {
+        std::string error = std::strerror(errno);
+        close(socket_);
+        throw std::runtime_error("cannot connect to " + socket_path + ": " +
+                                 error);
+    }
+    return socket_;
+}
+
+void SendRequest(int socket, const SplineRequest& request) {
+    SplineRequestHeader header{};
+    std::memcpy(header.magic, spline_request_magic, 4);
+    header.version = serve_version;
+    header.id = request.id;
+    header.spline_type = static_cast<uint32_t>(request.spline_type);
+    header.degree = request.degree;
+    header.subdiv = request.subdiv;
+    header.derivative = request.derivative;
+    header.ends = static_cast<uint32_t>(request.ends);
+    header.num_points = static_cast<uint32_t>(request.points.size());
+    header.tolerance = request.tolerance;
+    std::vector<double> values;
+    values.reserve(2 * request.points.size());
+    for (const ControlPoint& point : request.points) {
+        values.push_back(point.first);
+        values.push_back(point.second);
+    }
+    std::vector<iovec> parts = {
+        Part(&header, sizeof(header)),
+        Part(values.data(), values.size() * sizeof(double))};
+    SendAll(socket, parts);
+}
+
+void ReceiveResponse(int socket, SplineResponse& response) {
+    SplineResponseHeader header;
+    if (!ReceiveAll(socket, &header, sizeof(header)))
+        throw std::runtime_error("server closed the connection");
+    if (std::memcmp(header.magic, spline_response_magic, 4) != 0)
+        throw std::runtime_error("not a spline response");
+    response.id = header.id;
+    response.status = static_cast<ServeStatus>(header.status);
+    response.message.assign(header.message_length, '\0');
+    if (header.message_length > 0)
+        ReceiveAll(socket, &response.message[0], header.message_length);
+    if (response.status != ServeStatus::Ok) {
+        response.offsets.assign(1, 0);
+        response.samples.clear();
+        return;
+    }
+    response.offsets.resize(header.num_segments + 1);
+    response.samples.resize(2 * header.num_samples);
+    ReceiveAll(socket, response.offsets.data(),
+               response.offsets.size() * sizeof(uint64_t));
+    ReceiveAll(socket, response.samples.data(),
+               response.samples.size() * sizeof(double));
+}
+
+// A request waiting in the queue and its response, with what evaluation
+// needs between its stages
+struct ServeJob {
+    SplineRequest request;
+    SplineResponse response;
+    unsigned int num_segments = 0;
+    std::vector<Eigen::Vector2d> tangents;  // of Interpolating curves
+    std::vector<SplineMatrix> pieces;       // adaptive samples by segment
+    std::promise<void> done;
+};
+
+// Segments [first, last) of a job, evaluated as one task
+struct ServeChunk {
+    ServeJob* job;
+    unsigned int first;
+    unsigned int last;
+};
+
+// Reads a request, returns false if the client closed the connection
+// between requests. Throws std::runtime_error for frames that cannot be read,
+// and std::invalid_argument for enumerators out of range once the rest of the
+// frame has been read, leaving the connection usable
+static bool ReceiveRequest(int socket, SplineRequest& request) {
+    SplineRequestHeader header;
+    if (!ReceiveAll(socket, &header, sizeof(header))) return false;
+    if (std::memcmp(header.magic, spline_request_magic, 4) != 0)
+        throw std::runtime_error("not a spline request");
+    if (header.version != serve_version)
+        throw std::runtime_error(
+            fmt::format("unsupported request version {}", header.version));
+    if (header.num_points > max_serve_points)
+        throw std::runtime_error(fmt::format("more than {} points",
+                                             max_serve_points));
+    request.id = header.id;
+    request.degree = header.degree;
+    request.subdiv = header.subdiv;
+    request.derivative = header.derivative;
+    request.tolerance = header.tolerance;
+    std::vector<double> values(2 * static_cast<size_t>(header.num_points));
+    ReceiveAll(socket, values.data(), values.size() * sizeof(double));
+    request.points.resize(header.num_points);
+    for (size_t i = 0; i < request.points.size(); i++)
+        request.points[i] = ControlPoint(values[2 * i], values[2 * i + 1]);
+    // checked before the casts below, an enum class holds any value
+    if (header.spline_type > static_cast<uint32_t>(SplineType::Interpolating))
+        throw std::invalid_argument("unknown spline type");
+    if (header.ends > static_cast<uint32_t>(EndCondition::Periodic))
+        throw std::invalid_argument("unknown end condition");
+    request.spline_type = static_cast<SplineType>(header.spline_type);
+    request.ends = static_cast<EndCondition>(header.ends);
+    return true;
+}
+
+static void SendResponse(int socket, const SplineResponse& response) {
+    SplineResponseHeader header{};
+    std::memcpy(header.magic, spline_response_magic, 4);
+    header.status = static_cast<uint32_t>(response.status);
+    header.id = response.id;
+    header.message_length = static_cast<uint32_t>(response.message.size());
+    std::vector<iovec> parts = {Part(&header, sizeof(header))};
+    if (response.status == ServeStatus::Ok) {
+        header.num_segments = response.NumSegments();
+        header.num_samples = response.NumSamples();
+        parts.push_back(Part(response.offsets.data(),
+                             response.offsets.size() * sizeof(uint64_t)));
+        parts.push_back(Part(response.samples.data(),
+                             response.samples.size() * sizeof(double)));
+    } else {
+        parts.push_back(Part(response.message.data(), response.message.size()));
+    }
+    SendAll(socket, parts);
+}
+
+// Bezier points of segment k of a job, which adaptive sampling splits
+static BezierMatrix JobBezier(const ServeJob& job, unsigned int k) {
+    const SplineRequest& request = job.request;
+    if (request.spline_type == SplineType::Interpolating)
+        return InterpolatedBezier(request.points, job.tangents, k);
+    return ComputeBezierPoints(
+        SegmentControlPoints(request.points, request.spline_type,
+                             request.degree, k),
+        request.spline_type);
+}
+
+// Checks the settings of a job's request and sizes its response. Throws
+// std::invalid_argument for settings it cannot be evaluated with
+static void PrepareJob(ServeJob& job) {
+    const SplineRequest& request = job.request;
+    job.response.id = request.id;
+    if (request.spline_type == SplineType::NURBS
+            ? request.degree < 1 || request.degree > max_nurbs_degree
+            : request.degree != 3)
+        throw std::invalid_argument(fmt::format(
+            "degree must be 1 to {} for NURBS and 3 otherwise",
+            max_nurbs_degree));
+    if (request.derivative > 2)
+        throw std::invalid_argument("derivative must be 0, 1 or 2");
+    const bool adaptive = request.tolerance > 0.0;
+    if (adaptive && request.spline_type == SplineType::NURBS)
+        throw std::invalid_argument(
+            "adaptive sampling needs a cubic spline type");
+    if (adaptive && request.derivative != 0)
+        throw std::invalid_argument("adaptive samples are positions only");
+    // every subdivision asked for builds its own sample table
+    if (!adaptive && (request.subdiv == 0 || request.subdiv > max_serve_subdiv))
+        throw std::invalid_argument(fmt::format(
+            "subdiv must be 1 to {} unless tolerance is set",
+            max_serve_subdiv));
+
+    if (request.spline_type == SplineType::Interpolating) {
+        CubicInterpolant interpolant_(request.ends);
+        interpolant_.Update(request.points, 0,
+                            static_cast<unsigned int>(request.points.size()));
+        job.tangents = interpolant_.Tangents();
+        job.num_segments = interpolant_.NumSegments();
+    } else {
+        job.num_segments =
+            NumSegments(request.spline_type, request.degree,
+                        static_cast<unsigned int>(request.points.size()));
+    }
+    if (adaptive) {
+        // bounded before sampling, so no request holds more than it may return
+        uint64_t max_samples = 0;
+        for (unsigned int k = 0; k < job.num_segments; k++)
+            max_samples += MaxAdaptiveSamples(JobBezier(job, k),
+                                              request.tolerance);
+        if (max_samples > max_serve_samples)
+            throw std::invalid_argument(fmt::format(
+                "tolerance {} px could give more than {} samples",
+                request.tolerance, max_serve_samples));
+        job.pieces.resize(job.num_segments);
+        return;
+    }
+    // every segment has the same samples
+    const uint64_t segment_samples =
+        NumSplineSamples(request.spline_type, request.subdiv);
+    if (segment_samples * job.num_segments > max_serve_samples)
+        throw std::invalid_argument(
+            fmt::format("more than {} samples", max_serve_samples));
+    job.response.offsets.resize(job.num_segments + 1);
+    for (unsigned int k = 0; k <= job.num_segments; k++)
+        job.response.offsets[k] = k * segment_samples;
+    job.response.samples.resize(2 * job.response.NumSamples());
+}
+
+static void EvaluateChunk(const ServeChunk& chunk) {
+    ServeJob& job = *chunk.job;
+    const SplineRequest& request = job.request;
+    for (unsigned int k = chunk.first; k < chunk.last; k++) {
+        if (request.tolerance > 0.0) {
+            job.pieces[k] =
+                ComputeSplineAdaptive(JobBezier(job, k), request.tolerance);
+            continue;
+        }
+        const bool interpolating =
+            request.spline_type == SplineType::Interpolating;
+        PairVector control_points;
+        if (!interpolating)
+            control_points = SegmentControlPoints(
+                request.points, request.spline_type, request.degree, k);
+        const uint64_t first_sample = job.response.offsets[k];
+        Eigen::Map<SplineMatrix> spline(
+            job.response.samples.data() + 2 * first_sample,
+            static_cast<Eigen::Index>(job.response.offsets[k + 1] -
+                                      first_sample),
+            2);
+        if (interpolating) {
+            spline.noalias() =
+                LookupSampleTable(SplineType::Interpolating, request.subdiv,
+                                  request.derivative) *
+                InterpolatedGeometry(request.points, job.tangents, k);
+        } else {
+            ComputeSpline(control_points, request.spline_type, request.degree,
+                          request.subdiv, request.derivative, spline);
+        }
+    }
+}
+
+// Adaptive segments vary in length, so they are gathered once all are known
+static void GatherPieces(ServeJob& job) {
+    if (job.request.tolerance <= 0.0) return;
+    SplineResponse& response = job.response;
+    response.offsets.resize(job.num_segments + 1);
+    for (unsigned int k = 0; k < job.num_segments; k++)
+        response.offsets[k + 1] =
+            response.offsets[k] + static_cast<uint64_t>(job.pieces[k].rows());
+    response.samples.resize(2 * response.NumSamples());
+    for (unsigned int k = 0; k < job.num_segments; k++)
+        std::copy(job.pieces[k].data(),
+                  job.pieces[k].data() + job.pieces[k].size(),
+                  response.samples.begin() +
+                      static_cast<std::ptrdiff_t>(2 * response.offsets[k]));
+    job.pieces.clear();
+}
+
+static void EvaluateBatch(ThreadPool& pool, std::vector<ServeJob*>& batch) {
+    ScopedTrace trace("serve batch");
+    TraceCounter("serve batch requests", static_cast<int64_t>(batch.size()));
+    const unsigned int num_jobs = static_cast<unsigned int>(batch.size());
+    pool.ParallelFor(num_jobs, [&](unsigned int i) {
+        try {
+            PrepareJob(*batch[i]);
+        } catch (const std::invalid_argument& error) {
+            batch[i]->response.status = ServeStatus::BadRequest;
+            batch[i]->response.message = error.what();
+            batch[i]->num_segments = 0;
+        }
+    });
+
+    // small requests share tasks with nothing, large ones are split up
+    std::vector<ServeChunk> chunks;
+    for (ServeJob* job : batch)
+        for (unsigned int first = 0; first < job->num_segments;
+             first += serve_chunk_segments)
+            chunks.push_back(ServeChunk{
+                job, first,
+                std::min(first + serve_chunk_segments, job->num_segments)});
+    pool.ParallelFor(static_cast<unsigned int>(chunks.size()),
+                     [&](unsigned int i) { EvaluateChunk(chunks[i]); });
+    pool.ParallelFor(num_jobs,
+                     [&](unsigned int i) { GatherPieces(*batch[i]); });
+}
+
+// Requests queued by the connection threads, taken a batch at a time
+struct ServeQueue {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<ServeJob*> jobs;
+    bool stopping = false;
+};
+
+static void BatchLoop(ServeQueue& queue, ThreadPool& pool,
+                      unsigned long long& num_batches,
+                      unsigned long long& num_requests) {
+    std::vector<ServeJob*> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.ready.wait(
+                lock, [&] { return queue.stopping || !queue.jobs.empty(); });
+            if (queue.jobs.empty()) return;
+            batch.assign(queue.jobs.begin(), queue.jobs.end());
+            queue.jobs.clear();
+        }
+        EvaluateBatch(pool, batch);
+        num_batches++;
+        num_requests += batch.size();
+        for (ServeJob* job : batch) job->done.set_value();
+    }
+}
+
+struct ServeConnection {
+    int socket;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+static void ServeClient(ServeConnection& connection, ServeQueue& queue) {
+    for (;;) {
+        ServeJob job;
+        try {
+            if (!ReceiveRequest(connection.socket, job.request)) break;
+        } catch (const std::invalid_argument& error) {
+            job.response.id = job.request.id;
+            job.response.status = ServeStatus::BadRequest;
+            job.response.message = error.what();
+            try {
+                SendResponse(connection.socket, job.response);
+            } catch (const std::runtime_error&) {
+                break;
+            }
+            continue;
+        } catch (const std::runtime_error& error) {
+            // the stream cannot be followed past a bad frame
+            job.response.status = ServeStatus::BadRequest;
+            job.response.message = error.what();
+            try {
+                SendResponse(connection.socket, job.response);
+            } catch (const std::runtime_error&) {
+            }
+            break;
+        }
+        std::future<void> done = job.done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(&job);
+        }
+        queue.ready.notify_one();
+        done.wait();
+        try {
+            ScopedTrace trace("serve response");
+            SendResponse(connection.socket, job.response);
+        } catch (const std::runtime_error&) {
+            break;
+        }
+    }
+    close(connection.socket);
+    connection.finished = true;
+}
+
+int RunServer(std::vector<std::string> args) {
+    std::string socket_path = CheckArgString(args, "--serve");
+    int listener = -1;
+    try {
+        sockaddr_un address = SocketAddress(socket_path);
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) throw std::runtime_error(std::strerror(errno));
+        // a socket file left by a server that did not shut down is reused
+        unlink(socket_path.c_str());
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) < 0 ||
+            listen(listener, SOMAXCONN) < 0)
+            throw std::runtime_error("cannot listen on " + socket_path +
+                                     ": " + std::strerror(errno));
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        if (listener >= 0) close(listener);
+        return EXIT_FAILURE;
+    }
+    std::signal(SIGINT, StopServing);
+    std::signal(SIGTERM, StopServing);
+
+    ServeQueue queue;
+    ThreadPool pool(num_threads);
+    unsigned long long num_batches = 0, num_requests = 0;
+    std::thread batcher(BatchLoop, std::ref(queue), std::ref(pool),
+                        std::ref(num_batches), std::ref(num_requests));
+    std::cout << "Serving on " << socket_path << " with " << num_threads
+              << " threads" << std::endl;
+
+    std::list<std::unique_ptr<ServeConnection>> connections;
+    auto start = std::chrono::steady_clock::now();
+    while (!stop_serving) {
+        pollfd waiting{listener, POLLIN, 0};
+        if (poll(&waiting, 1, accept_poll_ms) <= 0) continue;
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) continue;
+        connections.remove_if([](const std::unique_ptr<ServeConnection>& c) {
+            if (!c->finished) return false;
+            c->thread.join();
+            return true;
+        });
+        connections.push_back(std::make_unique<ServeConnection>());
+        ServeConnection& connection = *connections.back();
+        connection.socket = client;
+        connection.thread = std::thread(ServeClient, std::ref(connection),
+                                        std::ref(queue));
+    }
+
+    // clients still connected are cut off once their request is answered
+    close(listener);
+    unlink(socket_path.c_str());
+    for (auto& connection : connections) {
+        if (!connection->finished) shutdown(connection->socket, SHUT_RDWR);
+        connection->thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.stopping = true;
+    }
+    queue.ready.notify_one();
+    batcher.join();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format(
+                     "Served {} requests in {} batches over {:.1f} s",
+                     num_requests, num_batches, elapsed.count())
+              << std::endl;
+    return EXIT_SUCCESS;
+}
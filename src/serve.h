@@ -0,0 +1,105 @@
+#ifndef SPLINE_PLOTTER_SERVE_H_
+#define SPLINE_PLOTTER_SERVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "interpolate.h"
+#include "spline.h"
+
+// Spline evaluation service on a Unix domain socket (--serve {path}). A
+// client sends any number of requests on a connection, each answered in turn:
+//   SplineRequestHeader                       48 bytes
+//   double points[num_points][2]              x, y of every control point
+// and reads back
+//   SplineResponseHeader                      32 bytes
+//   uint64 offsets[num_segments + 1]          first sample of every segment,
+//                                             the last entry is num_samples
+//   double samples[num_samples][2]            x, y of every sample in order
+// or, unless status is Ok, message_length bytes saying why in place of the
+// offsets and samples. The socket is local, so fields are in the byte order
+// both ends share. Control points are evaluated as they are given, without
+// the continuity the window enforces
+const char spline_request_magic[4] = {'S', 'P', 'L', 'Q'};
+const char spline_response_magic[4] = {'S', 'P', 'L', 'R'};
+const uint32_t serve_version = 1;
+
+// a frame claiming more is taken as garbage and closes its connection
+const uint32_t max_serve_points = 1u << 24;
+// requests that would return more samples than this are refused, adaptive
+// ones if they could, see MaxAdaptiveSamples
+const uint64_t max_serve_samples = 1ull << 28;
+// samples per unit of t a request may ask for, above max_cached_subdiv its
+// sample tables are built by each worker rather than kept
+const uint32_t max_serve_subdiv = 1u << 16;
+// segments evaluated by one task of the worker pool
+const unsigned int serve_chunk_segments = 256;
+
+struct SplineRequestHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t id;           // echoed in the response
+    uint32_t spline_type;  // SplineType enumerator
+    uint32_t degree;       // of NURBS curves, the other types are cubic
+    uint32_t subdiv;       // samples per unit of t, unless tolerance is set
+    uint32_t derivative;   // 0 to 2
+    uint32_t ends;         // EndCondition enumerator of Interpolating curves
+    uint32_t num_points;
+    uint32_t reserved;
+    double tolerance;  // px, adaptive positions when positive, see adaptive.h
+};
+static_assert(sizeof(SplineRequestHeader) == 48, "unexpected header padding");
+
+enum class ServeStatus : uint32_t { Ok, BadRequest };
+
+struct SplineResponseHeader {
+    char magic[4];
+    uint32_t status;  // ServeStatus enumerator
+    uint32_t id;
+    uint32_t message_length;
+    uint64_t num_segments;
+    uint64_t num_samples;
+};
+static_assert(sizeof(SplineResponseHeader) == 32, "unexpected header padding");
+
+struct SplineRequest {
+    uint32_t id = 0;
+    SplineType spline_type = SplineType::Hermite;
+    unsigned int degree = 3;
+    unsigned int subdiv = 150;
+    unsigned int derivative = 0;
+    EndCondition ends = EndCondition::Natural;
+    double tolerance = 0.0;
+    PairVector points;
+};
+
+struct SplineResponse {
+    uint32_t id = 0;
+    ServeStatus status = ServeStatus::Ok;
+    std::string message;
+    std::vector<uint64_t> offsets = {0};
+    std::vector<double> samples;  // x, y of every sample
+
+    uint64_t NumSegments() const { return offsets.size() - 1; }
+    uint64_t NumSamples() const { return offsets.back(); }
+};
+
+// Client side of a connection. Each throws std::runtime_error if the
+// connection fails or the server sends something other than a response
+int ConnectToServer(const std::string& socket_path);
+void SendRequest(int socket, const SplineRequest& request);
+void ReceiveResponse(int socket, SplineResponse& response);
+
+// Serves requests on the socket path of --serve until SIGINT or SIGTERM.
+// Every connection is read on its own thread, which queues its requests and
+// waits for their responses. One thread takes every request queued while
+// the previous batch was evaluated as the next batch, so requests are
+// coalesced as fast as they arrive without waiting for more, and evaluates
+// it with ComputeSpline on a pool of --threads workers, split into tasks of
+// serve_chunk_segments segments across all of its requests. Returns the exit
+// status
+int RunServer(std::vector<std::string> args);
+
+#endif  // SPLINE_PLOTTER_SERVE_H_
@@ -0,0 +1,269 @@
+#include "spatial.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "adaptive.h"
+#include "curve.h"
+#include "interpolate.h"
+#include "nurbs.h"
+
+// cells at the coarsest level are 2^48 times the finest, far beyond any scene
+static const unsigned int max_level = 48;
+// cell coordinates are packed into 32 bits each
+static const double max_cell = 2147483647.0;
+
+static BoundingBox EmptyBounds() {
+    const double inf = std::numeric_limits<double>::infinity();
+    return BoundingBox{inf, inf, -inf, -inf};
+}
+
+static void Enclose(BoundingBox& box, double x, double y) {
+    box.min_x = std::min(box.min_x, x);
+    box.min_y = std::min(box.min_y, y);
+    box.max_x = std::max(box.max_x, x);
+    box.max_y = std::max(box.max_y, y);
+}
+
+static uint64_t CellKey(int64_t x, int64_t y) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 |
+           static_cast<uint32_t>(y);
+}
+
+double BoundingBox::Distance(double x, double y) const {
+    double dx = std::max({min_x - x, 0.0, x - max_x});
+    double dy = std::max({min_y - y, 0.0, y - max_y});
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+BoundingBox PointBounds(const ControlPoint& point) {
+    return BoundingBox{point.first, point.second, point.first, point.second};
+}
+
+BoundingBox SegmentBounds(const PairVector& control_points,
+                          SplineType spline_type_,
+                          unsigned int spline_degree_) {
+    BoundingBox box = EmptyBounds();
+    if (spline_type_ == SplineType::NURBS || spline_degree_ != 3) {
+        for (auto point : control_points)
+            Enclose(box, point.first, point.second);
+        return box;
+    }
+    return BezierBounds(ComputeBezierPoints(control_points, spline_type_));
+}
+
+BoundingBox BezierBounds(const BezierMatrix& bezier) {
+    BoundingBox box = EmptyBounds();
+    for (Eigen::Index i = 0; i < 4; i++)
+        Enclose(box, bezier(i, 0), bezier(i, 1));
+    return box;
+}
+
+SpatialGrid::SpatialGrid(double cell_size)
+    : cell_size_(cell_size), extent_(EmptyBounds()) {
+    if (!(cell_size_ > 0.0))
+        throw std::invalid_argument("grid cells must have a positive size");
+}
+
+void SpatialGrid::CellRange(const BoundingBox& box, unsigned int level,
+                            int64_t* x0, int64_t* y0, int64_t* x1,
+                            int64_t* y1) const {
+    const double size = std::ldexp(cell_size_, static_cast<int>(level));
+    auto cell = [&](double coordinate) {
+        return static_cast<int64_t>(
+            std::clamp(std::floor(coordinate / size), -max_cell, max_cell));
+    };
+    *x0 = cell(box.min_x);
+    *y0 = cell(box.min_y);
+    *x1 = cell(box.max_x);
+    *y1 = cell(box.max_y);
+}
+
+void SpatialGrid::Insert(unsigned int id, const BoundingBox& box) {
+    if (!(box.min_x <= box.max_x && box.min_y <= box.max_y))
+        throw std::invalid_argument("bounding box is empty or not a number");
+    if (Contains(id)) Remove(id);
+    if (id >= boxes_.size()) {
+        boxes_.resize(id + 1);
+        levels_of_items_.resize(id + 1, absent);
+    }
+
+    // a box no wider than a cell spans at most 2 of them
+    const double extent =
+        std::max(box.max_x - box.min_x, box.max_y - box.min_y);
+    unsigned int level = 0;
+    while (level < max_level &&
+           std::ldexp(cell_size_, static_cast<int>(level)) < extent)
+        level++;
+    if (level >= levels_.size()) levels_.resize(level + 1);
+
+    int64_t x0, y0, x1, y1;
+    CellRange(box, level, &x0, &y0, &x1, &y1);
+    for (int64_t cx = x0; cx <= x1; cx++)
+        for (int64_t cy = y0; cy <= y1; cy++)
+            levels_[level][CellKey(cx, cy)].push_back(id);
+
+    boxes_[id] = box;
+    levels_of_items_[id] = level;
+    num_items_++;
+    Enclose(extent_, box.min_x, box.min_y);
+    Enclose(extent_, box.max_x, box.max_y);
+}
+
+void SpatialGrid::Remove(unsigned int id) {
+    if (!Contains(id)) return;
+    const unsigned int level = levels_of_items_[id];
+    int64_t x0, y0, x1, y1;
+    CellRange(boxes_[id], level, &x0, &y0, &x1, &y1);
+    for (int64_t cx = x0; cx <= x1; cx++) {
+        for (int64_t cy = y0; cy <= y1; cy++) {
+            auto cell = levels_[level].find(CellKey(cx, cy));
+            if (cell == levels_[level].end()) continue;
+            std::vector<unsigned int>& ids = cell->second;
+            auto it = std::find(ids.begin(), ids.end(), id);
+            if (it != ids.end()) {
+                *it = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty()) levels_[level].erase(cell);
+        }
+    }
+    levels_of_items_[id] = absent;
+    num_items_--;
+}
+
+void SpatialGrid::Clear() {
+    levels_.clear();
+    boxes_.clear();
+    levels_of_items_.clear();
+    num_items_ = 0;
+    extent_ = EmptyBounds();
+}
+
+void SpatialGrid::Query(const BoundingBox& box,
+                        std::vector<unsigned int>& ids) const {
+    for (unsigned int level = 0; level < levels_.size(); level++) {
+        const CellMap& cells = levels_[level];
+        if (cells.empty()) continue;
+        int64_t x0, y0, x1, y1;
+        CellRange(box, level, &x0, &y0, &x1, &y1);
+
+        // a box listed in several cells is reported from the first of them
+        // inside the query range
+        auto visit = [&](int64_t cx, int64_t cy,
+                         const std::vector<unsigned int>& cell) {
+            for (unsigned int id : cell) {
+                int64_t ix0, iy0, ix1, iy1;
+                CellRange(boxes_[id], level, &ix0, &iy0, &ix1, &iy1);
+                if (cx == std::max(ix0, x0) && cy == std::max(iy0, y0) &&
+                    boxes_[id].Intersects(box))
+                    ids.push_back(id);
+            }
+        };
+
+        // large query boxes over sparse levels scan the occupied cells
+        double num_cells = static_cast<double>(x1 - x0 + 1) *
+                           static_cast<double>(y1 - y0 + 1);
+        if (num_cells > static_cast<double>(cells.size())) {
+            for (const auto& [key, cell] : cells) {
+                int64_t cx = static_cast<int32_t>(key >> 32);
+                int64_t cy = static_cast<int32_t>(key & 0xffffffffu);
+                if (cx >= x0 && cx <= x1 && cy >= y0 && cy <= y1)
+                    visit(cx, cy, cell);
+            }
+            continue;
+        }
+        for (int64_t cx = x0; cx <= x1; cx++) {
+            for (int64_t cy = y0; cy <= y1; cy++) {
+                auto cell = cells.find(CellKey(cx, cy));
+                if (cell != cells.end()) visit(cx, cy, cell->second);
+            }
+        }
+    }
+}
+
+int NearestPoint(const SpatialGrid& points_index,
+                 const PairVector& coordinates, double x, double y,
+                 double radius) {
+    std::vector<unsigned int> candidates;
+    points_index.Query(
+        BoundingBox{x - radius, y - radius, x + radius, y + radius},
+        candidates);
+    int nearest = -1;
+    double nearest_distance = radius * radius;
+    for (unsigned int i : candidates) {
+        double dx = coordinates[i].first - x, dy = coordinates[i].second - y;
+        double distance = dx * dx + dy * dy;
+        if (distance < nearest_distance ||
+            (distance == nearest_distance && static_cast<int>(i) > nearest)) {
+            nearest = static_cast<int>(i);
+            nearest_distance = distance;
+        }
+    }
+    return nearest;
+}
+
+CurvePoint ClosestPointOnCurve(const SpatialGrid& segments_index,
+                               const PairVector& coordinates,
+                               const std::vector<double>& weights,
+                               const std::vector<double>& knots,
+                               const std::vector<Eigen::Vector2d>& tangents,
+                               SplineType spline_type_,
+                               unsigned int spline_degree_, double x,
+                               double y, double max_distance) {
+    CurvePoint closest;
+    if (segments_index.Size() == 0 || !(max_distance >= 0.0)) return closest;
+    const Eigen::Vector2d target(x, y);
+    const BoundingBox& extent = segments_index.Extent();
+
+    std::vector<unsigned int> candidates;
+    std::vector<std::pair<double, unsigned int>> ordered;
+    double radius = std::min(segments_index.CellSize(), max_distance);
+    for (;;) {
+        BoundingBox query{x - radius, y - radius, x + radius, y + radius};
+        candidates.clear();
+        segments_index.Query(query, candidates);
+        ordered.clear();
+        for (unsigned int k : candidates)
+            ordered.emplace_back(segments_index.Bounds(k).Distance(x, y), k);
+        std::sort(ordered.begin(), ordered.end());
+
+        // no segment is closer than its box
+        for (auto [box_distance, k] : ordered) {
+            if (box_distance >= closest.distance || box_distance > max_distance)
+                break;
+            SegmentCurve curve =
+                spline_type_ == SplineType::Interpolating
+                    ? SegmentCurve(
+                          InterpolatedCoefficients(coordinates, tangents, k))
+                    : SegmentCurve(SegmentControlPoints(coordinates,
+                                                        spline_type_,
+                                                        spline_degree_, k),
+                                   SegmentWeights(weights, spline_type_,
+                                                  spline_degree_, k),
+                                   SegmentKnots(knots, spline_type_,
+                                                spline_degree_, k),
+                                   spline_type_, spline_degree_);
+            double t = curve.ClosestParam(target);
+            Eigen::Vector2d point = curve.Point(t);
+            double distance = (point - target).norm();
+            if (distance < closest.distance && distance <= max_distance) {
+                closest.segment = static_cast<int>(k);
+                closest.t = t;
+                closest.point = point;
+                closest.distance = distance;
+            }
+        }
+
+        // every segment within radius intersects the query box
+        bool covers_extent = query.min_x <= extent.min_x &&
+                             query.min_y <= extent.min_y &&
+                             query.max_x >= extent.max_x &&
+                             query.max_y >= extent.max_y;
+        if (closest.distance <= radius || radius >= max_distance ||
+            covers_extent)
+            return closest;
+        radius = std::min(2.0 * radius, max_distance);
+    }
+}
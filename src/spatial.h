@@ -0,0 +1,111 @@
+#ifndef SPLINE_PLOTTER_SPATIAL_H_
+#define SPLINE_PLOTTER_SPATIAL_H_
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "adaptive.h"
+#include "spline.h"
+
+// px, side of the cells at the finest level of a SpatialGrid
+const double spatial_cell_size = 32.0;
+
+struct BoundingBox {
+    double min_x = 0.0;
+    double min_y = 0.0;
+    double max_x = 0.0;
+    double max_y = 0.0;
+
+    bool Intersects(const BoundingBox& other) const {
+        return min_x <= other.max_x && other.min_x <= max_x &&
+               min_y <= other.max_y && other.min_y <= max_y;
+    }
+    // Distance from (x, y) to the box, 0 inside it
+    double Distance(double x, double y) const;
+};
+
+BoundingBox PointBounds(const ControlPoint& point);
+// Box holding a whole segment. Cubic segments are bounded by the control
+// points of their Bezier form, since Hermite and CatmullRom control points
+// need not enclose the curve, NURBS ones by their own control points, which
+// do for positive weights
+BoundingBox SegmentBounds(const PairVector& control_points,
+                          SplineType spline_type_,
+                          unsigned int spline_degree_);
+BoundingBox BezierBounds(const BezierMatrix& bezier);
+
+// Boxes indexed by id in a hierarchy of uniform grids whose cells double in
+// size from level to level. A box is stored at the finest level where it
+// spans at most 2 cells along each axis, so it is listed in at most 4 cells
+// however large it is, and inserting, moving or removing one touches only
+// those. Queries visit the cells of every occupied level the query box
+// overlaps
+class SpatialGrid {
+   public:
+    explicit SpatialGrid(double cell_size = spatial_cell_size);
+
+    double CellSize() const { return cell_size_; }
+    size_t Size() const { return num_items_; }
+    bool Contains(unsigned int id) const {
+        return id < levels_of_items_.size() && levels_of_items_[id] != absent;
+    }
+    const BoundingBox& Bounds(unsigned int id) const { return boxes_[id]; }
+    // Union of every box inserted since the last Clear
+    const BoundingBox& Extent() const { return extent_; }
+
+    // Adds id, replacing its box if it is already present
+    void Insert(unsigned int id, const BoundingBox& box);
+    void Remove(unsigned int id);
+    void Clear();
+
+    // Appends the ids of the boxes intersecting box to ids, each once
+    void Query(const BoundingBox& box, std::vector<unsigned int>& ids) const;
+
+   private:
+    typedef std::unordered_map<uint64_t, std::vector<unsigned int>> CellMap;
+    static constexpr unsigned int absent =
+        std::numeric_limits<unsigned int>::max();
+
+    // range of cells a box covers at level, as [x0, x1] x [y0, y1]
+    void CellRange(const BoundingBox& box, unsigned int level, int64_t* x0,
+                   int64_t* y0, int64_t* x1, int64_t* y1) const;
+
+    double cell_size_;
+    std::vector<CellMap> levels_;
+    std::vector<BoundingBox> boxes_;
+    std::vector<unsigned int> levels_of_items_;  // absent for removed ids
+    size_t num_items_ = 0;
+    BoundingBox extent_;
+};
+
+// Index of the point of coordinates in points_index nearest to (x, y) within
+// radius px, or -1 if none is. Ties go to the later point
+int NearestPoint(const SpatialGrid& points_index,
+                 const PairVector& coordinates, double x, double y,
+                 double radius);
+
+struct CurvePoint {
+    int segment = -1;  // -1 when no segment is close enough
+    double t = 0.0;
+    Eigen::Vector2d point = Eigen::Vector2d::Zero();
+    double distance = std::numeric_limits<double>::infinity();
+};
+
+// Point of the curve over coordinates closest to (x, y), among the segments
+// indexed in segments_index within max_distance px. The query box starts at
+// one cell and doubles until a segment inside it is closer than its half
+// width, so only nearby segments are refined. weights is empty when every
+// weight is 1, knots unless they are clamped (see nurbs.h) and tangents
+// unless the curve is Interpolating
+CurvePoint ClosestPointOnCurve(
+    const SpatialGrid& segments_index, const PairVector& coordinates,
+    const std::vector<double>& weights, const std::vector<double>& knots,
+    const std::vector<Eigen::Vector2d>& tangents, SplineType spline_type_,
+    unsigned int spline_degree_, double x, double y,
+    double max_distance = std::numeric_limits<double>::infinity());
+
+#endif  // SPLINE_PLOTTER_SPATIAL_H_
@@ -0,0 +1,382 @@
+#include "spline.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+
+#include "basis.h"
+#include "nurbs.h"
+
+PairVector ReturnLastNFromM(PairVector& coordinates, unsigned int n,
+                            unsigned int m) {
+    // returns elements of index n to m of the PairVector
+    PairVector control_points(&coordinates[m - n], &coordinates[m]);
+    return control_points;
+}
+
+PairVector ReturnLastN(PairVector& coordinates, unsigned int n) {
+    // returns the last n points of the PairVector
+    unsigned int m = static_cast<unsigned int>(coordinates.size());
+    return ReturnLastNFromM(coordinates, n, m);
+}
+
+std::string SplineTypeName(SplineType spline_type_) {
+    switch (spline_type_) {
+        case SplineType::Hermite:
+            return "Hermite";
+        case SplineType::Bezier:
+            return "Bezier";
+        case SplineType::BSpline:
+            return "BSpline";
+        case SplineType::CatmullRom:
+            return "CatmullRom";
+        case SplineType::MINVO:
+            return "MINVO";
+        case SplineType::NURBS:
+            return "NURBS";
+        case SplineType::Interpolating:
+            return "Interpolating";
+        default:
+            return "Unknown";
+    }
+}
+
+bool ParseSplineType(std::string name, SplineType& spline_type_) {
+    for (SplineType type :
+         {SplineType::Hermite, SplineType::Bezier, SplineType::BSpline,
+          SplineType::CatmullRom, SplineType::MINVO, SplineType::NURBS,
+          SplineType::Interpolating}) {
+        if (name == SplineTypeName(type)) {
+            spline_type_ = type;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IsSegmentedSpline(SplineType spline_type_) {
+    return spline_type_ == SplineType::Hermite ||
+           spline_type_ == SplineType::Bezier ||
+           spline_type_ == SplineType::MINVO;
+}
+
+unsigned int NumSegments(SplineType spline_type_, unsigned int spline_degree_,
+                         unsigned int num_points_) {
+    if (spline_type_ == SplineType::Interpolating)
+        return num_points_ >= 2 ? num_points_ - 1 : 0;
+    if (num_points_ < spline_degree_ + 1) return 0;
+    if (IsSegmentedSpline(spline_type_))
+        return (num_points_ - 1) / spline_degree_;
+    return num_points_ - spline_degree_;
+}
+
+unsigned int SegmentStart(SplineType spline_type_, unsigned int spline_degree_,
+                          unsigned int k) {
+    return IsSegmentedSpline(spline_type_) ? k * spline_degree_ : k;
+}
+
+std::pair<unsigned int, unsigned int> SegmentsWithPoint(
+    SplineType spline_type_, unsigned int spline_degree_,
+    unsigned int num_points_, unsigned int index) {
+    // segment k uses points [SegmentStart(k), SegmentStart(k) + p]
+    unsigned int stride = IsSegmentedSpline(spline_type_) ? spline_degree_ : 1;
+    unsigned int first =
+        index > spline_degree_ ? (index - spline_degree_ + stride - 1) / stride
+                               : 0;
+    unsigned int last = std::min(
+        index / stride + 1,
+        NumSegments(spline_type_, spline_degree_, num_points_));
+    return std::make_pair(first, std::max(first, last));
+}
+
+PairVector SegmentControlPoints(const PairVector& coordinates,
+                                SplineType spline_type_,
+                                unsigned int spline_degree_, unsigned int k) {
+    unsigned int start = SegmentStart(spline_type_, spline_degree_, k);
+    return PairVector(coordinates.begin() + start,
+                      coordinates.begin() + start + spline_degree_ + 1);
+}
+
+unsigned int ReturnPointIndex(SplineType spline_type_,
+                              unsigned int spline_degree_,
+                              unsigned int num_points_) {
+    unsigned int index = num_points_;
+
+    if (num_points_ >= spline_degree_ + 1) {
+        if (IsSegmentedSpline(spline_type_)) {
+            index = (num_points_ - 1) % spline_degree_;
+        } else {
+            index = 0;
+        }
+    }
+    return index;
+}
+
+double CheckCCW(const ControlPoint& p0, const ControlPoint& p1,
+                const ControlPoint& p2) {
+    // Check whether p2 lies left of line segment p0-p1 with cross product
+    return (p1.first - p0.first) * (p2.second - p0.second) -
+           (p2.first - p0.first) * (p1.second - p0.second);
+}
+
+PairVector SortConvex(const PairVector& control_points) {
+    // Andrew's monotone chain convex hull algorithm
+    PairVector sorted_points(control_points);
+
+    // STEP 1: Sort the points lexicographically and drop duplicates
+    std::sort(sorted_points.begin(), sorted_points.end());
+    sorted_points.erase(std::unique(sorted_points.begin(), sorted_points.end()),
+                        sorted_points.end());
+    if (sorted_points.size() < 3) return sorted_points;
+
+    // STEP 2: Build the lower then the upper hull, removing points that do not
+    // make a strict CCW turn so collinear points are dropped
+    PairVector hull(2 * sorted_points.size());
+    size_t k = 0;
+    for (size_t i = 0; i < sorted_points.size(); i++) {
+        while (k >= 2 &&
+               CheckCCW(hull[k - 2], hull[k - 1], sorted_points[i]) <= 0)
+            k--;
+        hull[k++] = sorted_points[i];
+    }
+    for (size_t i = sorted_points.size() - 1, lower = k + 1; i > 0; i--) {
+        while (k >= lower &&
+               CheckCCW(hull[k - 2], hull[k - 1], sorted_points[i - 1]) <= 0)
+            k--;
+        hull[k++] = sorted_points[i - 1];
+    }
+
+    // the last point repeats the first
+    hull.resize(k - 1);
+    return hull;
+}
+
+double ParamStart(SplineType spline_type_) {
+    switch (spline_type_) {
+        case SplineType::Hermite:
+            return Basis<SplineType::Hermite, 3>::t_min;
+        case SplineType::Bezier:
+            return Basis<SplineType::Bezier, 3>::t_min;
+        case SplineType::BSpline:
+            return Basis<SplineType::BSpline, 3>::t_min;
+        case SplineType::CatmullRom:
+            return Basis<SplineType::CatmullRom, 3>::t_min;
+        case SplineType::MINVO:
+            return Basis<SplineType::MINVO, 3>::t_min;
+        case SplineType::NURBS:
+            return 0.0;  // across one knot span
+        case SplineType::Interpolating:
+            return Basis<SplineType::Hermite, 3>::t_min;
+        default:
+            throw std::invalid_argument("unknown spline type");
+    }
+}
+
+unsigned int NumSplineSamples(SplineType spline_type_,
+                              unsigned int spline_subdiv_) {
+    // matches the rows of ComputeSampleTable, counted in 64 bits as MINVO
+    // segments span more than a unit of t
+    const uint64_t num_samples =
+        static_cast<uint64_t>((1.0 - ParamStart(spline_type_)) *
+                              spline_subdiv_) +
+        1;
+    if (num_samples > std::numeric_limits<unsigned int>::max())
+        throw std::invalid_argument("too many samples per segment");
+    return static_cast<unsigned int>(num_samples);
+}
+
+CoefficientMatrix ComputeCoefficients(const PairVector& control_points,
+                                      SplineType spline_type_) {
+    switch (spline_type_) {
+        case SplineType::Hermite:
+            return BasisMatrix<SplineType::Hermite, 3>() *
+                   GeometryMatrix<SplineType::Hermite, 3>(control_points);
+        case SplineType::Bezier:
+            return BasisMatrix<SplineType::Bezier, 3>() *
+                   GeometryMatrix<SplineType::Bezier, 3>(control_points);
+        case SplineType::BSpline:
+            return BasisMatrix<SplineType::BSpline, 3>() *
+                   GeometryMatrix<SplineType::BSpline, 3>(control_points);
+        case SplineType::CatmullRom:
+            return BasisMatrix<SplineType::CatmullRom, 3>() *
+                   GeometryMatrix<SplineType::CatmullRom, 3>(control_points);
+        case SplineType::MINVO:
+            return BasisMatrix<SplineType::MINVO, 3>() *
+                   GeometryMatrix<SplineType::MINVO, 3>(control_points);
+        case SplineType::NURBS:
+            throw std::invalid_argument("NURBS segments have no cubic basis");
+        case SplineType::Interpolating:
+            throw std::invalid_argument(
+                "Interpolating segments need their solved tangents");
+        default:
+            throw std::invalid_argument("unknown spline type");
+    }
+}
+
+static SampleTable BuildSampleTable(SplineType spline_type_,
+                                   unsigned int spline_subdiv_,
+                                   unsigned int derivative) {
+    switch (spline_type_) {
+        case SplineType::Hermite:
+        case SplineType::Interpolating:
+            // sampled from their Hermite geometry
+            return ComputeSampleTable<SplineType::Hermite, 3>(spline_subdiv_,
+                                                              derivative);
+        case SplineType::Bezier:
+            return ComputeSampleTable<SplineType::Bezier, 3>(spline_subdiv_,
+                                                             derivative);
+        case SplineType::BSpline:
+            return ComputeSampleTable<SplineType::BSpline, 3>(spline_subdiv_,
+                                                              derivative);
+        case SplineType::CatmullRom:
+            return ComputeSampleTable<SplineType::CatmullRom, 3>(
+                spline_subdiv_, derivative);
+        case SplineType::MINVO:
+            return ComputeSampleTable<SplineType::MINVO, 3>(spline_subdiv_,
+                                                            derivative);
+        case SplineType::NURBS:
+            throw std::invalid_argument("NURBS segments have no cubic basis");
+        default:
+            throw std::invalid_argument("unknown spline type");
+    }
+}
+
+const SampleTable& LookupSampleTable(SplineType spline_type_,
+                                     unsigned int spline_subdiv_,
+                                     unsigned int derivative) {
+    typedef std::tuple<SplineType, unsigned int, unsigned int> Key;
+    static std::map<Key, SampleTable> sample_tables;
+    static std::mutex sample_tables_mutex;
+
+    if (derivative > 2)
+        throw std::invalid_argument("Choose from derivatives = {0, 1, 2}");
+
+    const Key key = std::make_tuple(spline_type_, spline_subdiv_, derivative);
+    {
+        // std::map never moves its elements, so references stay valid
+        std::lock_guard<std::mutex> lock(sample_tables_mutex);
+        auto cached = sample_tables.find(key);
+        if (cached != sample_tables.end()) return cached->second;
+        if (spline_subdiv_ <= max_cached_subdiv &&
+            sample_tables.size() < max_cached_tables)
+            return sample_tables
+                .emplace(key, BuildSampleTable(spline_type_, spline_subdiv_,
+                                               derivative))
+                .first->second;
+    }
+
+    // kept by this thread, one table for each derivative order
+    thread_local std::optional<Key> scratch_keys[3];
+    thread_local SampleTable scratch_tables[3];
+    if (scratch_keys[derivative] != key) {
+        scratch_tables[derivative] =
+            BuildSampleTable(spline_type_, spline_subdiv_, derivative);
+        scratch_keys[derivative] = key;
+    }
+    return scratch_tables[derivative];
+}
+
+void ComputeSpline(PairVector& control_points, SplineType spline_type_,
+                   unsigned int spline_degree_, unsigned int spline_subdiv_,
+                   unsigned int derivative, Eigen::Map<SplineMatrix> spline) {
+    assert(control_points.size() == spline_degree_ + 1);
+    if (spline_type_ == SplineType::NURBS) {
+        ComputeNURBS(control_points.data(), nullptr, nullptr, spline_degree_,
+                     spline_subdiv_, derivative, spline);
+        return;
+    }
+    if (spline_type_ == SplineType::Interpolating)
+        throw std::invalid_argument(
+            "Interpolating segments need their solved tangents");
+    if (spline_degree_ != 3)
+        throw std::invalid_argument("only cubic spline bases are tabulated");
+
+    const SampleTable& sample_table =
+        LookupSampleTable(spline_type_, spline_subdiv_, derivative);
+    switch (spline_type_) {
+        case SplineType::Hermite:
+            EvaluateSpline<SplineType::Hermite, 3>(control_points,
+                                                   sample_table, spline);
+            break;
+        case SplineType::Bezier:
+            EvaluateSpline<SplineType::Bezier, 3>(control_points, sample_table,
+                                                  spline);
+            break;
+        case SplineType::BSpline:
+            EvaluateSpline<SplineType::BSpline, 3>(control_points,
+                                                   sample_table, spline);
+            break;
+        case SplineType::CatmullRom:
+            EvaluateSpline<SplineType::CatmullRom, 3>(control_points,
+                                                      sample_table, spline);
+            break;
+        case SplineType::MINVO:
+            EvaluateSpline<SplineType::MINVO, 3>(control_points, sample_table,
+                                                 spline);
+            break;
+        default:
+            throw std::invalid_argument("unknown spline type");
+    }
+}
+
+SplineMatrix ComputeSpline(PairVector& control_points, SplineType spline_type_,
+                           unsigned int spline_degree_,
+                           unsigned int spline_subdiv_,
+                           unsigned int derivative) {
+    SplineMatrix spline(NumSplineSamples(spline_type_, spline_subdiv_), 2);
+    ComputeSpline(control_points, spline_type_, spline_degree_,
+                  spline_subdiv_, derivative,
+                  Eigen::Map<SplineMatrix>(spline.data(), spline.rows(), 2));
+    return spline;
+}
+
+bool EnforceContinuity(PairVector& coordinates, SplineType spline_type_,
+                       unsigned int spline_degree_, unsigned int num_points_,
+                       unsigned int GCont_, unsigned int CCont_) {
+    Eigen::Vector2d prevDir;
+    Eigen::Vector2d currDir;
+    Eigen::Vector2d prevPoint;
+    Eigen::Vector2d newPoint;
+
+    unsigned int num_control_points_ = spline_degree_ + 1;
+
+    // Enforce G1 continuity
+    if (GCont_ == 1 && (spline_type_ == SplineType::Hermite ||
+                        spline_type_ == SplineType::Bezier)) {
+        if (ReturnPointIndex(spline_type_, spline_degree_, num_points_) == 1 &&
+            num_points_ > num_control_points_) {
+            // indices further reduced by 1 as num_points starts from 1
+            prevDir << coordinates[num_points_ - 1 - 1].first -
+                           coordinates[num_points_ - 2 - 1].first,
+                coordinates[num_points_ - 1 - 1].second -
+                    coordinates[num_points_ - 2 - 1].second;
+
+            currDir << coordinates[num_points_ - 1].first -
+                           coordinates[num_points_ - 1 - 1].first,
+                coordinates[num_points_ - 1].second -
+                    coordinates[num_points_ - 1 - 1].second;
+
+            prevPoint << coordinates[num_points_ - 1 - 1].first,
+                coordinates[num_points_ - 1 - 1].second;
+
+            double vel = currDir.dot(prevDir.normalized());
+            // Enforce C1 continuity
+            if (CCont_ == 1) vel = prevDir.norm();
+
+            prevDir = prevDir.normalized();
+            newPoint = vel * prevDir + prevPoint;
+
+            coordinates[num_points_ - 1].first = (newPoint(0));
+            coordinates[num_points_ - 1].second = (newPoint(1));
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,119 @@
+#ifndef SPLINE_PLOTTER_SPLINE_H_
+#define SPLINE_PLOTTER_SPLINE_H_
+
+#include <Eigen/Core>
+#include <string>
+#include <utility>
+#include <vector>
+
+// x, y of a control point, in px when placed on screen
+typedef std::pair<double, double> ControlPoint;
+typedef std::vector<ControlPoint> PairVector;
+// x, y rows of the samples of a segment, as doubles unless kept narrower for
+// display
+template <typename Scalar>
+using SampleMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, 2, Eigen::RowMajor>;
+typedef SampleMatrix<double> SplineMatrix;
+
+// Rows of T(t)M for a cubic spline at every sample of t
+typedef Eigen::Matrix<double, Eigen::Dynamic, 4, Eigen::RowMajor> SampleTable;
+
+enum class SplineType {
+    Hermite,
+    Bezier,
+    BSpline,
+    CatmullRom,
+    MINVO,
+    NURBS,
+    // cubic through every point, C2 throughout, see interpolate.h
+    Interpolating
+};
+
+std::string SplineTypeName(SplineType spline_type_);
+// Resolves a --spline_type name, returns false if it is not a known type
+bool ParseSplineType(std::string name, SplineType& spline_type_);
+
+PairVector ReturnLastNFromM(PairVector& coordinates, unsigned int n,
+                            unsigned int m);
+PairVector ReturnLastN(PairVector& coordinates, unsigned int n);
+
+// Hermite, Bezier and MINVO segments share their end points, so a new segment
+// starts every spline_degree points. BSpline, CatmullRom and NURBS start one
+// per point
+bool IsSegmentedSpline(SplineType spline_type_);
+
+// Number of segments num_points_ control points make up, and the index of the
+// first control point of segment k. Interpolating curves have a segment
+// between every two points, and one more closing a periodic curve
+unsigned int NumSegments(SplineType spline_type_, unsigned int spline_degree_,
+                         unsigned int num_points_);
+unsigned int SegmentStart(SplineType spline_type_, unsigned int spline_degree_,
+                          unsigned int k);
+
+// Range [first, last) of the segments whose control points include point
+// index, out of the segments num_points_ points make up
+std::pair<unsigned int, unsigned int> SegmentsWithPoint(
+    SplineType spline_type_, unsigned int spline_degree_,
+    unsigned int num_points_, unsigned int index);
+
+// Control points of segment k of coordinates. Interpolating segments also
+// depend on the tangents solved for every point, see interpolate.h
+PairVector SegmentControlPoints(const PairVector& coordinates,
+                                SplineType spline_type_,
+                                unsigned int spline_degree_, unsigned int k);
+
+// Position of point num_points_ within its segment, 0 when it completes one
+unsigned int ReturnPointIndex(SplineType spline_type_,
+                              unsigned int spline_degree_,
+                              unsigned int num_points_);
+
+double CheckCCW(const ControlPoint& p0, const ControlPoint& p1,
+                const ControlPoint& p2);
+// Convex hull in counter-clockwise order without collinear points. Fewer than
+// three distinct or collinear points give a degenerate hull of one or two
+PairVector SortConvex(const PairVector& control_points);
+
+// Power basis coefficients MG of a cubic segment, ordered in descending powers
+typedef Eigen::Matrix<double, 4, 2> CoefficientMatrix;
+
+// First value of t a spline type is sampled from, the last is always 1
+double ParamStart(SplineType spline_type_);
+unsigned int NumSplineSamples(SplineType spline_type_,
+                              unsigned int spline_subdiv_);
+
+CoefficientMatrix ComputeCoefficients(const PairVector& control_points,
+                                      SplineType spline_type_);
+
+// Tables of up to this many subdivisions are cached for the life of the
+// process, until max_cached_tables are
+const unsigned int max_cached_subdiv = 1u << 12;
+const unsigned int max_cached_tables = 64;
+
+// Cached T(t)M table of a spline type, computed on first use for each
+// subdivision and derivative order. Tables that are not cached, such as those
+// of the subdivisions --serve clients ask for, are kept by the calling thread
+// until it looks up another one of the same derivative order, so the memory
+// they hold stays bounded
+const SampleTable& LookupSampleTable(SplineType spline_type_,
+                                     unsigned int spline_subdiv_,
+                                     unsigned int derivative);
+
+// Samples a segment, or its derivative, at spline_subdiv_ steps per unit of t.
+// NURBS segments of any degree are sampled with unit weights over uniform
+// knots, see nurbs.h
+SplineMatrix ComputeSpline(PairVector& control_points, SplineType spline_type_,
+                           unsigned int spline_degree_,
+                           unsigned int spline_subdiv_,
+                           unsigned int derivative);
+// Writes the samples into spline, which must have NumSplineSamples rows
+void ComputeSpline(PairVector& control_points, SplineType spline_type_,
+                   unsigned int spline_degree_, unsigned int spline_subdiv_,
+                   unsigned int derivative, Eigen::Map<SplineMatrix> spline);
+
+// Adjusts the last of the first num_points_ coordinates for G1/C1 continuity,
+// returns whether it moved
+bool EnforceContinuity(PairVector& coordinates, SplineType spline_type_,
+                       unsigned int spline_degree_, unsigned int num_points_,
+                       unsigned int GCont_, unsigned int CCont_);
+
+#endif  // SPLINE_PLOTTER_SPLINE_H_
@@ -0,0 +1,85 @@
+// Reads a binary spline file written by --export_format binary, checks it and
+// prints a summary. With --csv {file} the samples are also written out in the
+// CSV export format, so the two formats can be compared
+//   ./spline_inspect results/splines_Bezier_0.splb [--csv out.csv]
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "args.h"
+#include "binary.h"
+#include "export.h"
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv, argv + argc);
+    if (args.size() < 2 || args[1][0] == '-') {
+        std::cout << "usage: spline_inspect {file.splb} [--csv {file}]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        SplineFile file(args[1]);
+        SplineFileInfo info = file.Info();
+        std::cout << fmt::format(
+                         "{}: version {}, {} degree {}, subdiv {}, "
+                         "tolerance {}",
+                         args[1], file.Header().version,
+                         SplineTypeName(info.spline_type), info.degree,
+                         info.subdiv, info.tolerance)
+                  << std::endl;
+        std::cout << file.NumSegments() << " segments, " << file.NumSamples()
+                  << " samples" << std::endl;
+
+        // fixed sampling gives every segment the same number of samples
+        unsigned int expected_samples =
+            info.tolerance > 0.0 || info.subdiv == 0
+                ? 0
+                : NumSplineSamples(info.spline_type, info.subdiv);
+        unsigned int errors = 0;
+        for (size_t k = 0; k < file.NumSegments(); k++) {
+            Eigen::Map<const SplineMatrix> segment = file.Segment(k);
+            if (expected_samples != 0 && segment.rows() != expected_samples) {
+                std::cout << "segment " << k << " has " << segment.rows()
+                          << " samples, expected " << expected_samples
+                          << std::endl;
+                errors++;
+            } else if (segment.rows() < 2) {
+                std::cout << "segment " << k << " has fewer than 2 samples"
+                          << std::endl;
+                errors++;
+            } else if (!segment.allFinite()) {
+                std::cout << "segment " << k << " has non-finite samples"
+                          << std::endl;
+                errors++;
+            }
+        }
+
+        std::string csv_file = CheckArgString(args, "--csv");
+        if (!csv_file.empty()) {
+            std::ofstream output(csv_file);
+            if (!output) throw std::runtime_error("cannot open " + csv_file);
+            SampleArena splines;
+            for (size_t k = 0; k < file.NumSegments(); k++)
+                splines.Append(file.Segment(k));
+            WriteSplines(output, splines);
+        }
+
+        if (errors > 0) {
+            std::cout << errors << " invalid segments" << std::endl;
+            return EXIT_FAILURE;
+        }
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+// Load generator for the --serve evaluation service. Every client thread
+// sends its requests on its own connection, one at a time, each a random walk
+// of control points, and the throughput and latency percentiles of all of
+// them are printed
+//   ./spline_load {socket} [--clients 8] [--requests 1000] [--points 32]
+//       [--spline_type BSpline] [--degree 3] [--subdiv 150]
+//       [--tolerance {px}] [--derivative 0]
+
+#include <fmt/format.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "args.h"
+#include "serve.h"
+
+static const int max_step = 16;  // px between control points of a walk
+
+static unsigned int ArgOr(const std::vector<std::string>& args,
+                          const std::string& flag, unsigned int value) {
+    std::string arg = CheckArgString(args, flag);
+    return arg.empty() ? value : static_cast<unsigned int>(std::stoul(arg));
+}
+
+// ms of the request at fraction p of the sorted latencies
+static double Percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(
+        std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv, argv + argc);
+    if (args.size() < 2 || args[1][0] == '-') {
+        std::cout << "usage: spline_load {socket} [--clients N] [--requests N] "
+                     "[--points N] [--spline_type {type}] [--degree p] "
+                     "[--subdiv N] [--tolerance px] [--derivative d]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SplineRequest settings;
+    settings.spline_type = SplineType::BSpline;
+    unsigned int num_clients, num_requests, num_points;
+    try {
+        num_clients = std::max(1u, ArgOr(args, "--clients", 8));
+        num_requests = ArgOr(args, "--requests", 1000);
+        num_points = ArgOr(args, "--points", 32);
+        std::string type_name = CheckArgString(args, "--spline_type");
+        if (!type_name.empty() &&
+            !ParseSplineType(type_name, settings.spline_type))
+            throw std::invalid_argument("unknown spline type " + type_name);
+        settings.degree = ArgOr(args, "--degree", 3);
+        settings.subdiv = ArgOr(args, "--subdiv", 150);
+        settings.derivative = ArgOr(args, "--derivative", 0);
+        std::string tolerance = CheckArgString(args, "--tolerance");
+        if (!tolerance.empty()) settings.tolerance = std::stod(tolerance);
+    } catch (const std::exception& error) {
+        std::cout << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // requests are split as evenly as the clients allow
+    std::vector<std::vector<double>> latencies(num_clients);
+    std::atomic<unsigned long long> num_samples(0);
+    std::atomic<unsigned int> num_failed(0);
+    auto client = [&](unsigned int c) {
+        int socket = -1;
+        try {
+            socket = ConnectToServer(args[1]);
+            std::mt19937 generator(c);
+            std::uniform_int_distribution<int> step(-max_step, max_step);
+            SplineRequest request = settings;
+            SplineResponse response;
+            for (unsigned int r = c; r < num_requests; r += num_clients) {
+                request.id = r;
+                request.points.clear();
+                ControlPoint point(640, 400);
+                for (unsigned int i = 0; i < num_points; i++) {
+                    point.first += step(generator);
+                    point.second += step(generator);
+                    request.points.push_back(point);
+                }
+                auto start = std::chrono::steady_clock::now();
+                SendRequest(socket, request);
+                ReceiveResponse(socket, response);
+                std::chrono::duration<double, std::milli> latency =
+                    std::chrono::steady_clock::now() - start;
+                latencies[c].push_back(latency.count());
+                if (response.status != ServeStatus::Ok || response.id != r) {
+                    if (num_failed++ == 0)
+                        std::cout << "request " << r
+                                  << " failed: " << response.message
+                                  << std::endl;
+                    continue;
+                }
+                num_samples += response.NumSamples();
+            }
+        } catch (const std::runtime_error& error) {
+            std::cout << error.what() << std::endl;
+            num_failed++;
+        }
+        if (socket >= 0) close(socket);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (unsigned int c = 0; c < num_clients; c++)
+        clients.emplace_back(client, c);
+    for (std::thread& thread : clients) thread.join();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::vector<double> all;
+    for (const std::vector<double>& client_latencies : latencies)
+        all.insert(all.end(), client_latencies.begin(),
+                   client_latencies.end());
+    if (all.empty()) return EXIT_FAILURE;
+    std::sort(all.begin(), all.end());
+    const double seconds = elapsed.count();
+    std::cout << fmt::format(
+                     "{} requests of {} {} points from {} clients in "
+                     "{:.3f} s",
+                     all.size(), num_points,
+                     SplineTypeName(settings.spline_type), num_clients,
+                     seconds)
+              << std::endl;
+    std::cout << fmt::format(
+                     "throughput {:.0f} requests/s, {:.2f} Msamples/s",
+                     static_cast<double>(all.size()) / seconds,
+                     static_cast<double>(num_samples.load()) / seconds / 1e6)
+              << std::endl;
+    std::cout << fmt::format(
+                     "latency p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+                     Percentile(all, 0.5), Percentile(all, 0.99), all.back())
+              << std::endl;
+    if (num_failed > 0) {
+        std::cout << num_failed << " requests failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
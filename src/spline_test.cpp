@@ -0,0 +1,474 @@
+// Checks the batch kernels against the reference evaluation, the error
+// bounds of adaptive sampling, equal arc length sampling, curve intersections,
+// clamped NURBS curves and binary and CSV point files, with fixed-seed random
+// control points and regression cases. Prints every failed check and returns
+// non-zero if there were any
+//   ./spline_test    (or make check)
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "adaptive.h"
+#include "arclength.h"
+#include "batch.h"
+#include "curve.h"
+#include "export.h"
+#include "interpolate.h"
+#include "intersect.h"
+#include "nurbs.h"
+#include "spline.h"
+
+static unsigned int num_failed = 0;
+
+static void Check(bool passed, const std::string& name) {
+    if (passed) return;
+    std::cout << "FAILED " << name << std::endl;
+    num_failed++;
+}
+
+static PairVector RandomPoints(unsigned int num_points_, double extent) {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> coordinate(0.0, extent);
+    PairVector coordinates;
+    for (unsigned int i = 0; i < num_points_; i++)
+        coordinates.emplace_back(coordinate(generator), coordinate(generator));
+    return coordinates;
+}
+
+// Largest difference of the samples of every kernel from ComputeSpline's, in
+// double and float, for every cubic type at the 10^4 px coordinates and 10^4
+// subdivisions batch.h states its tolerances for. The number of segments is
+// not a multiple of a register so the remainder loops are checked too
+static void CheckBatchKernels() {
+    const unsigned int spline_degree_ = 3;
+    const double double_tolerance = 1e-6;  // px, see batch.h
+    const double float_tolerance = 4e-3;
+    PairVector coordinates = RandomPoints(31, 1e4);
+    for (SplineType spline_type_ :
+         {SplineType::Hermite, SplineType::Bezier, SplineType::BSpline,
+          SplineType::CatmullRom, SplineType::MINVO}) {
+        const unsigned int num_segments_ = NumSegments(
+            spline_type_, spline_degree_,
+            static_cast<unsigned int>(coordinates.size()));
+        for (unsigned int spline_subdiv_ : {150u, 10000u}) {
+            const unsigned int num_samples =
+                NumSplineSamples(spline_type_, spline_subdiv_);
+            const size_t num_values =
+                2 * static_cast<size_t>(num_segments_) * num_samples;
+            std::vector<double> reference(num_values);
+            for (unsigned int k = 0; k < num_segments_; k++) {
+                PairVector control_points = SegmentControlPoints(
+                    coordinates, spline_type_, spline_degree_, k);
+                Eigen::Map<SplineMatrix> samples(
+                    reference.data() + 2 * static_cast<size_t>(k) * num_samples,
+                    num_samples, 2);
+                ComputeSpline(control_points, spline_type_, spline_degree_,
+                              spline_subdiv_, 0, samples);
+            }
+
+            std::vector<double> doubles(num_values);
+            std::vector<float> floats(num_values);
+            for (BatchKernel kernel :
+                 {BatchKernel::Scalar, BatchKernel::SSE, BatchKernel::AVX2}) {
+                if (!BatchKernelSupported(kernel)) {
+                    std::cout << BatchKernelName(kernel)
+                              << " is not supported by this CPU, skipped"
+                              << std::endl;
+                    continue;
+                }
+                ComputeSplines(coordinates, spline_type_, spline_degree_,
+                               spline_subdiv_, 0, num_segments_, kernel,
+                               doubles.data());
+                ComputeSplines(coordinates, spline_type_, spline_degree_,
+                               spline_subdiv_, 0, num_segments_, kernel,
+                               floats.data());
+                double double_error = 0.0, float_error = 0.0;
+                for (size_t i = 0; i < num_values; i++) {
+                    double_error = std::max(
+                        double_error, std::abs(doubles[i] - reference[i]));
+                    float_error = std::max(
+                        float_error,
+                        std::abs(static_cast<double>(floats[i]) -
+                                 reference[i]));
+                }
+                std::string name = fmt::format(
+                    "{} {} subdiv {}", SplineTypeName(spline_type_),
+                    BatchKernelName(kernel), spline_subdiv_);
+                Check(double_error <= double_tolerance,
+                      fmt::format("{} double error {:.2e} px", name,
+                                  double_error));
+                Check(float_error <= float_tolerance,
+                      fmt::format("{} float error {:.2e} px", name,
+                                  float_error));
+            }
+        }
+    }
+}
+
+// Distance of point from the nearest point of the polyline through samples
+static double DistanceToPolyline(const SplineMatrix& samples,
+                                 const Eigen::RowVector2d& point) {
+    double distance = (point - samples.row(0)).norm();
+    for (Eigen::Index i = 1; i < samples.rows(); i++) {
+        Eigen::RowVector2d start = samples.row(i - 1);
+        Eigen::RowVector2d edge = samples.row(i) - start;
+        double squared = edge.squaredNorm();
+        double along =
+            squared > 0.0
+                ? std::clamp((point - start).dot(edge) / squared, 0.0, 1.0)
+                : 0.0;
+        distance = std::min(distance, (point - start - along * edge).norm());
+    }
+    return distance;
+}
+
+// Every sample of a segment at 10^4 subdivisions lies within tolerance of the
+// adaptive polyline, which has no more samples than MaxAdaptiveSamples, for
+// random segments of every cubic type and a Bezier segment that doubles back
+// along its own chord, whose inner points are within tolerance of the
+// chord's line but 500 px past its ends
+static void CheckAdaptiveSampling() {
+    const double tolerance = 0.5;
+    PairVector coordinates = RandomPoints(40, 1e3);
+    std::vector<std::pair<SplineType, PairVector>> segments = {
+        {SplineType::Bezier, {{0, 0}, {600, 0}, {-500, 0}, {100, 0}}}};
+    for (SplineType spline_type_ :
+         {SplineType::Hermite, SplineType::Bezier, SplineType::BSpline,
+          SplineType::CatmullRom, SplineType::MINVO})
+        for (unsigned int k = 0; k < 10; k++)
+            segments.emplace_back(
+                spline_type_,
+                PairVector(coordinates.begin() + 4 * k,
+                           coordinates.begin() + 4 * k + 4));
+
+    for (auto& [spline_type_, control_points] : segments) {
+        SplineMatrix samples =
+            ComputeSplineAdaptive(control_points, spline_type_, 3, tolerance);
+        SplineMatrix curve =
+            ComputeSpline(control_points, spline_type_, 3, 10000, 0);
+        double error = 0.0;
+        for (Eigen::Index i = 0; i < curve.rows(); i++)
+            error = std::max(error,
+                             DistanceToPolyline(samples, curve.row(i)));
+        Check(error <= tolerance,
+              fmt::format("{} adaptive error {:.2e} px from ({}, {})",
+                          SplineTypeName(spline_type_), error,
+                          control_points[0].first,
+                          control_points[0].second));
+        const uint64_t max_samples = MaxAdaptiveSamples(
+            ComputeBezierPoints(control_points, spline_type_), tolerance);
+        Check(static_cast<uint64_t>(samples.rows()) <= max_samples,
+              fmt::format("{} adaptive samples {} above the bound {}",
+                          SplineTypeName(spline_type_), samples.rows(),
+                          max_samples));
+    }
+}
+
+// Points of a circle of radius px about the origin, counter-clockwise, at
+// angles that step unevenly unless uneven is 0
+static PairVector CirclePoints(unsigned int num_points_, double radius,
+                               double uneven) {
+    PairVector coordinates;
+    for (unsigned int i = 0; i < num_points_; i++) {
+        double angle =
+            2 * M_PI * (i + uneven * std::sin(i)) / num_points_;
+        coordinates.emplace_back(radius * std::cos(angle),
+                                 radius * std::sin(angle));
+    }
+    return coordinates;
+}
+
+// Samples of whole curves at a spacing of 2 px are equally spaced across the
+// joins of their segments, which are of unequal lengths, as chords shorter
+// than their arcs by less than 1e-3 px. A periodic Interpolating curve
+// through evenly spaced points of a circle has the circle's curvature
+static void CheckEqualSpacing() {
+    const double spacing = 2.0, radius = 200.0;
+    PairVector uneven = CirclePoints(24, radius, 0.4);
+    CubicInterpolant interpolant(EndCondition::Periodic);
+    interpolant.Update(uneven, 0, 24);
+    std::vector<std::pair<std::string, CurveArcLength>> curves;
+    curves.emplace_back("BSpline",
+                        CurveArcLength(uneven, {}, {}, SplineType::BSpline, 3));
+    curves.emplace_back("Interpolating", CurveArcLength(uneven, interpolant));
+
+    for (auto& [name, curve] : curves) {
+        const double step = curve.Step(spacing);
+        std::vector<Eigen::RowVector2d> samples;
+        for (unsigned int k = 0; k < curve.NumSegments(); k++) {
+            SplineMatrix spline = curve.ResampleSegment(k, step);
+            for (Eigen::Index i = 0; i < spline.rows(); i++) {
+                // segments repeat the samples either side of their start
+                Eigen::RowVector2d sample = spline.row(i);
+                auto recent =
+                    samples.end() -
+                    static_cast<std::ptrdiff_t>(std::min<size_t>(
+                        2, samples.size()));
+                if (std::find(recent, samples.end(), sample) == samples.end())
+                    samples.push_back(sample);
+            }
+        }
+        const double num_steps = std::round(curve.Length() / step);
+        Check(step <= spacing &&
+                  static_cast<double>(samples.size()) == num_steps + 1,
+              fmt::format("{} has {} samples for {} steps of {} px", name,
+                          samples.size(), num_steps, step));
+        double error = 0.0;
+        for (size_t i = 1; i < samples.size(); i++)
+            error = std::max(
+                error, std::abs((samples[i] - samples[i - 1]).norm() - step));
+        Check(error <= 1e-3,
+              fmt::format("{} samples are {:.2e} px off equal spacing", name,
+                          error));
+    }
+
+    PairVector even = CirclePoints(24, radius, 0.0);
+    CubicInterpolant even_interpolant(EndCondition::Periodic);
+    even_interpolant.Update(even, 0, 24);
+    CurveArcLength circle(even, even_interpolant);
+    double error = 0.0;
+    for (double s = 0.0; s < circle.Length(); s += spacing)
+        error = std::max(error, std::abs(circle.CurvatureAtLength(s) * radius -
+                                         1.0));
+    Check(error <= 1e-2,
+          fmt::format("circle curvature {:.2e} off 1 / radius", error));
+}
+
+// A Bezier segment doubling back along its own chord crosses the line x = 180
+// twice, on the way out to x = 185.6 and on the way back, within 1e-3 px of
+// the same point. Both crossings must be found whether or not the chord is
+// exactly horizontal
+static void CheckIntersections() {
+    for (double lift : {0.0, 1e-3}) {
+        std::vector<BezierMatrix> segments(2);
+        segments[0] << 0, lift, 600, 0, -500, 0, 100, 0;
+        segments[1] << 180, -100, 180, -100.0 / 3, 180, 100.0 / 3, 180, 100;
+        std::vector<double> crossings;
+        for (const Intersection& intersection : FindIntersections(segments))
+            if (intersection.second_segment == 1)
+                crossings.push_back(intersection.first_t);
+        std::string name = fmt::format("doubling back from (0, {})", lift);
+        Check(crossings.size() == 2,
+              fmt::format("{} crosses x = 180 {} times", name,
+                          crossings.size()));
+        for (double t : crossings) {
+            const double u = 1 - t;
+            Eigen::RowVector2d point =
+                Eigen::RowVector4d(u * u * u, 3 * u * u * t, 3 * u * t * t,
+                                   t * t * t) *
+                segments[0];
+            Check(std::abs(point.x() - 180) <= intersection_tolerance,
+                  fmt::format("{} crosses at t = {}, x = {}", name, t,
+                              point.x()));
+        }
+    }
+}
+
+// Figure-eights crossing where segments join, once through the joints of
+// both loops and once through the middle of a segment, cross once there
+static void CheckJointCrossings() {
+    std::vector<BezierMatrix> through_joints(4), through_middle(3);
+    through_joints[0] << 0, 0, 100, 100, 200, 100, 200, 0;
+    through_joints[1] << 200, 0, 200, -100, 100, -100, 0, 0;
+    through_joints[2] << 0, 0, -100, 100, -200, 100, -200, 0;
+    through_joints[3] << -200, 0, -200, -100, -100, -100, 0, 0;
+    through_middle[0] = through_joints[0];
+    through_middle[1] << 200, 0, 200, -200, -200, 200, -200, 0;
+    through_middle[2] = through_joints[3];
+    for (const auto& segments : {through_joints, through_middle}) {
+        std::string name =
+            fmt::format("figure-eight of {} segments", segments.size());
+        std::vector<Intersection> intersections = FindIntersections(segments);
+        Check(intersections.size() == 1,
+              fmt::format("{} crosses {} times", name, intersections.size()));
+        for (const Intersection& intersection : intersections)
+            Check(intersection.point.norm() <= intersection_tolerance,
+                  fmt::format("{} crosses at ({}, {})", name,
+                              intersection.point.x(),
+                              intersection.point.y()));
+    }
+}
+
+// Clamped NURBS curves start at their first point and end at their last, with
+// the tangent p w_1 / w_0 (P_1 - P_0) at the start, and every sample, whether
+// its segment is tabulated or not, is where de Boor's algorithm puts it
+static void CheckClampedKnots() {
+    const unsigned int spline_subdiv_ = 64;
+    const double tolerance = 1e-6;  // px
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> weight(0.5, 2.0);
+    for (unsigned int spline_degree_ : {1u, 2u, 3u, 5u, max_nurbs_degree}) {
+        for (unsigned int num_points_ :
+             {spline_degree_ + 1, 3 * spline_degree_ + 4}) {
+            std::string name =
+                fmt::format("clamped degree {} curve of {} points",
+                            spline_degree_, num_points_);
+            PairVector coordinates = RandomPoints(num_points_, 1e3);
+            std::vector<double> weights(num_points_);
+            for (double& w : weights) w = weight(generator);
+            std::vector<double> knots =
+                ClampedKnots(spline_degree_, num_points_);
+            std::vector<double> resized;
+            for (unsigned int m = 0; m <= num_points_ + 3; m++)
+                ResizeKnots(resized, KnotVector::Clamped, spline_degree_, m);
+            ResizeKnots(resized, KnotVector::Clamped, spline_degree_,
+                        num_points_);
+            Check(resized == knots, name + " knots resized point by point");
+
+            const unsigned int num_segments_ =
+                NumSegments(SplineType::NURBS, spline_degree_, num_points_);
+            const unsigned int num_samples =
+                NumSplineSamples(SplineType::NURBS, spline_subdiv_);
+            std::vector<double> samples(2 * static_cast<size_t>(num_segments_) *
+                                        num_samples);
+            ComputeSplines(coordinates, SplineType::NURBS, spline_degree_,
+                           spline_subdiv_, 0, num_segments_,
+                           BatchKernel::Reference, samples.data(), weights, {},
+                           knots);
+            const ControlPoint& first = coordinates.front();
+            const ControlPoint& last = coordinates.back();
+            Check(std::hypot(samples[0] - first.first,
+                             samples[1] - first.second) <= tolerance,
+                  name + " starts at its first point");
+            Check(std::hypot(samples[samples.size() - 2] - last.first,
+                             samples.back() - last.second) <= tolerance,
+                  name + " ends at its last point");
+
+            double error = 0.0;
+            KnotSpanCache spans(knots, spline_degree_);
+            for (unsigned int k = 0; k < num_segments_; k++) {
+                for (unsigned int i = 0; i < num_samples; i++) {
+                    double u = knots[k + spline_degree_] +
+                               static_cast<double>(i) / spline_subdiv_;
+                    Eigen::Vector2d point =
+                        DeBoor(knots, coordinates, weights, spline_degree_,
+                               spans.Find(u), u);
+                    const double* sample =
+                        samples.data() + 2 * (static_cast<size_t>(k) *
+                                                  num_samples +
+                                              i);
+                    error = std::max(error, std::hypot(sample[0] - point(0),
+                                                       sample[1] - point(1)));
+                }
+            }
+            Check(error <= tolerance,
+                  fmt::format("{} is {} px from de Boor", name, error));
+
+            Eigen::Vector2d tangent =
+                spline_degree_ * weights[1] / weights[0] *
+                Eigen::Vector2d(coordinates[1].first - first.first,
+                                coordinates[1].second - first.second);
+            Eigen::Vector2d derivatives[2];
+            SegmentCurve(SegmentControlPoints(coordinates, SplineType::NURBS,
+                                              spline_degree_, 0),
+                         weights.data(), knots.data(), SplineType::NURBS,
+                         spline_degree_)
+                .Derivatives(0.0, 1, derivatives);
+            SplineMatrix sampled(num_samples, 2);
+            ComputeNURBS(coordinates.data(), weights.data(), knots.data(),
+                         spline_degree_, spline_subdiv_, 1,
+                         Eigen::Map<SplineMatrix>(sampled.data(), num_samples,
+                                                  2));
+            Check((derivatives[1] - tangent).norm() <=
+                          tolerance * tangent.norm() &&
+                      (sampled.row(0).transpose() - tangent).norm() <=
+                          tolerance * tangent.norm(),
+                  name + " starts along its first edge");
+        }
+    }
+}
+
+// Writes points to a binary point file of either version and reads them back,
+// which must give the points, truncated to integers by version 1
+static void CheckPointFiles() {
+    const PairVector points = {{0.25, -3.5}, {1e4 + 0.125, 7.0}, {-2.75, 0.0}};
+    const std::string filename = "/tmp/spline_test_points.splp";
+    for (uint32_t version : {point_file_int_version, point_file_version}) {
+        std::vector<unsigned char> bytes(point_file_magic,
+                                         point_file_magic + 4);
+        auto put = [&](uint64_t value, unsigned int size) {
+            for (unsigned int i = 0; i < size; i++)
+                bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+        };
+        put(version, 4);
+        for (const ControlPoint& point : points) {
+            for (double value : {point.first, point.second}) {
+                if (version == point_file_int_version) {
+                    put(static_cast<uint32_t>(static_cast<int32_t>(value)), 4);
+                } else {
+                    uint64_t field;
+                    std::memcpy(&field, &value, sizeof(double));
+                    put(field, 8);
+                }
+            }
+        }
+        std::ofstream(filename, std::ios::binary)
+            .write(reinterpret_cast<const char*>(bytes.data()),
+                   static_cast<std::streamsize>(bytes.size()));
+
+        PairVector expected = points;
+        if (version == point_file_int_version)
+            for (ControlPoint& point : expected)
+                point = ControlPoint(static_cast<int32_t>(point.first),
+                                     static_cast<int32_t>(point.second));
+        Check(ImportPoints(filename) == expected,
+              fmt::format("points read back from a version {} file", version));
+        Check(PointReader(filename).CountRemaining() == points.size(),
+              fmt::format("points counted in a version {} file", version));
+    }
+    std::remove(filename.c_str());
+}
+
+// Rows whose fields do not all parse as finite numbers are refused, naming
+// their line
+static void CheckMalformedCsv() {
+    const std::string filename = "/tmp/spline_test_points.csv";
+    for (const char* row : {"1, 2 junk", "1, 2, abc", "1, 2, 3, 4", "nan, 2",
+                            "1", "1, 2, 0", "1x, 2"}) {
+        std::ofstream(filename) << "# x, y, w\n0, 0\n\n" << row << "\n";
+        std::string message;
+        try {
+            std::vector<double> weights;
+            ImportPoints(filename, &weights);
+        } catch (const std::runtime_error& error) {
+            message = error.what();
+        }
+        Check(message.find("on line 4:") != std::string::npos,
+              fmt::format("malformed CSV row \"{}\" refused", row));
+    }
+    std::ofstream(filename) << "0, 0\n1.5,-2,0.25\n3 4\n";
+    std::vector<double> weights;
+    Check(ImportPoints(filename, &weights) ==
+                  PairVector({{0.0, 0.0}, {1.5, -2.0}, {3.0, 4.0}}) &&
+              weights == std::vector<double>({1.0, 0.25, 1.0}),
+          "CSV rows with and without weights read back");
+    std::remove(filename.c_str());
+}
+
+int main() {
+    CheckBatchKernels();
+    CheckAdaptiveSampling();
+    CheckEqualSpacing();
+    CheckIntersections();
+    CheckJointCrossings();
+    CheckClampedKnots();
+    CheckPointFiles();
+    CheckMalformedCsv();
+    if (num_failed > 0) {
+        std::cout << num_failed << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include "stream.h"
+
+#include <vector>
+
+#include "scene.h"
+#include "trace.h"
+
+StreamStats StreamSplines(
+    PointReader& reader, unsigned int chunk_size,
+    const std::function<void(const SampleArena&)>&
+        write_segments) {
+    StreamStats stats;
+    PairVector window;  // points carried over followed by the new chunk
+    std::vector<double> window_weights;  // only read for NURBS
+    std::vector<double>* read_weights =
+        spline_type == SplineType::NURBS ? &window_weights : nullptr;
+    SampleArena chunk_splines;  // reused, so it stops allocating
+    unsigned int emitted = 0;  // segments of window already written
+
+    // points are dropped from the front in whole segment steps, so every
+    // point in the window has the same position within its segment as it has
+    // in the file and EnforceContinuity treats it the same
+    const unsigned int step = SegmentStart(spline_type, spline_degree, 1);
+
+    for (;;) {
+        size_t carried = window.size();
+        {
+            ScopedTrace trace("read points");
+            if (reader.Read(window, chunk_size, read_weights) == 0) break;
+        }
+        unsigned int window_points = static_cast<unsigned int>(window.size());
+        {
+            ScopedTrace trace("enforce continuity");
+            for (unsigned int i = static_cast<unsigned int>(carried);
+                 i < window_points; i++)
+                EnforceContinuity(window, spline_type, spline_degree, i + 1,
+                                  GCont, CCont);
+        }
+
+        unsigned int window_segments =
+            NumSegments(spline_type, spline_degree, window_points);
+        chunk_splines.Clear();
+        {
+            ScopedTrace trace("compute spline");
+            EvaluateSegments(window, window_weights, {}, {}, emitted,
+                             window_segments - emitted, chunk_splines);
+        }
+        {
+            ScopedTrace trace("write segments");
+            write_segments(chunk_splines);
+        }
+
+        stats.num_points += window_points - carried;
+        stats.num_segments += chunk_splines.NumSegments();
+        stats.num_samples +=
+            static_cast<unsigned long long>(chunk_splines.NumSamples());
+        emitted = window_segments;
+
+        // keep a full segment's worth of points for continuity and for the
+        // segments the next chunk completes
+        if (window_points > num_control_points) {
+            unsigned int dropped_segments =
+                (window_points - num_control_points) / step;
+            window.erase(window.begin(),
+                         window.begin() + dropped_segments * step);
+            if (read_weights != nullptr)
+                window_weights.erase(
+                    window_weights.begin(),
+                    window_weights.begin() + dropped_segments * step);
+            emitted -= dropped_segments;
+        }
+    }
+    return stats;
+}
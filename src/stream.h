@@ -0,0 +1,26 @@
+#ifndef SPLINE_PLOTTER_STREAM_H_
+#define SPLINE_PLOTTER_STREAM_H_
+
+#include <functional>
+
+#include "arena.h"
+#include "export.h"
+#include "spline.h"
+
+struct StreamStats {
+    unsigned long long num_points = 0;
+    unsigned long long num_segments = 0;
+    unsigned long long num_samples = 0;
+};
+
+// Evaluates the points of reader chunk_size at a time with the current scene
+// settings. Each chunk has continuity enforced and its completed segments
+// evaluated and passed to write_segments before the next chunk is read. Only
+// the last few points are carried over to the next chunk, so memory stays
+// bounded by the chunk size however long the input is
+StreamStats StreamSplines(
+    PointReader& reader, unsigned int chunk_size,
+    const std::function<void(const SampleArena&)>&
+        write_segments);
+
+#endif  // SPLINE_PLOTTER_STREAM_H_
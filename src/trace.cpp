@@ -0,0 +1,125 @@
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+bool trace_enabled = false;
+
+// Fields are atomics so the writer of a slot can race a reader, or a writer
+// that has lapped the buffer, without undefined behaviour; the sequence number
+// tells readers whether what they copied is one whole event
+struct TraceSlot {
+    // 2i + 1 while event i is being written, 2i + 2 once it is complete
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<int64_t> value{0};  // ns for spans, the value for counters
+    std::atomic<uint32_t> thread{0};
+    std::atomic<char> phase{0};  // 'X' for spans, 'C' for counters
+};
+
+static std::unique_ptr<TraceSlot[]> trace_slots;
+static size_t num_trace_slots = 0;
+static std::atomic<uint64_t> next_event(0);
+static std::atomic<uint32_t> next_thread(0);
+static std::chrono::steady_clock::time_point trace_start;
+
+// small ids in order of each thread's first event, which read better than
+// the system's in trace viewers
+static uint32_t ThreadId() {
+    thread_local uint32_t id =
+        next_thread.fetch_add(1, std::memory_order_relaxed) + 1;
+    return id;
+}
+
+static void Record(char phase, const char* name, uint64_t start,
+                   int64_t value) {
+    uint64_t index = next_event.fetch_add(1, std::memory_order_relaxed);
+    TraceSlot& slot = trace_slots[index % num_trace_slots];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.value.store(value, std::memory_order_relaxed);
+    slot.thread.store(ThreadId(), std::memory_order_relaxed);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+void StartTrace(size_t capacity) {
+    if (capacity == 0)
+        throw std::invalid_argument("trace buffer needs at least one event");
+    trace_slots = std::make_unique<TraceSlot[]>(capacity);
+    num_trace_slots = capacity;
+    next_event.store(0);
+    trace_start = std::chrono::steady_clock::now();
+    trace_enabled = true;
+}
+
+uint64_t TraceNow() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - trace_start)
+            .count());
+}
+
+void TraceSpan(const char* name, uint64_t start, uint64_t end) {
+    if (!trace_enabled) return;
+    Record('X', name, start, static_cast<int64_t>(end - start));
+}
+
+void TraceCounter(const char* name, int64_t value) {
+    if (!trace_enabled) return;
+    Record('C', name, TraceNow(), value);
+}
+
+size_t WriteTrace(std::ostream& output) {
+    output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    size_t num_written = 0;
+    uint64_t end = trace_enabled ? next_event.load(std::memory_order_acquire)
+                                 : 0;
+    uint64_t begin = end > num_trace_slots ? end - num_trace_slots : 0;
+    for (uint64_t index = begin; index < end; index++) {
+        const TraceSlot& slot = trace_slots[index % num_trace_slots];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const char* name = slot.name.load(std::memory_order_relaxed);
+        uint64_t start = slot.start.load(std::memory_order_relaxed);
+        int64_t value = slot.value.load(std::memory_order_relaxed);
+        uint32_t thread = slot.thread.load(std::memory_order_relaxed);
+        char phase = slot.phase.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != 2 * index + 2 ||
+            slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        // timestamps are in us
+        output << (num_written == 0 ? "\n" : ",\n");
+        if (phase == 'X') {
+            output << fmt::format(
+                "{{\"name\": \"{}\", \"cat\": \"spline\", \"ph\": \"X\", "
+                "\"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                name, thread, 1e-3 * static_cast<double>(start),
+                1e-3 * static_cast<double>(value));
+        } else {
+            output << fmt::format(
+                "{{\"name\": \"{}\", \"ph\": \"C\", \"pid\": 1, "
+                "\"tid\": {}, \"ts\": {:.3f}, \"args\": {{\"value\": {}}}}}",
+                name, thread, 1e-3 * static_cast<double>(start), value);
+        }
+        num_written++;
+    }
+    output << "\n]}\n";
+    return num_written;
+}
+
+bool WriteTraceFile(const std::string& filename) {
+    std::ofstream output(filename);
+    if (!output) return false;
+    WriteTrace(output);
+    return static_cast<bool>(output);
+}
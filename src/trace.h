@@ -0,0 +1,52 @@
+#ifndef SPLINE_PLOTTER_TRACE_H_
+#define SPLINE_PLOTTER_TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// events kept by default, older ones are overwritten once it fills up
+const size_t trace_capacity = size_t{1} << 16;
+
+// Set by StartTrace, every recording call returns straight away until then
+extern bool trace_enabled;
+
+// Allocates a ring buffer of capacity events and starts recording into it.
+// Any thread may record: each event claims a slot with one atomic increment
+// and marks it written with a per slot sequence number, so recording never
+// takes a lock and never allocates
+void StartTrace(size_t capacity = trace_capacity);
+
+// ns since StartTrace
+uint64_t TraceNow();
+// Records a span of the calling thread from start to end, from TraceNow.
+// name must be a string literal, only its address is stored
+void TraceSpan(const char* name, uint64_t start, uint64_t end);
+// Records the value of a counter, such as the number of points, at this time
+void TraceCounter(const char* name, int64_t value);
+
+// Records the span of its own lifetime
+class ScopedTrace {
+   public:
+    explicit ScopedTrace(const char* name)
+        : name_(name), start_(trace_enabled ? TraceNow() : 0) {}
+    ~ScopedTrace() {
+        if (trace_enabled) TraceSpan(name_, start_, TraceNow());
+    }
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+   private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// Writes the events in the buffer, oldest first, in the Chrome trace event
+// format read by chrome://tracing and Perfetto. Events still being written
+// are skipped. Returns the number written
+size_t WriteTrace(std::ostream& output);
+// WriteTrace to filename, false if it cannot be written
+bool WriteTraceFile(const std::string& filename);
+
+#endif  // SPLINE_PLOTTER_TRACE_H_
@@ -0,0 +1,46 @@
+#include "viewport.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Viewport::Viewport(int width, int height) : width_(width), height_(height) {
+    if (width_ <= 0 || height_ <= 0)
+        throw std::invalid_argument("viewport must have a positive size");
+}
+
+BoundingBox Viewport::Visible() const {
+    return BoundingBox{origin_x_, origin_y_, origin_x_ + width_ / scale_,
+                       origin_y_ + height_ / scale_};
+}
+
+Eigen::Vector2d Viewport::ScreenToWorld(double x, double y) const {
+    return Eigen::Vector2d(origin_x_ + x / scale_, origin_y_ + y / scale_);
+}
+
+Eigen::Vector2d Viewport::WorldToScreen(double x, double y) const {
+    return Eigen::Vector2d((x - origin_x_) * scale_, (y - origin_y_) * scale_);
+}
+
+void Viewport::Pan(double dx, double dy) {
+    origin_x_ -= dx / scale_;
+    origin_y_ -= dy / scale_;
+}
+
+void Viewport::ZoomAt(double x, double y, double factor) {
+    Eigen::Vector2d anchor = ScreenToWorld(x, y);
+    scale_ = std::clamp(scale_ * factor, min_view_scale, max_view_scale);
+    origin_x_ = anchor(0) - x / scale_;
+    origin_y_ = anchor(1) - y / scale_;
+}
+
+void Viewport::Fit(const BoundingBox& box, double margin) {
+    if (!(box.min_x <= box.max_x && box.min_y <= box.max_y)) return;
+    double width = std::max(width_ - 2.0 * margin, 1.0);
+    double height = std::max(height_ - 2.0 * margin, 1.0);
+    double extent_x = std::max(box.max_x - box.min_x, 1.0);
+    double extent_y = std::max(box.max_y - box.min_y, 1.0);
+    scale_ = std::clamp(std::min(width / extent_x, height / extent_y),
+                        min_view_scale, max_view_scale);
+    origin_x_ = 0.5 * (box.min_x + box.max_x) - 0.5 * width_ / scale_;
+    origin_y_ = 0.5 * (box.min_y + box.max_y) - 0.5 * height_ / scale_;
+}
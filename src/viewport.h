@@ -0,0 +1,43 @@
+#ifndef SPLINE_PLOTTER_VIEWPORT_H_
+#define SPLINE_PLOTTER_VIEWPORT_H_
+
+#include <Eigen/Core>
+
+#include "spatial.h"
+
+// zoom limits, in window px per world unit
+const double min_view_scale = 1e-6;
+const double max_view_scale = 1e3;
+
+// Camera over the world coordinates points are stored in. Window coordinates
+// are px from the bottom left corner, as glutMouseFunc's after flipping y. The
+// default view maps world units to px one to one
+class Viewport {
+   public:
+    Viewport(int width, int height);
+
+    double Scale() const { return scale_; }
+    // World units covered by a window px
+    double PixelSize() const { return 1.0 / scale_; }
+    // World box shown in the window
+    BoundingBox Visible() const;
+
+    Eigen::Vector2d ScreenToWorld(double x, double y) const;
+    Eigen::Vector2d WorldToScreen(double x, double y) const;
+
+    // Moves the view by (dx, dy) window px, so the scene follows a drag
+    void Pan(double dx, double dy);
+    // Zooms by factor, keeping the world point under (x, y) in place
+    void ZoomAt(double x, double y, double factor);
+    // Centres box in the window with margin px around it
+    void Fit(const BoundingBox& box, double margin);
+
+   private:
+    int width_;
+    int height_;
+    double origin_x_ = 0.0;  // world point at the bottom left corner
+    double origin_y_ = 0.0;
+    double scale_ = 1.0;
+};
+
+#endif  // SPLINE_PLOTTER_VIEWPORT_H_